@@ -21,6 +21,10 @@
 /* source for threshold matrix - need to improve build process */
 #include "ets_tm.h"
 
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 #define ETS_VERSION 150
 
 #define ETS_SHIFT 16
@@ -52,6 +56,15 @@ typedef struct {
     int            strength; /* Strength */
 } ETS_PlaneCtx;
 
+/* The line data for 4 planes, interleaved so that each field can be
+ * loaded for all planes at once. Used by ets_line_threshold_cmyk_sse2. */
+typedef struct {
+    int err[4];
+    int r[4];
+    int a[4];
+    int b[4];
+} ETS_PixelData4;
+
 typedef unsigned int uint32;
 
 typedef void (ETS_LineFn)(ETS_Ctx *etc, unsigned char **dest, const ETS_SrcPixel * const *src);
@@ -61,6 +74,7 @@ struct _ETS_Ctx {
     int n_planes;
     int levels; /* Number of levels on output, <= 256 */
     ETS_PlaneCtx ** plane_ctx;
+    ETS_PixelData4 *line4; /* Replaces the planes' line data, if used */
     int aspect_x;
     int aspect_y;
     int elo;
@@ -98,11 +112,20 @@ typedef struct {
     int e_1_1;
 } ETS_PixelInternals;
 
+/* ets_line_template only pays off when it is expanded into each of the
+ * ets_line_* functions below with their constant arguments; left to
+ * itself gcc shares a single generic copy between them. */
+#if defined(__GNUC__)
+#define ETS_INLINE inline __attribute__((always_inline))
+#else
+#define ETS_INLINE forceinline
+#endif
+
 /**
  * ets_line_template: Generic code to perform ETS screening
  * on an input line. Called to generate optimised versions.
  */
-static inline void
+static ETS_INLINE void
 ets_line_template(unsigned char * gs_restrict * gs_restrict dest, const ETS_SrcPixel * const gs_restrict * gs_restrict src, int n_planes, int levels, int aspect_x, int aspect_y, int elo, int ehi, int ets_biasing_mode, int r_style, int old_quant, int fancy_coupling, int * gs_restrict c_line,
                   const signed char * gs_restrict tmmat, unsigned int tmwidth, unsigned int tmheight, unsigned int y, int xd, ETS_PlaneCtx * gs_restrict * gs_restrict planes, uint32 *seeds, int in_plane_step, int out_plane_step)
 {
@@ -196,17 +219,16 @@ ets_line_template(unsigned char * gs_restrict * gs_restrict dest, const ETS_SrcP
             if (r_style != ETS_RSTYLE_NONE)
                 rand_shift = ctx->rs_lut[src_pixel];   /* random noise shift */
 
-            /* Forward pass distance computation; equation 2 from paper */
-            if (pii->r + pii->a < pd->r)
-            {
-                pii->r += pii->a;
-                pii->a += 2*aspect_y2;
-            }
-            else
+            /* Forward pass distance computation; equation 2 from paper.
+             * Written as selects, as the outcome is data dependent and
+             * predicts poorly. */
             {
-                pii->a = pd->a;
-                pii->b = pd->b;
-                pii->r = pd->r;
+                int fr = pii->r + pii->a;
+                int closer = fr < pd->r;
+
+                pii->r = closer ? fr : pd->r;
+                pii->b = closer ? pii->b : pd->b;
+                pii->a = closer ? pii->a + 2*aspect_y2 : pd->a;
             }
 
             /* Shuffle all the errors and read the next one. */
@@ -355,12 +377,9 @@ ets_line_template(unsigned char * gs_restrict * gs_restrict dest, const ETS_SrcP
                 coupling += (achieved_error * ctx->strength) >> 8;
 
                 /* If we output a set pixel, then reset our distances. */
-                if (imo != 0)
-                {
-                    pii->a = aspect_y2;
-                    pii->b = aspect_x2;
-                    pii->r = 0;
-                }
+                pii->a = imo ? aspect_y2 : pii->a;
+                pii->b = imo ? aspect_x2 : pii->b;
+                pii->r = imo ? 0 : pii->r;
             }
 
             /* Store the values back for the next pass (Equation 3) */
@@ -472,6 +491,242 @@ ets_line_pseudo(ETS_Ctx *etc, unsigned char **dest, const ETS_SrcPixel * const *
         etc->c_line, NULL, 0, 0, etc->y, etc->width, etc->plane_ctx, etc->seeds, etc->n_planes, etc->n_planes);
 }
 
+/* Specialisations of ets_line_threshold for the configuration used by the
+ * downscaler (bilevel output, ETS_BIAS_REDUCE_POSITIVE) with 1 or 4 planes.
+ * Making these values compile time constants lets the compiler drop the
+ * unused cases, and turn the threshold matrix wrap into a mask. */
+static void
+ets_line_threshold_mono(ETS_Ctx *etc, unsigned char **dest, const ETS_SrcPixel * const * src)
+{
+    ets_line_template(dest, src, 1, 2, etc->aspect_x, etc->aspect_y, etc->elo, etc->ehi, ETS_BIAS_REDUCE_POSITIVE, ETS_RSTYLE_THRESHOLD,
+        OLD_QUANT_VAL, FANCY_COUPLING_VAL,
+        etc->c_line, etc->tmmat, TM_WIDTH, TM_HEIGHT, etc->y, etc->width, etc->plane_ctx, etc->seeds, 1, 1);
+}
+
+static void
+ets_line_threshold_cmyk(ETS_Ctx *etc, unsigned char **dest, const ETS_SrcPixel * const * src)
+{
+    ets_line_template(dest, src, 4, 2, etc->aspect_x, etc->aspect_y, etc->elo, etc->ehi, ETS_BIAS_REDUCE_POSITIVE, ETS_RSTYLE_THRESHOLD,
+        OLD_QUANT_VAL, FANCY_COUPLING_VAL,
+        etc->c_line, etc->tmmat, TM_WIDTH, TM_HEIGHT, etc->y, etc->width, etc->plane_ctx, etc->seeds, 4, 4);
+}
+
+#ifdef HAVE_SSE2
+/* SSE2 version of ets_line_threshold_cmyk. The 4 planes of a pixel are
+ * held in the 4 lanes of a vector, so the distance, error diffusion and
+ * bias calculations for all planes are done together. Only the coupling,
+ * which has to be passed from plane to plane, is done a lane at a time.
+ * Requires all planes to share the same c1 (and hence rlimit). */
+
+/* Return a where mask is set, b elsewhere. */
+static inline __m128i
+ets_select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* As ets_select, for scalars. Written as a function as this persuades
+ * gcc to use cmov rather than a branch. */
+static inline int
+ets_select_int(int mask, int a, int b)
+{
+    return mask ? a : b;
+}
+
+/* Per pixel inputs for ets_line_threshold_cmyk_sse2, one lane per plane.
+ * These are gathered a plane at a time for a run of pixels, which is far
+ * cheaper than gathering them a pixel (4 planes) at a time. */
+typedef struct {
+    int im[4];         /* ctx->lut[src] */
+    int expected_r[4]; /* ctx->dist_lut[src] */
+    int noise[4];      /* Threshold modulation */
+    int c_clear[4];    /* Coupling contribution if the pixel is left clear */
+    int c_set[4];      /* Coupling contribution if the pixel is set */
+} ETS_Input4;
+
+#define ETS_CHUNK 64
+
+static void
+ets_line_threshold_cmyk_sse2(ETS_Ctx *etc, unsigned char **dest, const ETS_SrcPixel * const * src)
+{
+    ETS_PlaneCtx * gs_restrict * gs_restrict planes = etc->plane_ctx;
+    ETS_PixelData4 * gs_restrict line = etc->line4;
+    int * gs_restrict c_line = etc->c_line;
+    int xd = etc->width;
+    const signed char * gs_restrict tmline = etc->tmmat + (etc->y % TM_HEIGHT) * TM_WIDTH;
+    int c1 = planes[0]->c1;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rlimit = _mm_set1_epi32(1 << (30 - ETS_SHIFT + c1));
+    const __m128i rg_shift = _mm_cvtsi32_si128(ETS_SHIFT - c1);
+    const __m128i elo = _mm_set1_epi32(etc->elo);
+    const __m128i ehi = _mm_set1_epi32(etc->ehi);
+    const __m128i one = _mm_set1_epi32(1 << ETS_SHIFT);
+    const __m128i white_base = _mm_set1_epi32(-(1 << 30));
+    const __m128i aspect_x2 = _mm_set1_epi32(etc->aspect_x * etc->aspect_x);
+    const __m128i aspect_y2 = _mm_set1_epi32(etc->aspect_y * etc->aspect_y);
+    const __m128i aspect_x2_2 = _mm_add_epi32(aspect_x2, aspect_x2);
+    const __m128i aspect_y2_2 = _mm_add_epi32(aspect_y2, aspect_y2);
+    __m128i a, b, r, e_1_0, e_0_1, e_m1_1, e_1_1;
+    ETS_Input4 in[ETS_CHUNK];
+    union {
+        __m128i v;
+        int i[4];
+    } base;
+    int coupling = 0;
+    int i, j, n, p, x0;
+
+    /* Initial conditions, as for ets_line_template. */
+    a = aspect_y2;
+    b = aspect_x2;
+    r = zero;
+    e_1_0 = zero;
+    e_0_1 = zero;
+    e_m1_1 = _mm_loadu_si128((const __m128i *)line[0].err);
+
+    for (x0 = 0; x0 < xd; x0 += ETS_CHUNK)
+    {
+        n = xd - x0;
+        if (n > ETS_CHUNK)
+            n = ETS_CHUNK;
+
+        for (p = 0; p < 4; p++)
+        {
+            ETS_PlaneCtx * gs_restrict ctx = planes[p];
+            const ETS_SrcPixel * gs_restrict s = src[p] + x0 * 4;
+            const int * gs_restrict lut = ctx->lut;
+            const int * gs_restrict dist_lut = ctx->dist_lut;
+            const char * gs_restrict rs_lut = ctx->rs_lut;
+            unsigned int tm_offset = x0 + ctx->tm_offset;
+            int strength = ctx->strength;
+
+            for (j = 0; j < n; j++)
+            {
+                ETS_SrcPixel src_pixel = s[j * 4];
+                int im = lut[src_pixel];
+
+                in[j].im[p] = im;
+                in[j].expected_r[p] = dist_lut[src_pixel];
+                in[j].noise[p] = tmline[(j + tm_offset) % TM_WIDTH] << (24 - rs_lut[src_pixel]);
+                in[j].c_clear[p] = (im * strength) >> 8;
+                in[j].c_set[p] = ((im - (1 << ETS_SHIFT)) * strength) >> 8;
+            }
+        }
+
+        for (j = 0; j < n; j++)
+        {
+            const ETS_Input4 *inp = &in[j];
+            ETS_PixelData4 * gs_restrict pd;
+            int set0, set1, set2, set3;
+            __m128i im, expected_r, pd_r, closer, new_e_1_0, ets_bias, err, white, imo;
+
+            i = x0 + j;
+            pd = &line[i];
+            im = _mm_loadu_si128((const __m128i *)inp->im);
+            expected_r = _mm_loadu_si128((const __m128i *)inp->expected_r);
+
+            /* Forward pass distance computation; equation 2 from paper */
+            pd_r = _mm_loadu_si128((const __m128i *)pd->r);
+            closer = _mm_cmplt_epi32(_mm_add_epi32(r, a), pd_r);
+            r = ets_select(closer, _mm_add_epi32(r, a), pd_r);
+            b = ets_select(closer, b, _mm_loadu_si128((const __m128i *)pd->b));
+            a = ets_select(closer, _mm_add_epi32(a, aspect_y2_2), _mm_loadu_si128((const __m128i *)pd->a));
+
+            /* Shuffle all the errors and read the next one. */
+            e_1_1 = e_0_1;
+            e_0_1 = e_m1_1;
+            e_m1_1 = i == xd - 1 ? zero : _mm_loadu_si128((const __m128i *)pd[1].err);
+            /* e_1_0 * 7 + e_m1_1 * 3 + e_0_1 * 5 + e_1_1 */
+            new_e_1_0 = _mm_sub_epi32(_mm_slli_epi32(e_1_0, 3), e_1_0);
+            new_e_1_0 = _mm_add_epi32(new_e_1_0, _mm_add_epi32(_mm_slli_epi32(e_m1_1, 1), e_m1_1));
+            new_e_1_0 = _mm_add_epi32(new_e_1_0, _mm_add_epi32(_mm_slli_epi32(e_0_1, 2), e_0_1));
+            new_e_1_0 = _mm_srai_epi32(_mm_add_epi32(new_e_1_0, e_1_1), 4);
+
+            /* ETS bias (ETS_BIAS_REDUCE_POSITIVE) */
+            ets_bias = ets_select(_mm_cmpgt_epi32(r, rlimit), rlimit, r);
+            ets_bias = _mm_sub_epi32(_mm_sll_epi32(ets_bias, rg_shift), expected_r);
+            ets_bias = ets_select(_mm_cmpgt_epi32(ets_bias, zero), _mm_srai_epi32(ets_bias, 3), ets_bias);
+            ets_bias = _mm_andnot_si128(_mm_cmpeq_epi32(expected_r, zero), ets_bias);
+
+            /* Error plus bias plus noise, clamped. */
+            err = _mm_add_epi32(_mm_add_epi32(new_e_1_0, ets_bias),
+                                _mm_loadu_si128((const __m128i *)inp->noise));
+            err = ets_select(_mm_cmplt_epi32(err, elo), elo, err);
+            err = ets_select(_mm_cmpgt_epi32(err, ehi), ehi, err);
+
+            /* With 2 levels, Equation 7 reduces to imo = (err + coupling +
+             * im reaches half a level). White pixels never set, and (as im
+             * is 0) leave the coupling alone. */
+            white = _mm_cmpeq_epi32(im, zero);
+            base.v = _mm_add_epi32(err, _mm_add_epi32(im, _mm_and_si128(white, white_base)));
+
+            /* This is the serial part, so it is unrolled, and written so
+             * that the coupling only waits on a compare and a select per
+             * plane. setN is 0 or -1. */
+            coupling += c_line[i];
+            set0 = -(base.i[0] + coupling >= (1 << (ETS_SHIFT - 1)));
+            coupling = ets_select_int(set0, coupling + inp->c_set[0], coupling + inp->c_clear[0]);
+            set1 = -(base.i[1] + coupling >= (1 << (ETS_SHIFT - 1)));
+            coupling = ets_select_int(set1, coupling + inp->c_set[1], coupling + inp->c_clear[1]);
+            set2 = -(base.i[2] + coupling >= (1 << (ETS_SHIFT - 1)));
+            coupling = ets_select_int(set2, coupling + inp->c_set[2], coupling + inp->c_clear[2]);
+            set3 = -(base.i[3] + coupling >= (1 << (ETS_SHIFT - 1)));
+            coupling = ets_select_int(set3, coupling + inp->c_set[3], coupling + inp->c_clear[3]);
+            coupling = coupling >> 1;
+            c_line[i] = coupling;
+            dest[0][i * 4] = set0 & 1;
+            dest[1][i * 4] = set1 & 1;
+            dest[2][i * 4] = set2 & 1;
+            dest[3][i * 4] = set3 & 1;
+
+            /* Update the error with what we achieved, and reset the
+             * distances for set pixels. */
+            imo = _mm_setr_epi32(set0, set1, set2, set3);
+            new_e_1_0 = _mm_andnot_si128(white, _mm_add_epi32(new_e_1_0, im));
+            new_e_1_0 = _mm_sub_epi32(new_e_1_0, _mm_and_si128(imo, one));
+            a = ets_select(imo, aspect_y2, a);
+            b = ets_select(imo, aspect_x2, b);
+            r = _mm_andnot_si128(imo, r);
+
+            /* Store the values back for the next pass (Equation 3) */
+            _mm_storeu_si128((__m128i *)pd->err, new_e_1_0);
+            _mm_storeu_si128((__m128i *)pd->r, r);
+            _mm_storeu_si128((__m128i *)pd->a, a);
+            _mm_storeu_si128((__m128i *)pd->b, b);
+            e_1_0 = new_e_1_0;
+        }
+    }
+
+    coupling = 0;
+    for (i = xd - 1; i >= 0; i--)
+    {
+        coupling = (coupling + c_line[i]) >> 1;
+        c_line[i] = (coupling - (coupling >> 4));
+    }
+
+    /* Update distances. Reverse scanline pass. */
+    a = aspect_y2;
+    b = aspect_x2;
+    r = zero;
+    for (i = xd - 1; i >= 0; i--)
+    {
+        ETS_PixelData4 * gs_restrict pd = &line[i];
+        __m128i pd_r = _mm_loadu_si128((const __m128i *)pd->r);
+        __m128i pd_b = _mm_loadu_si128((const __m128i *)pd->b);
+        __m128i closer;
+
+        /* Equation 4 from the paper */
+        closer = _mm_cmplt_epi32(_mm_add_epi32(_mm_add_epi32(r, b), a), _mm_add_epi32(pd_r, pd_b));
+        r = ets_select(closer, _mm_add_epi32(r, a), pd_r);
+        b = ets_select(closer, b, pd_b);
+        a = ets_select(closer, _mm_add_epi32(a, aspect_y2_2), _mm_loadu_si128((const __m128i *)pd->a));
+        r = ets_select(_mm_cmpgt_epi32(r, rlimit), rlimit, r);
+        _mm_storeu_si128((__m128i *)pd->r, _mm_add_epi32(r, b));
+        _mm_storeu_si128((__m128i *)pd->a, a);
+        _mm_storeu_si128((__m128i *)pd->b, _mm_add_epi32(b, aspect_x2_2));
+    }
+}
+#endif
+
 #ifdef UNUSED
 static void
 ets_line_default(ETS_Ctx *etc, unsigned char **dest, const ETS_SrcPixel * const * src)
@@ -880,6 +1135,7 @@ ets_destroy(void *malloc_arg, ETS_Ctx *ctx)
         ets_plane_free(malloc_arg, ctx->plane_ctx[i]);
     ets_free(malloc_arg,ctx->plane_ctx);
     ets_free(malloc_arg, ctx->c_line);
+    ets_free(malloc_arg, ctx->line4);
 
     ets_free(malloc_arg, ctx);
 }
@@ -931,6 +1187,7 @@ ets_create(void *malloc_arg, const ETS_Params *params)
     result->r_style = params->r_style;
 
     result->c_line = (int *)ets_calloc(malloc_arg, params->width, sizeof(int));
+    result->line4 = NULL;
 
     result->seeds[0] = 0x5324879f;
     result->seeds[1] = 0xb78d0945;
@@ -961,6 +1218,41 @@ ets_create(void *malloc_arg, const ETS_Params *params)
         break;
     case ETS_RSTYLE_THRESHOLD:
         result->line_fn = ets_line_threshold;
+        if (result->levels == 2 && result->ets_bias == ETS_BIAS_REDUCE_POSITIVE)
+        {
+            if (n_planes == 1)
+                result->line_fn = ets_line_threshold_mono;
+            else if (n_planes == 4)
+            {
+                result->line_fn = ets_line_threshold_cmyk;
+#ifdef HAVE_SSE2
+                if (result->plane_ctx[1]->c1 == result->plane_ctx[0]->c1 &&
+                    result->plane_ctx[2]->c1 == result->plane_ctx[0]->c1 &&
+                    result->plane_ctx[3]->c1 == result->plane_ctx[0]->c1)
+                {
+                    /* Take over the (initialised) line data from the planes. */
+                    result->line4 = (ETS_PixelData4 *)ets_malloc(malloc_arg, params->width * sizeof(ETS_PixelData4));
+                    if (result->line4 == NULL)
+                        goto fail;
+                    for (i = 0; i < params->width; i++)
+                    {
+                        int j;
+
+                        for (j = 0; j < 4; j++)
+                        {
+                            ETS_PixelData *pd = &result->plane_ctx[j]->line[i];
+
+                            result->line4[i].err[j] = pd->err;
+                            result->line4[i].r[j] = pd->r;
+                            result->line4[i].a[j] = pd->a;
+                            result->line4[i].b[j] = pd->b;
+                        }
+                    }
+                    result->line_fn = ets_line_threshold_cmyk_sse2;
+                }
+#endif
+            }
+        }
         break;
     case ETS_RSTYLE_PSEUDO:
         result->line_fn = ets_line_pseudo;
@@ -742,13 +742,16 @@ gx_default_open_device(gx_device * dev)
 
 /* Get the initial matrix for a device with inverted Y. */
 /* This includes essentially all printers and displays. */
-/* Supports LeadingEdge, but no margins or viewports */
+/* Supports LeadingEdge and RegionOfInterest, but no margins or viewports */
 void
 gx_default_get_initial_matrix(gx_device * dev, register gs_matrix * pmat)
 {
     /* NB this device has no paper margins */
     double fs_res = dev->HWResolution[0] / 72.0;
     double ss_res = dev->HWResolution[1] / 72.0;
+    int width, height;
+
+    gx_device_get_page_hwsize(dev, &width, &height);
 
     switch(dev->LeadingEdge & LEADINGEDGE_MASK) {
     case 1: /* 90 degrees */
@@ -756,15 +759,15 @@ gx_default_get_initial_matrix(gx_device * dev, register gs_matrix * pmat)
         pmat->xy = -ss_res;
         pmat->yx = -fs_res;
         pmat->yy = 0;
-        pmat->tx = (float)dev->width;
-        pmat->ty = (float)dev->height;
+        pmat->tx = (float)width;
+        pmat->ty = (float)height;
         break;
     case 2: /* 180 degrees */
         pmat->xx = -fs_res;
         pmat->xy = 0;
         pmat->yx = 0;
         pmat->yy = ss_res;
-        pmat->tx = (float)dev->width;
+        pmat->tx = (float)width;
         pmat->ty = 0;
         break;
     case 3: /* 270 degrees */
@@ -782,11 +785,14 @@ gx_default_get_initial_matrix(gx_device * dev, register gs_matrix * pmat)
         pmat->yx = 0;
         pmat->yy = -ss_res;
         pmat->tx = 0;
-        pmat->ty = (float)dev->height;
+        pmat->ty = (float)height;
         /****** tx/y is WRONG for devices with ******/
         /****** arbitrary initial matrix ******/
         break;
     }
+    /* Move the region of interest to the device origin. */
+    pmat->tx -= dev->RegionOfInterest[0];
+    pmat->ty -= dev->RegionOfInterest[1];
 }
 /* Get the initial matrix for a device with upright Y. */
 /* This includes just a few printers and window systems. */
@@ -799,8 +805,8 @@ gx_upright_get_initial_matrix(gx_device * dev, register gs_matrix * pmat)
     pmat->yy = dev->HWResolution[1] / 72.0;	/* y_pixels_per_inch */
     /****** tx/y is WRONG for devices with ******/
     /****** arbitrary initial matrix ******/
-    pmat->tx = 0;
-    pmat->ty = 0;
+    pmat->tx = (float)-dev->RegionOfInterest[0];
+    pmat->ty = (float)-dev->RegionOfInterest[1];
 }
 
 int
@@ -29,6 +29,7 @@
 #include "gstrans.h"
 #include "gxdownscale.h"
 #include "gsbitops.h"
+#include "gxfasync.h"
 
 #include "gdevkrnlsclass.h" /* 'standard' built in subclasses, currently First/Last Page and obejct filter */
 
@@ -582,6 +583,12 @@ gdev_prn_get_param(gx_device *dev, char *Param, void *list)
     if (strcmp(Param, "BGPrint") == 0) {
         return param_write_bool(plist, "BGPrint", &ppdev->bg_print_requested);
     }
+    if (strcmp(Param, "OutputBuffers") == 0) {
+        return param_write_int(plist, "OutputBuffers", &ppdev->OutputBuffers);
+    }
+    if (strcmp(Param, "DirectOutput") == 0) {
+        return param_write_bool(plist, "DirectOutput", &ppdev->DirectOutput);
+    }
     if (strcmp(Param, "ReopenPerPage") == 0) {
         return param_write_bool(plist, "ReopenPerPage", &ppdev->ReopenPerPage);
     }
@@ -649,6 +656,8 @@ gdev_prn_get_params(gx_device * pdev, gs_param_list * plist)
         (code = param_write_int(plist, "NumRenderingThreads", &ppdev->num_render_threads_requested)) < 0 ||
         (code = param_write_bool(plist, "OpenOutputFile", &ppdev->OpenOutputFile)) < 0 ||
         (code = param_write_bool(plist, "BGPrint", &ppdev->bg_print_requested)) < 0 ||
+        (code = param_write_int(plist, "OutputBuffers", &ppdev->OutputBuffers)) < 0 ||
+        (code = param_write_bool(plist, "DirectOutput", &ppdev->DirectOutput)) < 0 ||
         (code = param_write_bool(plist, "ReopenPerPage", &ppdev->ReopenPerPage)) < 0 ||
         (code = param_write_bool(plist, "pageneutralcolor", &pageneutralcolor)) < 0
         )
@@ -712,6 +721,8 @@ gdev_prn_put_params(gx_device * pdev, gs_param_list * plist)
     int width = pdev->width;
     int height = pdev->height;
     int nthreads = ppdev->num_render_threads_requested;
+    int output_buffers = ppdev->OutputBuffers;
+    bool direct_output = ppdev->DirectOutput;
     gdev_space_params save_sp;
     gs_param_string ofs;
     gs_param_string bls;
@@ -831,6 +842,28 @@ gdev_prn_put_params(gx_device * pdev, gs_param_list * plist)
             break;
     }
 
+    switch (code = param_read_int(plist, (param_name = "OutputBuffers"),
+                                                        &output_buffers)) {
+        case 0:
+            if (output_buffers >= 0)
+                break;
+            code = gs_error_rangecheck;
+        default:
+            ecode = code;
+            param_signal_error(plist, param_name, ecode);
+        case 1:
+            ;
+    }
+    switch (code = param_read_bool(plist, (param_name = "DirectOutput"),
+                                                        &direct_output)) {
+        default:
+            ecode = code;
+            param_signal_error(plist, param_name, ecode);
+        case 0:
+        case 1:
+            break;
+    }
+
     switch (code = param_read_string(plist, (param_name = "saved-pages"),
                                                         &saved_pages)) {
         default:
@@ -874,6 +907,9 @@ gdev_prn_put_params(gx_device * pdev, gs_param_list * plist)
         ppdev->Duplex_set = duplex_set;
     }
     ppdev->num_render_threads_requested = nthreads;
+    /* These take effect when the output file is next opened. */
+    ppdev->OutputBuffers = output_buffers;
+    ppdev->DirectOutput = direct_output;
     if (bls.data != 0) {
         ppdev->BLS_force_memory = (bls.data[0] == 'm');
     }
@@ -1237,6 +1273,9 @@ gdev_prn_print_scan_lines(gx_device * pdev)
     return min(height, end);
 }
 
+/* Size of each buffer used when OutputBuffers > 0 */
+#define PRN_OUTPUT_BUFFER_SIZE (1024 * 1024)
+
 /* Open the current page for printing. */
 int
 gdev_prn_open_printer_seekable(gx_device *pdev, bool binary_mode,
@@ -1268,6 +1307,16 @@ gdev_prn_open_printer_seekable(gx_device *pdev, bool binary_mode,
 
             return_error(gs_error_ioerror);
         }
+        /* Optionally hand the writing over to another thread. If that
+         * isn't possible, just carry on writing directly. */
+        if (ppdev->OutputBuffers > 0) {
+            gp_file *af = gx_async_file_wrap(pdev->memory, ppdev->file,
+                                ppdev->OutputBuffers, PRN_OUTPUT_BUFFER_SIZE,
+                                ppdev->DirectOutput ? GX_ASYNC_FILE_DIRECT : 0);
+
+            if (af != NULL)
+                ppdev->file = af;
+        }
     }
     ppdev->file_is_new = true;
 
@@ -1695,8 +1744,11 @@ gdev_prn_close_printer(gx_device * pdev)
     if ((code >= 0 && fmt) /* file per page */ ||
         ppdev->ReopenPerPage	/* close and reopen for each page */
         ) {
-        gx_device_close_output_file(pdev, ppdev->fname, ppdev->file);
+        /* This also reports any error from the OutputBuffers writer. */
+        code = gx_device_close_output_file(pdev, ppdev->fname, ppdev->file);
         ppdev->file = NULL;
+        if (code < 0)
+            return code;
     }
     return 0;
 }
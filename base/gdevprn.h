@@ -143,6 +143,8 @@ typedef struct bg_print_s {
         bool bg_print_requested;	/* request background printing of page from clist */\
         bg_print_t *bg_print;           /* background printing data shared with thread */\
         int num_render_threads_requested;	/* for multiple band rendering threads */\
+        int OutputBuffers;		/* > 0 to write output on a separate thread */\
+        bool DirectOutput;		/* use O_DIRECT for that, if possible */\
         gx_saved_pages_list *saved_pages_list;	/* list when we are saving pages instead of printing */\
         gx_device_procs save_procs_while_delaying_erasepage	/* save device procs while delaying erasepage. */
 
@@ -222,6 +224,8 @@ prn_dev_proc_get_space_params(gx_default_get_space_params);
         0/*false*/,	/* bg_print_requested */\
         0,              /* *bg_print */\
         0, 		/* num_render_threads_requested */\
+        0, 		/* OutputBuffers */\
+        0/*false*/,	/* DirectOutput */\
         0,              /* saved_pages_list */\
         { 0 }           /* save_procs_while_delaying_erasepage */
 #define prn_device_body_rest_(print_page)\
@@ -457,22 +457,32 @@ struct gsicc_link_s {
     gsicc_colorbuffer_t data_cs; /* needed for begin_monitor after end_monitor */
     int num_input;  /* Need so we can monitor properly */
     int num_output; /* Need so we can monitor properly */
+    size_t size;    /* Estimate of the memory behind the link */
+    gsicc_link_t *shared;  /* Link in the shared cache that this one borrows */
 };
 
-/* ICC Cache. The size of the cache is limited by max_memory_size.
- * Links are added if there is sufficient memory and if the number
- * of links does not exceed a (soft) limit.
+/* ICC Cache. The size of the cache is limited by an estimate of the
+ * memory its links use.  This is a soft limit: unused links are dropped
+ * to make room, but a link is never refused because the others are all
+ * in use.  A render thread has a cache of its own in front of the one
+ * shared by all the threads, so that finding a link it has used before
+ * doesn't contend with the others.  Its links borrow the link handles
+ * of the shared cache.
  */
 
-typedef struct gsicc_link_cache_s {
+typedef struct gsicc_link_cache_s gsicc_link_cache_t;
+struct gsicc_link_cache_s {
     gsicc_link_t *head;
     int num_links;
+    size_t size;		/* sum of the link size estimates */
     rc_header rc;
     gs_memory_t *memory;
     gx_monitor_t *lock;		/* handle for the monitor */
-    bool cache_full;		/* flag that some thread needs a cache slot */
-    gx_semaphore_t *full_wait;	/* semaphore for waiting when the cache is full */
-} gsicc_link_cache_t;
+    gsicc_link_cache_t *shared;	/* for a thread's cache, the one it borrows from */
+    long num_created;		/* links built by the CMS */
+    long num_hits;		/* links found in the cache */
+    struct gsicc_devcolor_cache_s *devcolors;	/* see gsicc_get_devcolor */
+};
 
 /* A linked list structure to keep DeviceN ICC profiles
  * that the user wishes to use to achieve accurate rendering
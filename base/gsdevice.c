@@ -38,6 +38,7 @@
 #include "gsicc_manage.h"
 #include "gscms.h"
 #include "gxgetbit.h"
+#include "gxfasync.h"
 
 /* Include the extern for the device list. */
 extern_gs_lib_device_list();
@@ -901,6 +902,21 @@ gx_device_set_margins(gx_device * dev, const float *margins /*[4] */ ,
     }
 }
 
+/*
+ * A device with a RegionOfInterest only covers that part of the page, so
+ * the clist writer culls everything outside it, the band list only spans
+ * its height, and the output is a raster of the region. The initial
+ * matrix moves the region to the device origin.
+ */
+static void
+gx_device_set_hwsize_from_roi(gx_device *dev)
+{
+    if (dev->RegionOfInterest[2] > 0) {
+        dev->width = dev->RegionOfInterest[2] - dev->RegionOfInterest[0];
+        dev->height = dev->RegionOfInterest[3] - dev->RegionOfInterest[1];
+    }
+}
+
 static void
 gx_device_set_hwsize_from_media(gx_device *dev)
 {
@@ -921,6 +937,7 @@ gx_device_set_hwsize_from_media(gx_device *dev)
         /* just do the default setting */
         dev->width = hwsize[0];
         dev->height = hwsize[1];
+        gx_device_set_hwsize_from_roi(dev);
     }
 }
 
@@ -947,6 +964,7 @@ gx_device_set_width_height(gx_device * dev, int width, int height)
     dev->width = width;
     dev->height = height;
     gx_device_set_media_from_hwsize(dev);
+    gx_device_set_hwsize_from_roi(dev);
 }
 
 /* Set the resolution, updating width and height to remain consistent. */
@@ -967,6 +985,34 @@ gx_device_set_media_size(gx_device * dev, double media_width, double media_heigh
     gx_device_set_hwsize_from_media(dev);
 }
 
+/* Set or clear (roi == NULL) the RegionOfInterest, updating width and height. */
+void
+gx_device_set_region_of_interest(gx_device * dev, const int *roi)
+{
+    int i;
+
+    for (i = 0; i < 4; ++i)
+        dev->RegionOfInterest[i] = (roi == NULL ? 0 : roi[i]);
+    gx_device_set_hwsize_from_media(dev);
+}
+
+/* Get the size in pixels of the whole page, ignoring any RegionOfInterest. */
+void
+gx_device_get_page_hwsize(const gx_device * dev, int *pwidth, int *pheight)
+{
+    int rot = (dev->LeadingEdge & 1);
+    double rot_media_x = rot ? dev->MediaSize[1] : dev->MediaSize[0];
+    double rot_media_y = rot ? dev->MediaSize[0] : dev->MediaSize[1];
+
+    if (dev->RegionOfInterest[2] <= 0) {
+        *pwidth = dev->width;
+        *pheight = dev->height;
+        return;
+    }
+    *pwidth = (int)(rot_media_x * dev->HWResolution[0] / 72.0 + 0.5);
+    *pheight = (int)(rot_media_y * dev->HWResolution[1] / 72.0 + 0.5);
+}
+
 /*
  * Copy the color mapping procedures from the target if they are
  * standard ones (saving a level of procedure call at mapping time).
@@ -1351,20 +1397,26 @@ gx_device_close_output_file(const gx_device * dev, const char *fname,
 {
     gs_parsed_file_name_t parsed;
     const char *fmt;
-    int code = gx_parse_output_file_name(&parsed, &fmt, fname, strlen(fname),
-                                         dev->memory);
+    int wcode;
+    int code;
 
+    /* Finish any writes still queued (see OutputBuffers in gdevprn.c). */
+    file = gx_async_file_unwrap(file, &wcode);
+    code = gx_parse_output_file_name(&parsed, &fmt, fname, strlen(fname),
+                                     dev->memory);
     if (code < 0)
         return code;
     if (parsed.iodev) {
         if (!strcmp(parsed.iodev->dname, "%stdout%"))
-            return 0;
+            return wcode;
         /* NOTE: fname is unsubstituted if the name has any %nnd formats. */
-        if (parsed.iodev != iodev_default(dev->memory))
-            return parsed.iodev->procs.fclose(parsed.iodev, file);
+        if (parsed.iodev != iodev_default(dev->memory)) {
+            code = parsed.iodev->procs.fclose(parsed.iodev, file);
+            return (wcode < 0 ? wcode : code);
+        }
     }
     gp_close_printer(file, (parsed.fname ? parsed.fname : fname));
-    return 0;
+    return wcode;
 }
 
 bool gx_color_info_equal(const gx_device_color_info * p1, const gx_device_color_info * p2)
@@ -178,6 +178,15 @@ int gx_default_get_param(gx_device *dev, char *Param, void *list)
         set_param_array(hwsa, HWSize, 2);
         return param_write_int_array(plist, "HWSize", &hwsa);
     }
+    if (strcmp(Param, "RegionOfInterest") == 0) {
+        gs_param_int_array roia;
+
+        set_param_array(roia, dev->RegionOfInterest, 4);
+        if (dev->RegionOfInterest[2] != 0)
+            return param_write_int_array(plist, "RegionOfInterest", &roia);
+        else
+            return param_write_null(plist, "RegionOfInterest");
+    }
     if (strcmp(Param, ".HWMargins") == 0) {
         gs_param_float_array hwma;
         set_param_array(hwma, dev->HWMargins, 4);
@@ -558,6 +567,7 @@ gx_default_get_params(gx_device * dev, gs_param_list * plist)
     int GrayValues = dev->color_info.max_gray + 1;
     int HWSize[2];
     gs_param_int_array hwsa;
+    gs_param_int_array roia;
     gs_param_float_array hwma;
     cmm_dev_profile_t *dev_profile;
 
@@ -585,6 +595,7 @@ gx_default_get_params(gx_device * dev, gs_param_list * plist)
     HWSize[0] = dev->width;
     HWSize[1] = dev->height;
     set_param_array(hwsa, HWSize, 2);
+    set_param_array(roia, dev->RegionOfInterest, 4);
     set_param_array(hwma, dev->HWMargins, 4);
     /* Check if the device profile is null.  If it is, then we need to
        go ahead and get it set up at this time.  If the proc is not
@@ -739,6 +750,9 @@ gx_default_get_params(gx_device * dev, gs_param_list * plist)
         (code = param_write_int(plist,"ImageKPreserve", (const int *) &(blackpreserve[2]))) < 0 ||
         (code = param_write_int(plist,"TextKPreserve", (const int *) &(blackpreserve[3]))) < 0 ||
         (code = param_write_int_array(plist, "HWSize", &hwsa)) < 0 ||
+        (code = (dev->RegionOfInterest[2] != 0 ?
+                 param_write_int_array(plist, "RegionOfInterest", &roia) :
+                 param_write_null(plist, "RegionOfInterest"))) < 0 ||
         (code = param_write_float_array(plist, ".HWMargins", &hwma)) < 0 ||
         (code = param_write_float_array(plist, ".MediaSize", &msa)) < 0 ||
         (code = param_write_string(plist, "Name", &dns)) < 0 ||
@@ -1491,6 +1505,8 @@ gx_default_put_params(gx_device * dev, gs_param_list * plist)
     bool locksafe = dev->LockSafetyParams;
     gs_param_float_array ibba;
     bool ibbnull = false;
+    gs_param_int_array roia;
+    bool roinull = false;
     int colors = dev->color_info.num_components;
     int depth = dev->color_info.depth;
     int GrayValues = dev->color_info.max_gray + 1;
@@ -1625,6 +1641,42 @@ e:	param_signal_error(plist, param_name, ecode);\
         else
             break;
     } END_ARRAY_PARAM(hwsa, hwse);
+    /* RegionOfInterest is in device pixels of the whole page; null, or */
+    /* all zeros, means the whole page. */
+    switch (code = param_read_int_array(plist, (param_name = "RegionOfInterest"), &roia)) {
+        case 0:
+            if (roia.size != 4)
+                ecode = gs_note_error(gs_error_rangecheck);
+            else if (roia.data[0] == 0 && roia.data[1] == 0 &&
+                     roia.data[2] == 0 && roia.data[3] == 0) {
+                roinull = true;
+                roia.data = 0;
+                break;
+            } else if (roia.data[0] < 0 || roia.data[1] < 0 ||
+                       roia.data[2] <= roia.data[0] ||
+                       roia.data[3] <= roia.data[1])
+                ecode = gs_note_error(gs_error_rangecheck);
+#define max_coord (max_fixed / fixed_1)
+#if max_coord < max_int
+            else if (roia.data[2] > max_coord || roia.data[3] > max_coord)
+                ecode = gs_note_error(gs_error_limitcheck);
+#endif
+#undef max_coord
+            else
+                break;
+            goto roie;
+        default:
+            if ((code = param_read_null(plist, param_name)) == 0) {
+                roinull = true;
+                roia.data = 0;
+                break;
+            }
+            ecode = code;	/* can't be 1 */
+          roie:param_signal_error(plist, param_name, ecode);
+        case 1:
+            roia.data = 0;
+            break;
+    }
     {
         int t;
 
@@ -2170,6 +2222,18 @@ label:\
 
     dev->color_info.use_antidropout_downscaler = use_antidropout;
 
+    /* Do this first, so that the size changes below keep to the region. */
+    if ((roia.data != 0 &&
+         (dev->RegionOfInterest[0] != roia.data[0] ||
+          dev->RegionOfInterest[1] != roia.data[1] ||
+          dev->RegionOfInterest[2] != roia.data[2] ||
+          dev->RegionOfInterest[3] != roia.data[3])) ||
+        (roinull && dev->RegionOfInterest[2] != 0)
+        ) {
+        if (dev->is_open)
+            gs_closedevice(dev);
+        gx_device_set_region_of_interest(dev, roia.data);
+    }
     if (hwra.data != 0 &&
         (dev->HWResolution[0] != hwra.data[0] ||
          dev->HWResolution[1] != hwra.data[1])
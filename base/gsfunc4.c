@@ -29,11 +29,36 @@
 #include "spprint.h"
 #include "stream.h"
 
+/*
+ * Define the limits of the compiled form of a function (see calc_compile).
+ * Registers are addressed by a byte, so MAX_CALC_REGS must not exceed 256.
+ */
+#define MAX_CALC_INSNS 128
+#define MAX_CALC_REGS 256
+#define MAX_CALC_STACK 100	/* per PDF spec */
+#define MAX_CALC_OUTPUTS 64
+
+/* A 3-address instruction: regs[dst] = op(regs[a], regs[b]). */
+typedef struct calc_insn_s {
+    byte op;			/* gs_PtCr_opcode_t */
+    byte dst, a, b;
+} calc_insn_t;
+
 typedef struct gs_function_PtCr_s {
     gs_function_head_t head;
     gs_function_PtCr_params_t params;
     /* Define a bogus DataSource for get_function_info. */
     gs_data_source_t data_source;
+    /*
+     * Straight-line register form of params.ops, or num_insns < 0 if the
+     * function must be interpreted.  Registers 0..m-1 hold the inputs,
+     * the rest of regs[] gives the initial values of the constants.
+     */
+    int num_insns;
+    int num_regs;
+    calc_insn_t insns[MAX_CALC_INSNS];
+    byte outputs[MAX_CALC_OUTPUTS];
+    float regs[MAX_CALC_REGS];
 } gs_function_PtCr_t;
 
 /* GC descriptor */
@@ -68,6 +93,313 @@ store_float(calc_value_t *vsp, double f)
     vsp->type = CVT_FLOAT;
 }
 
+/*
+ * Apply one arithmetic operator to float operands.  This is shared by the
+ * constant folder and the compiled evaluator, and must give exactly the
+ * same results as the floating point cases of fn_PtCr_evaluate.
+ */
+static inline int
+calc_float_op(int op, float a, float b, float *result)
+{
+    double r;
+    int code;
+
+    switch (op) {
+    case PtCr_abs:
+        *result = fabs(a); break;
+    case PtCr_add:
+        *result = a + b; break;
+    case PtCr_atan:
+        code = gs_atan2_degrees(a, b, &r);
+        if (code < 0)
+            return code;
+        *result = r; break;
+    case PtCr_ceiling:
+        *result = ceil(a); break;
+    case PtCr_cos:
+        *result = gs_cos_degrees(a); break;
+    case PtCr_div:
+        if (b == 0)
+            return_error(gs_error_undefinedresult);
+        *result = a / b; break;
+    case PtCr_exp:
+        *result = pow(a, b); break;
+    case PtCr_floor:
+        *result = floor(a); break;
+    case PtCr_ln:
+        *result = log(a); break;
+    case PtCr_log:
+        *result = log10(a); break;
+    case PtCr_mul:
+        *result = a * b; break;
+    case PtCr_neg:
+        *result = -a; break;
+    case PtCr_round:
+        *result = floor(a + 0.5); break;
+    case PtCr_sin:
+        *result = gs_sin_degrees(a); break;
+    case PtCr_sqrt:
+        *result = sqrt(a); break;
+    case PtCr_sub:
+        *result = a - b; break;
+    case PtCr_truncate:
+        *result = (a < 0 ? ceil(a) : floor(a)); break;
+    default:
+        return_error(gs_error_unregistered); /* can't happen */
+    }
+    return 0;
+}
+
+/*
+ * Compile the operation string into straight-line code over float
+ * registers.  Most tint transforms and shading functions are a fixed
+ * sequence of stack and arithmetic operators, so we can run the stack
+ * at compile time: stack operators only shuffle register references,
+ * operators on constants are folded, and everything else becomes one
+ * instruction.  Anything we can't handle exactly this way (conditionals,
+ * loops, booleans, integer-only operators, cvi of a variable, or
+ * anything that would raise an error) leaves num_insns < 0, and the
+ * function is interpreted as before.
+ */
+#define CALC_MAX_EXACT_INT 0x1000000	/* 2^24, exact in a float */
+static void
+calc_compile(gs_function_PtCr_t *pfn)
+{
+    byte stack[MAX_CALC_STACK];
+    byte is_const[MAX_CALC_REGS], is_int[MAX_CALC_REGS];
+    int m = pfn->params.m, n = pfn->params.n;
+    int sp = m, nregs = m, ninsns = 0;
+    const byte *p = pfn->params.ops.data;
+    int i;
+
+    pfn->num_insns = -1;
+    if (p == NULL || m > MAX_CALC_STACK || n > MAX_CALC_OUTPUTS)
+        return;
+    for (i = 0; i < m; ++i) {
+        stack[i] = i;
+        is_const[i] = is_int[i] = 0;
+    }
+    for (;;) {
+        int op = *p++;
+        int a, b, k, j;
+        float v, fv;
+        double dv;
+        bool int_result;
+
+        switch (op) {
+
+            /* Constants */
+
+        case PtCr_byte:
+            v = *p++;
+            int_result = true;
+            goto push_const;
+        case PtCr_int:
+            memcpy(&k, p, sizeof(int));
+            p += sizeof(int);
+            if (k < -CALC_MAX_EXACT_INT || k > CALC_MAX_EXACT_INT)
+                return;
+            v = (float)k;
+            int_result = true;
+            goto push_const;
+        case PtCr_float:
+            memcpy(&v, p, sizeof(float));
+            p += sizeof(float);
+            int_result = false;
+        push_const:
+            if (sp == MAX_CALC_STACK || nregs == MAX_CALC_REGS)
+                return;
+            pfn->regs[nregs] = v;
+            is_const[nregs] = 1;
+            is_int[nregs] = int_result;
+            stack[sp++] = nregs++;
+            continue;
+
+            /* Stack operators */
+
+        case PtCr_dup:
+            if (sp < 1 || sp == MAX_CALC_STACK)
+                return;
+            stack[sp] = stack[sp - 1];
+            ++sp;
+            continue;
+        case PtCr_exch:
+            if (sp < 2)
+                return;
+            a = stack[sp - 1];
+            stack[sp - 1] = stack[sp - 2];
+            stack[sp - 2] = a;
+            continue;
+        case PtCr_pop:
+            if (sp < 1)
+                return;
+            --sp;
+            continue;
+        case PtCr_copy:
+        case PtCr_index:
+            if (sp < 1 || !is_int[stack[sp - 1]])
+                return;
+            k = (int)pfn->regs[stack[--sp]];
+            if (op == PtCr_index) {
+                if (k < 0 || k >= sp)
+                    return;
+                stack[sp] = stack[sp - 1 - k];
+                ++sp;
+                continue;
+            }
+            if (k < 0 || k > sp || sp + k > MAX_CALC_STACK)
+                return;
+            for (j = 0; j < k; ++j, ++sp)
+                stack[sp] = stack[sp - k];
+            continue;
+        case PtCr_roll: {
+            byte temp[MAX_CALC_STACK];
+
+            if (sp < 2 || !is_int[stack[sp - 1]] || !is_int[stack[sp - 2]])
+                return;
+            j = (int)pfn->regs[stack[sp - 1]];
+            k = (int)pfn->regs[stack[sp - 2]];
+            sp -= 2;
+            if (k < 0 || k > sp)
+                return;
+            if (k == 0)
+                continue;
+            j %= k;
+            if (j < 0)
+                j += k;
+            memcpy(temp, &stack[sp - k], k);
+            for (i = 0; i < k; ++i)
+                stack[sp - k + (i + j) % k] = temp[i];
+            continue;
+        }
+
+            /* Arithmetic operators */
+
+        case PtCr_abs: case PtCr_ceiling: case PtCr_cos: case PtCr_cvi:
+        case PtCr_cvr: case PtCr_floor: case PtCr_ln: case PtCr_log:
+        case PtCr_neg: case PtCr_round: case PtCr_sin: case PtCr_sqrt:
+        case PtCr_truncate:
+            if (sp < 1)
+                return;
+            a = stack[--sp];
+            if (!is_const[a]) {
+                if (op == PtCr_cvi)
+                    return;	/* would need integer arithmetic */
+                if (op == PtCr_cvr) {
+                    ++sp;
+                    continue;
+                }
+                b = a;
+                goto emit;
+            }
+            v = pfn->regs[a];
+            int_result = false;
+            switch (op) {
+            case PtCr_abs:
+            case PtCr_neg:
+                if (is_int[a]) {
+                    v = (op == PtCr_neg || v < 0 ? -v : v);
+                    int_result = true;
+                    goto push_const;
+                }
+                break;
+            case PtCr_cvi:
+                if (!(v > -CALC_MAX_EXACT_INT && v < CALC_MAX_EXACT_INT))
+                    return;
+                v = (float)(int)v;
+                /* fall through */
+            case PtCr_ceiling: case PtCr_floor: case PtCr_round:
+            case PtCr_truncate:
+                if (is_int[a] || op == PtCr_cvi) {
+                    int_result = true;
+                    goto push_const;
+                }
+                break;
+            case PtCr_cvr:
+                goto push_const;
+            }
+            if (calc_float_op(op, v, 0, &fv) < 0)
+                return;
+            v = fv;
+            goto push_const;
+
+        case PtCr_add: case PtCr_atan: case PtCr_div: case PtCr_exp:
+        case PtCr_mul: case PtCr_sub:
+            if (sp < 2)
+                return;
+            b = stack[--sp];
+            a = stack[--sp];
+            if (!is_const[a] || !is_const[b])
+                goto emit;
+            if (is_int[a] && is_int[b] &&
+                (op == PtCr_add || op == PtCr_sub || op == PtCr_mul)) {
+                dv = (op == PtCr_add ? (double)pfn->regs[a] + pfn->regs[b] :
+                      op == PtCr_sub ? (double)pfn->regs[a] - pfn->regs[b] :
+                      (double)pfn->regs[a] * pfn->regs[b]);
+                if (dv < -CALC_MAX_EXACT_INT || dv > CALC_MAX_EXACT_INT)
+                    return;
+                v = (float)dv;
+                int_result = true;
+                goto push_const;
+            }
+            if (calc_float_op(op, pfn->regs[a], pfn->regs[b], &fv) < 0)
+                return;
+            v = fv;
+            int_result = false;
+            goto push_const;
+        emit:
+            if (ninsns == MAX_CALC_INSNS || nregs == MAX_CALC_REGS)
+                return;
+            pfn->insns[ninsns].op = op;
+            pfn->insns[ninsns].dst = nregs;
+            pfn->insns[ninsns].a = a;
+            pfn->insns[ninsns].b = b;
+            ++ninsns;
+            is_const[nregs] = is_int[nregs] = 0;
+            pfn->regs[nregs] = 0;
+            stack[sp++] = nregs++;
+            continue;
+
+        case PtCr_return:
+            break;
+        default:
+            return;
+        }
+        break;
+    }
+    /* Following Acrobat, the outputs are the top n stack entries. */
+    if (sp < n)
+        return;
+    for (i = 0; i < n; ++i)
+        pfn->outputs[i] = stack[sp - n + i];
+    pfn->num_regs = nregs;
+    pfn->num_insns = ninsns;
+}
+
+/* Evaluate the compiled form of a function. */
+static int
+calc_evaluate_compiled(const gs_function_PtCr_t *pfn, const float *in,
+                       float *out)
+{
+    float regs[MAX_CALC_REGS];
+    const calc_insn_t *pi = pfn->insns;
+    const calc_insn_t *end = pi + pfn->num_insns;
+    int i, code;
+
+    memcpy(regs, in, pfn->params.m * sizeof(float));
+    memcpy(regs + pfn->params.m, pfn->regs + pfn->params.m,
+           (pfn->num_regs - pfn->params.m) * sizeof(float));
+    for (; pi < end; ++pi) {
+        code = calc_float_op(pi->op, regs[pi->a], regs[pi->b],
+                             &regs[pi->dst]);
+        if (code < 0)
+            return code;
+    }
+    for (i = 0; i < pfn->params.n; ++i)
+        out[i] = regs[pfn->outputs[i]];
+    return 0;
+}
+
 /*
  * Define extended opcodes with typed operands.  We use the original
  * opcodes for the floating-point case.
@@ -221,6 +553,9 @@ fn_PtCr_evaluate(const gs_function_t *pfn_common, const float *in, float *out)
         OP_NONE(PtCr_repeat_end)	/* repeat_end */
     };
 
+    if (pfn->num_insns >= 0)
+        return calc_evaluate_compiled(pfn, in, out);
+
     memset(repeat_count, 0x00, MAX_PSC_FUNCTION_NESTING * sizeof(int));
     memset(repeat_proc_size, 0x00, MAX_PSC_FUNCTION_NESTING * sizeof(int));
 
@@ -792,6 +1127,7 @@ fn_PtCr_make_scaled(const gs_function_PtCr_t *pfn, gs_function_PtCr_t **ppsfn,
     psfn->params.ops.data =
         gs_resize_string(mem, ops, opsize, psfn->params.ops.size,
                          "fn_PtCr_make_scaled");
+    calc_compile(psfn);
     *ppsfn = psfn;
     return 0;
 }
@@ -894,6 +1230,7 @@ gs_function_PtCr_init(gs_function_t ** ppfn,
         data_source_init_string2(&pfn->data_source, NULL, 0);
         pfn->data_source.access = calc_access;
         pfn->head = function_PtCr_head;
+        calc_compile(pfn);
         *ppfn = (gs_function_t *) pfn;
     }
     return 0;
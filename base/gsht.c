@@ -1388,7 +1388,10 @@ gx_ht_construct_threshold( gx_ht_order *d_order, gx_device *dev,
     int row_kk, col_kk, kk;
     frac t_level_frac_color;
     int shade, base_shade = 0;
+    int shades[256];
     bool have_transfer = false, threshold_inverted = false;
+    gx_ht_memo_key_t key;
+    uint params[10];
 
     if (d_order == NULL) return -1;
     /* We can have simple or complete orders.  Simple ones tile the threshold
@@ -1420,26 +1423,53 @@ gx_ht_construct_threshold( gx_ht_order *d_order, gx_device *dev,
          dev->color_info.dither_colors - 1;
     hsize = num_levels;
     nshades = hsize * max_value + 1;
+    for (t_level = 1; t_level < 256; t_level++) {
+        t_level_frac_color = byte2frac(threshold_inverted ? 255 - t_level : t_level);
+        if (have_transfer)
+            t_level_frac_color = gx_map_color_frac(pgs, t_level_frac_color, effective_transfer[plane_index]);
+        shades[t_level] = t_level_frac_color * nshades / (frac_1_long + 1);
+    }
+
+    /* The result depends only on the order, the shades and the polarity,
+       and is shared between rendering threads and pages: see gxhtmemo.h */
+    params[0] = d_order->procs - ht_order_procs_table;
+    params[1] = d_order->width;
+    params[2] = d_order->height;
+    params[3] = d_order->raster;
+    params[4] = d_order->shift;
+    params[5] = d_order->full_height;
+    params[6] = d_order->num_levels;
+    params[7] = d_order->num_bits;
+    params[8] = threshold_inverted;
+    params[9] = dev->color_info.polarity == GX_CINFO_POLARITY_SUBTRACTIVE;
+    gx_ht_memo_key_init(&key, ht_memo_threshold_array, memory);
+    gx_ht_memo_key_add(&key, params, sizeof(params));
+    gx_ht_memo_key_add(&key, &shades[1], 255 * sizeof(shades[0]));
+    gx_ht_memo_key_add(&key, d_order->levels,
+                       (size_t)d_order->num_levels * sizeof(*d_order->levels));
+    gx_ht_memo_key_add(&key, d_order->bit_data,
+                       (size_t)d_order->num_bits * d_order->procs->bit_data_elt_size);
+    if (gx_ht_memo_lookup(memory, &key, thresh,
+                          (size_t)d_order->width * d_order->full_height, NULL, 0)) {
+        gx_ht_memo_key_release(&key);
+        d_order->threshold = thresh;
+        d_order->threshold_inverted = threshold_inverted;
+        return 0;
+    }
 
     /* search upwards to find the correct value for the last threshold value */
     /* Use this to initialize the threshold array (transition to all white) */
     t_level = 0;
     do {
         t_level++;
-        t_level_frac_color = byte2frac(threshold_inverted ? 255 - t_level : t_level);
-        if (have_transfer)
-            t_level_frac_color = gx_map_color_frac(pgs, t_level_frac_color, effective_transfer[plane_index]);
-        shade = t_level_frac_color * nshades / (frac_1_long + 1);
+        shade = shades[t_level];
     } while (shade < num_levels && t_level < 255);
     /* Initialize the thresholds to the lowest level that will be all white */
     for( i = 0; i < d_order->width * d_order->full_height; i++ ) {
         thresh[i] = t_level;
     }
     for (t_level = 1; t_level < 256; t_level++) {
-        t_level_frac_color = byte2frac(threshold_inverted ? 255 - t_level : t_level);
-        if (have_transfer)
-            t_level_frac_color = gx_map_color_frac(pgs, t_level_frac_color, effective_transfer[plane_index]);
-        shade = t_level_frac_color * nshades / (frac_1_long + 1);
+        shade = shades[t_level];
         if (shade < num_levels && shade > base_shade) {
             if (d_order->levels[shade] > d_order->levels[base_shade]) {
                 /* Loop over the number of dots that we have to set in going
@@ -1447,8 +1477,10 @@ gx_ht_construct_threshold( gx_ht_order *d_order, gx_device *dev,
                 for (j = d_order->levels[base_shade]; j < d_order->levels[shade]; j++) {
                     gs_int_point ppt;
                     code = d_order->procs->bit_index(d_order, j, &ppt);
-                    if (code < 0)
+                    if (code < 0) {
+                        gx_ht_memo_key_release(&key);
                         return code;
+                    }
                     row = ppt.y;
                     col = ppt.x;
                     if( col < (int)d_order->width ) {
@@ -1472,6 +1504,9 @@ gx_ht_construct_threshold( gx_ht_order *d_order, gx_device *dev,
                 *(thresh+j+(i*d_order->width)) = 255 - *(thresh+j+(i*d_order->width));
         }
     }
+    gx_ht_memo_store(memory, &key, thresh,
+                     (size_t)d_order->width * d_order->full_height, NULL, 0);
+    gx_ht_memo_key_release(&key);
 #ifdef DEBUG
     if ( gs_debug_c('h') ) {
          dmprintf3(memory, "threshold array component %d [ %d x %d ]:\n",
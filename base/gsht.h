@@ -20,6 +20,7 @@
 #  define gsht_INCLUDED
 
 #include "std.h"
+#include "stdint_.h"
 #include "gsgstate.h"
 #include "gstypes.h"
 
@@ -78,4 +79,14 @@ int gs_screen_currentpoint(gs_screen_enum *, gs_point *);
 int gs_screen_next(gs_screen_enum *, double);
 int gs_screen_install(gs_screen_enum *);
 
+/*
+ * Optionally, after gs_screen_init, identify the spot function by an
+ * encoding of its definition.  Clients should only do this for functions
+ * whose values depend on nothing but their arguments.  If the samples for the
+ * same function and cell are already known, this fills them in and
+ * returns 1: gs_screen_currentpoint will then return 1 straight away.
+ * Otherwise it returns 0, and the samples are remembered once complete.
+ */
+int gs_screen_set_spot_id(gs_screen_enum *, const void *, size_t);
+
 #endif /* gsht_INCLUDED */
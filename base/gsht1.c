@@ -24,6 +24,7 @@
 #include "gzstate.h"
 #include "gxdevice.h"		/* for gzht.h */
 #include "gzht.h"
+#include "gxhtmemo.h"
 
 
 /* Imports from gscolor.c */
@@ -404,7 +405,45 @@ gx_ht_complete_threshold_order(gx_ht_order * porder)
 int
 gx_ht_construct_threshold_order(gx_ht_order * porder, const byte * thresholds)
 {
-    return porder->procs->construct_order(porder, thresholds);
+    gs_memory_t *mem = porder->data_memory;
+    size_t levels_size = (size_t)porder->num_levels * sizeof(*porder->levels);
+    size_t bits_size =
+        (size_t)porder->num_bits * porder->procs->bit_data_elt_size;
+    gx_ht_memo_key_t key;
+    int code;
+
+    /*
+     * Sorting a large threshold array is slow, and the same arrays are
+     * installed over and over again, so look for a previous result.
+     */
+    if (mem != NULL) {
+        uint params[7];
+
+        params[0] = porder->procs - ht_order_procs_table;
+        params[1] = porder->width;
+        params[2] = porder->height;
+        params[3] = porder->raster;
+        params[4] = porder->shift;
+        params[5] = porder->num_levels;
+        params[6] = porder->num_bits;
+        gx_ht_memo_key_init(&key, ht_memo_threshold_order, mem);
+        gx_ht_memo_key_add(&key, params, sizeof(params));
+        gx_ht_memo_key_add(&key, thresholds, porder->num_bits);
+        if (gx_ht_memo_lookup(mem, &key, porder->levels, levels_size,
+                              porder->bit_data, bits_size)) {
+            gx_ht_memo_key_release(&key);
+            return 0;
+        }
+    }
+    code = porder->procs->construct_order(porder, thresholds);
+    /* Predefined halftones (data_memory == 0) are shared already. */
+    if (mem != NULL) {
+        if (code >= 0 && porder->data_memory != NULL)
+            gx_ht_memo_store(mem, &key, porder->levels, levels_size,
+                             porder->bit_data, bits_size);
+        gx_ht_memo_key_release(&key);
+    }
+    return code;
 }
 
 /* Process a threshold plane. */
@@ -500,6 +500,7 @@ gs_screen_enum_init_memory(gs_screen_enum * penum, const gx_ht_order * porder,
     penum->halftone.type = ht_type_screen;
     penum->halftone.params.screen = *phsp;
     penum->x = penum->y = 0;
+    penum->memo_samples = false;
 
     penum->strip = porder->num_levels / porder->width;
     penum->shift = porder->shift;
@@ -552,6 +553,14 @@ gs_screen_currentpoint(gs_screen_enum * penum, gs_point * ppt)
     gs_point spot_center; /* device coords */
 
     if (penum->y >= penum->strip) {     /* all done */
+        if (penum->memo_samples) {
+            gx_ht_memo_store(penum->order.data_memory, &penum->memo_key,
+                             penum->order.bit_data,
+                             (size_t)penum->order.width * penum->strip *
+                                 sizeof(gx_ht_bit), NULL, 0);
+            gx_ht_memo_key_release(&penum->memo_key);
+            penum->memo_samples = false;
+        }
         gx_ht_construct_spot_order(&penum->order);
         return 1;
     }
@@ -591,6 +600,43 @@ gs_screen_currentpoint(gs_screen_enum * penum, gs_point * ppt)
     return 0;
 }
 
+/* Identify the spot function, and use any samples we already have. */
+int
+gs_screen_set_spot_id(gs_screen_enum * penum, const void *spot_id,
+                      size_t size)
+{
+    const gx_ht_order *porder = &penum->order;
+    int params[9];
+
+    if (porder->data_memory == NULL || penum->x != 0 || penum->y != 0)
+        return 0;
+    /* The sample positions depend only on the cell and the strip. */
+    params[0] = porder->params.M;
+    params[1] = porder->params.N;
+    params[2] = porder->params.R;
+    params[3] = porder->params.M1;
+    params[4] = porder->params.N1;
+    params[5] = porder->params.R1;
+    params[6] = porder->width;
+    params[7] = penum->strip;
+    params[8] = penum->shift;
+    gx_ht_memo_key_init(&penum->memo_key, ht_memo_spot_samples,
+                        porder->data_memory);
+    gx_ht_memo_key_add(&penum->memo_key, params, sizeof(params));
+    gx_ht_memo_key_add(&penum->memo_key, spot_id, size);
+    if (gx_ht_memo_lookup(porder->data_memory, &penum->memo_key,
+                          porder->bit_data,
+                          (size_t)porder->width * penum->strip *
+                              sizeof(gx_ht_bit), NULL, 0)) {
+        gx_ht_memo_key_release(&penum->memo_key);
+        penum->y = penum->strip;
+        return 1;
+    }
+    /* The key is released once the samples are stored, or by the client. */
+    penum->memo_samples = true;
+    return 0;
+}
+
 /* Record next halftone sample */
 int
 gs_screen_next(gs_screen_enum * penum, double value)
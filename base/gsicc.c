@@ -362,12 +362,11 @@ gx_remap_ICC_with_link(const gs_client_color * pcc, const gs_color_space * pcs,
     cmm_dev_profile_t *dev_profile;
     unsigned short psrc[GS_CLIENT_COLOR_MAX_COMPONENTS], psrc_cm[GS_CLIENT_COLOR_MAX_COMPONENTS];
     unsigned short *psrc_temp;
-    frac conc[GS_CLIENT_COLOR_MAX_COMPONENTS];
-    int k,i;
+    int k;
 #ifdef DEBUG
     int num_src_comps;
-#endif
     int num_des_comps;
+#endif
     int code;
 
     code = dev_proc(dev, get_profile)(dev, &dev_profile);
@@ -393,7 +392,9 @@ gx_remap_ICC_with_link(const gs_client_color * pcc, const gs_color_space * pcs,
             psrc[k] = (unsigned short) (pcc->paint.values[k]*65535.0);
         }
     }
+#ifdef DEBUG
     num_des_comps = gsicc_get_device_profile_comps(dev_profile);
+#endif
     if (icc_link->is_identity) {
         psrc_temp = &(psrc[0]);
     } else {
@@ -423,12 +424,31 @@ gx_remap_ICC_with_link(const gs_client_color * pcc, const gs_color_space * pcs,
         if_debug0m(gs_debug_flag_icc, dev->memory, "]\n");
     }
 #endif
+    return gx_remap_ICC_linked(pcc, pcs, pdc, pgs, dev, select, dev_profile,
+                               psrc_temp);
+}
+
+/*
+ * The rest of gx_remap_ICC_with_link, once the color has been through the
+ * link and psrc_cm holds the device values.  Also used by the image code,
+ * which puts a whole row through the link at once.
+ */
+int
+gx_remap_ICC_linked(const gs_client_color * pcc, const gs_color_space * pcs,
+        gx_device_color * pdc, const gs_gstate * pgs, gx_device * dev,
+                gs_color_select_t select, const cmm_dev_profile_t *dev_profile,
+                const unsigned short *psrc_cm)
+{
+    frac conc[GS_CLIENT_COLOR_MAX_COMPONENTS];
+    int k, i;
+    int num_des_comps = gsicc_get_device_profile_comps(dev_profile);
+
     /* Now do the remap for ICC which amounts to the alpha application
        the transfer function and potentially the halftoning */
     /* Right now we need to go from unsigned short to frac.  I really
        would like to avoid this sort of stuff.  That will come. */
     for (k = 0; k < num_des_comps; k++){
-        conc[k] = ushort2frac(psrc_temp[k]);
+        conc[k] = ushort2frac(psrc_cm[k]);
     }
     /* In case there are extra components beyond the ICC ones */
     for (k = num_des_comps; k < dev->color_info.num_components; k++) {
@@ -459,6 +479,9 @@ gx_remap_ICC(const gs_client_color * pcc, const gs_color_space * pcs,
         return code;
     if (dev_profile == NULL)
         return gs_throw(gs_error_Fatal, "Attempting to do ICC remap with no profile");
+    /* Documents tend to use the same few colors over and over */
+    if (gsicc_get_devcolor(pgs, dev, dev_profile, pcs, pcc, pdc))
+        return 0;
 
     rendering_params.black_point_comp = pgs->blackptcomp;
     rendering_params.graphics_type_tag = dev->graphics_type_tag;
@@ -477,6 +500,8 @@ gx_remap_ICC(const gs_client_color * pcc, const gs_color_space * pcs,
     code = gx_remap_ICC_with_link(pcc, pcs, pdc, pgs, dev, select, icc_link);
     /* Release the link */
     gsicc_release_link(icc_link);
+    if (code >= 0)
+        gsicc_put_devcolor(pgs, dev, dev_profile, pcs, pcc, pdc);
     return code;
 }
 
@@ -38,5 +38,9 @@ int gx_change_color_model(gx_device *dev, int num_comps, int bit_depth);
 int gx_remap_ICC_with_link(const gs_client_color * pcc, const gs_color_space * pcs,
         gx_device_color * pdc, const gs_gstate * pgs, gx_device * dev,
                 gs_color_select_t select, gsicc_link_t *icc_link);
+int gx_remap_ICC_linked(const gs_client_color * pcc, const gs_color_space * pcs,
+        gx_device_color * pdc, const gs_gstate * pgs, gx_device * dev,
+                gs_color_select_t select, const cmm_dev_profile_t *dev_profile,
+                const unsigned short *psrc_cm);
 
 #endif /* gsicc_INCLUDED */
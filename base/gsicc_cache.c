@@ -22,7 +22,7 @@
 #include "gsstruct.h"
 #include "scommon.h"
 #include "gx.h"
-#include "gpsync.h"	/* for MAX_THREADS */
+#include "gpsync.h"
 #include "gxgstate.h"
 #include "smd5.h"
 #include "gscms.h"
@@ -35,19 +35,26 @@
 #include "gxsync.h"
 #include "gzstate.h"
 #include "stdint_.h"
+#include "gp.h"
+#include "gssprintf.h"
+#include "gxdevice.h"
+#include "gxdcolor.h"
         /*
          *  Note that the the external memory used to maintain
          *  links in the CMS is generally not visible to GS.
          *  For most CMS's the  links are 33x33x33x33x4 bytes at worst
          *  for a CMYK to CMYK MLUT which is about 4.5Mb per link.
          *  If the link were matrix based it would be much much smaller.
-         *  We will likely want to do at least have an estimate of the
-         *  memory used based upon how the CMS is configured.
-         *  This will be done later.  For now, just limit the number
-         *  of links.
+         *  So we estimate it from the size of the table the CMS
+         *  would sample the link into (see gsicc_link_size), and
+         *  limit the total of those estimates.
          */
-#define ICC_CACHE_MAXLINKS (MAX_THREADS*2)	/* allow up to two active links per thread */
+#define ICC_CACHE_MAXSIZE (64*1024*1024)
+#define ICC_CACHE_LINK_OVERHEAD (16*1024)	/* curves, the transform itself, etc. */
+/* A render thread's cache only borrows links, so is limited by count */
+#define ICC_CACHE_THREAD_MAXLINKS 32
 #define ICC_CACHE_NOT_VALID_COUNT 20  /* This should not really occur. If it does we need to take a closer look */
+#define ICC_LINK_FILE_MAXSIZE (64*1024*1024)  /* more than any table lcms makes */
 
 /* Static prototypes */
 
@@ -64,6 +71,13 @@ static int gsicc_compute_linkhash(gsicc_manager_t *icc_manager, gx_device *dev,
 
 static void gsicc_remove_link(gsicc_link_t *link, const gs_memory_t *memory);
 
+static gsicc_link_t *gsicc_get_link_cache(const gs_gstate *pgs, gx_device *dev,
+                                          gsicc_link_cache_t *icc_link_cache,
+                                          cmm_profile_t *gs_input_profile,
+                                          cmm_profile_t *gs_output_profile,
+                                          gsicc_rendering_param_t *rendering_params,
+                                          gs_memory_t *memory, bool devicegraytok);
+
 static void gsicc_get_buff_hash(unsigned char *data, int64_t *hash, unsigned int num_bytes);
 
 static void rc_gsicc_link_cache_free(gs_memory_t * mem, void *ptr_in, client_name_t cname);
@@ -72,15 +86,15 @@ static void rc_gsicc_link_cache_free(gs_memory_t * mem, void *ptr_in, client_nam
 
 struct_proc_finalize(icc_link_finalize);
 
-gs_private_st_ptrs3_final(st_icc_link, gsicc_link_t, "gsiccmanage_link",
+gs_private_st_ptrs4_final(st_icc_link, gsicc_link_t, "gsiccmanage_link",
                     icc_link_enum_ptrs, icc_link_reloc_ptrs, icc_link_finalize,
-                    icc_link_cache, next, lock);
+                    icc_link_cache, next, lock, shared);
 
 struct_proc_finalize(icc_linkcache_finalize);
 
 gs_private_st_ptrs3_final(st_icc_linkcache, gsicc_link_cache_t, "gsiccmanage_linkcache",
                     icc_linkcache_enum_ptrs, icc_linkcache_reloc_ptrs, icc_linkcache_finalize,
-                    head, lock, full_wait);
+                    head, lock, shared);
 
 /* These are used to construct a hash for the ICC link based upon the
    render parameters */
@@ -107,9 +121,12 @@ gsicc_cache_new(gs_memory_t *memory)
         return(NULL);
     result->head = NULL;
     result->num_links = 0;
-    result->cache_full = false;
+    result->size = 0;
     result->memory = memory->stable_memory;
-    result->full_wait = NULL; /* Required so finaliser can work when result freed. */
+    result->shared = NULL;
+    result->num_created = 0;
+    result->num_hits = 0;
+    result->devcolors = NULL;
     rc_init_free(result, memory->stable_memory, 1, rc_gsicc_link_cache_free);
     result->lock = gx_monitor_label(gx_monitor_alloc(memory->stable_memory),
                                     "gsicc_cache_new");
@@ -117,30 +134,62 @@ gsicc_cache_new(gs_memory_t *memory)
         rc_decrement(result, "gsicc_cache_new");
         return(NULL);
     }
-    result->full_wait = gx_semaphore_label(gx_semaphore_alloc(memory->stable_memory),
-                                    "gsicc_cache_new");
-    if (result->full_wait == NULL) {
-        /* Don't free result->lock, as the finaliser for result does that! */
-        rc_decrement(result, "gsicc_cache_new");
-        return(NULL);
-    }
     if_debug2m(gs_debug_flag_icc, memory,
                "[icc] Allocating link cache = "PRI_INTPTR" memory = "PRI_INTPTR"\n",
 	       (intptr_t)result, (intptr_t)result->memory);
     return(result);
 }
 
+/**
+ * gsicc_cache_new_thread: Allocate the cache for a render thread, which
+ * borrows its links from the cache shared by the threads.
+ * Return value: Pointer to allocated cache, or NULL on failure.
+ **/
+
+gsicc_link_cache_t *
+gsicc_cache_new_thread(gs_memory_t *memory, gsicc_link_cache_t *shared)
+{
+    gsicc_link_cache_t *result = gsicc_cache_new(memory);
+
+    if (result == NULL)
+        return NULL;
+    gx_monitor_enter(shared->lock);
+    rc_increment(shared);
+    gx_monitor_leave(shared->lock);
+    result->shared = shared;
+    return result;
+}
+
 static void
 rc_gsicc_link_cache_free(gs_memory_t * mem, void *ptr_in, client_name_t cname)
 {
     /* Ending the entire cache.  The ref counts on all the links should be 0 */
     gsicc_link_cache_t *link_cache = (gsicc_link_cache_t * ) ptr_in;
 
+    gsicc_link_cache_t *shared = link_cache->shared;
+
     if_debug2m(gs_debug_flag_icc, mem,
                "[icc] Removing link cache = "PRI_INTPTR" memory = "PRI_INTPTR"\n",
                (intptr_t)link_cache, (intptr_t)link_cache->memory);
+    if_debug2m(gs_debug_flag_icc, mem,
+               "[icc] links created = %ld, cache hits = %ld\n",
+               link_cache->num_created, link_cache->num_hits);
     /* NB: freeing the link_cache will call icc_linkcache_finalize */
     gs_free_object(mem->stable_memory, link_cache, "rc_gsicc_link_cache_free");
+    /* Only now have our links given back the ones they borrowed. If ours
+       is the last reference nobody else can be using the shared cache, and
+       it mustn't be freed with its lock held. */
+    if (shared != NULL) {
+        bool last;
+
+        gx_monitor_enter(shared->lock);
+        last = shared->rc.ref_count == 1;
+        if (!last)
+            rc_decrement_only(shared, "rc_gsicc_link_cache_free");
+        gx_monitor_leave(shared->lock);
+        if (last)
+            rc_decrement_only(shared, "rc_gsicc_link_cache_free");
+    }
 }
 
 /* release the monitor of the link_cache when it is freed */
@@ -165,9 +214,10 @@ icc_linkcache_finalize(const gs_memory_t *mem, void *ptr)
     if (link_cache->rc.ref_count == 0) {
         gx_monitor_free(link_cache->lock);
         link_cache->lock = NULL;
-        gx_semaphore_free(link_cache->full_wait);
-        link_cache->full_wait = 0;
     }
+    gs_free_object(link_cache->memory->non_gc_memory, link_cache->devcolors,
+                   "icc_linkcache_finalize");
+    link_cache->devcolors = NULL;
 }
 
 /* This is a special allocation for a link that is used by devices for
@@ -215,6 +265,8 @@ gsicc_alloc_link_dev(gs_memory_t *memory, cmm_profile_t *src_profile,
     result->is_identity = false;
     result->valid = true;
     result->memory = memory->stable_memory;
+    result->size = 0;
+    result->shared = NULL;
 
     if_debug1m('^', result->memory, "[^]icclink "PRI_INTPTR" init = 1\n",
                (intptr_t)result);
@@ -297,6 +349,8 @@ gsicc_alloc_link(gs_memory_t *memory, gsicc_hashlink_t hashcode)
     result->is_identity = false;
     result->valid = false;		/* not yet complete */
     result->memory = memory->stable_memory;
+    result->size = 0;
+    result->shared = NULL;
 
     result->lock = gx_monitor_label(gx_monitor_alloc(memory->stable_memory),
                                     "gsicc_link_new");
@@ -311,6 +365,26 @@ gsicc_alloc_link(gs_memory_t *memory, gsicc_hashlink_t hashcode)
     return result;
 }
 
+/* An estimate of the memory behind a link with the given number of inputs
+   and outputs.  Neither lcms nor CAL tell us, but with three or more inputs
+   they sample the transform into a 16 bit table, by default on a grid of the
+   size given here, and that is most of it. */
+static size_t
+gsicc_link_size(int num_in, int num_out)
+{
+    size_t size = ICC_CACHE_LINK_OVERHEAD;
+    size_t table = num_out * 2;
+    int grid = num_in > 4 ? 7 : (num_in == 4 ? 17 : 33);
+    int k;
+
+    if (num_in >= 3) {
+        for (k = 0; k < num_in; k++)
+            table *= grid;
+        size += table;
+    }
+    return size;
+}
+
 static void
 gsicc_set_link_data(gsicc_link_t *icc_link, void *link_handle,
                     gsicc_hashlink_t hashcode, gx_monitor_t *lock,
@@ -321,6 +395,9 @@ gsicc_set_link_data(gsicc_link_t *icc_link, void *link_handle,
     icc_link->link_handle = link_handle;
     gscms_get_link_dim(link_handle, &(icc_link->num_input), &(icc_link->num_output),
         icc_link->memory);
+    icc_link->size = gsicc_link_size(icc_link->num_input, icc_link->num_output);
+    icc_link->icc_link_cache->size += icc_link->size;
+    icc_link->icc_link_cache->num_created++;
     icc_link->hashcode.link_hashcode = hashcode.link_hashcode;
     icc_link->hashcode.des_hash = hashcode.des_hash;
     icc_link->hashcode.src_hash = hashcode.src_hash;
@@ -344,10 +421,41 @@ gsicc_set_link_data(gsicc_link_t *icc_link, void *link_handle,
     gx_monitor_leave(lock);	/* done with updating, let everyone run */
 }
 
+/* Fill in a link in a render thread's cache from the one it borrows from
+   the shared cache, whose reference it takes over. */
+static void
+gsicc_borrow_link(gsicc_link_t *icc_link, gsicc_link_t *shared_link,
+                  gx_monitor_t *lock)
+{
+    gx_monitor_enter(lock);
+    icc_link->link_handle = shared_link->link_handle;
+    icc_link->procs = shared_link->procs;
+    icc_link->orig_procs = shared_link->orig_procs;
+    icc_link->is_monitored = shared_link->is_monitored;
+    icc_link->hashcode = shared_link->hashcode;
+    icc_link->includes_softproof = shared_link->includes_softproof;
+    icc_link->includes_devlink = shared_link->includes_devlink;
+    icc_link->is_identity = shared_link->is_identity;
+    icc_link->data_cs = shared_link->data_cs;
+    icc_link->num_input = shared_link->num_input;
+    icc_link->num_output = shared_link->num_output;
+    icc_link->shared = shared_link;
+    icc_link->valid = true;
+    gx_monitor_leave(icc_link->lock);
+    gx_monitor_leave(lock);
+}
+
 static void
 gsicc_link_free_contents(gsicc_link_t *icc_link)
 {
-    icc_link->procs.free_link(icc_link);
+    if (icc_link->shared != NULL) {
+        /* The handle belongs to the shared link */
+        gsicc_release_link(icc_link->shared);
+        icc_link->shared = NULL;
+        icc_link->link_handle = NULL;
+    } else {
+        icc_link->procs.free_link(icc_link);
+    }
     gx_monitor_free(icc_link->lock);
     icc_link->lock = NULL;
 }
@@ -553,6 +661,7 @@ gsicc_findcachelink(gsicc_hashlink_t hash, gsicc_link_cache_t *icc_link_cache,
             }
             /* bump the ref_count since we will be using this one */
             curr->ref_count++;
+            icc_link_cache->num_hits++;
             if_debug3m('^', curr->memory, "[^]%s "PRI_INTPTR" ++ => %d\n",
                        "icclink", (intptr_t)curr, curr->ref_count);
             while (curr->valid == false) {
@@ -619,10 +728,7 @@ gsicc_remove_link(gsicc_link_t *link, const gs_memory_t *memory)
     /* use it (ref_count > 0). Skip freeing it if so.                          */
     if (curr == link && link->ref_count == 0) {
         icc_link_cache->num_links--;	/* no longer in the cache */
-        if (icc_link_cache->cache_full) {
-            icc_link_cache->cache_full = false;
-            gx_semaphore_signal(icc_link_cache->full_wait);	/* let a waiting thread run */
-        }
+        icc_link_cache->size -= link->size;
         gx_monitor_leave(icc_link_cache->lock);
         gsicc_link_free(link, memory);	/* outside link cache now. */
     } else {
@@ -871,65 +977,34 @@ gsicc_get_link(const gs_gstate *pgs1, gx_device *dev_in,
    different functions that can each add an entry.  For example, entrys may
    come from the CMM or they may come from the non color managed approach
    (i.e. gsicc_nocm_get_link)
-   Returns true if link was found with that has, false if alloc fails.
+   *ret_link is NULL if the allocation fails.
 */
-bool
+void
 gsicc_alloc_link_entry(gsicc_link_cache_t *icc_link_cache,
                        gsicc_link_t **ret_link, gsicc_hashlink_t hash,
                        bool include_softproof, bool include_devlink)
 {
     gs_memory_t *cache_mem = icc_link_cache->memory;
-    gsicc_link_t *link;
-    int retries = 0;
+    gsicc_link_t *link, *unused;
 
     *ret_link = NULL;
-    /* First see if we can add a link */
-    /* TODO: this should be based on memory usage, not just num_links */
     gx_monitor_enter(icc_link_cache->lock);
-    while (icc_link_cache->num_links >= ICC_CACHE_MAXLINKS) {
-        /* Look through the cache for first zero ref count to re-use that entry.
-           When ref counts go to zero, the icc_link will have been moved to
-           the end of the list, so the first we find is the 'oldest'.
-           If we get to the last entry we release the lock, set the cache_full
-           flag and wait on full_wait for some other thread to let this thread
-           run again after releasing a cache slot. Release the cache lock to
-           let other threads run and finish with (release) a cache entry.
-        */
-        link = icc_link_cache->head;
-        while (link != NULL ) {
-            if (link->ref_count == 0) {
-                /* we will use this one */
-                if_debug3m('^', cache_mem, "[^]%s "PRI_INTPTR" ++ => %d\n",
-                           "icclink", (intptr_t)link, link->ref_count);
-                break;
-            }
-            link = link->next;
-        }
-        if (link == NULL) {
-            icc_link_cache->cache_full = true;
-            /* unlock while waiting for a link to come available */
-            gx_monitor_leave(icc_link_cache->lock);
-            gx_semaphore_wait(icc_link_cache->full_wait);
-            /* repeat the findcachelink to see if some other thread has	*/
-            /* already started building the link we need		*/
-            *ret_link = gsicc_findcachelink(hash, icc_link_cache,
-                                            include_softproof, include_devlink);
-            /* Got a hit, return link. ref_count for the link was already bumped */
-            if (*ret_link != NULL)
-                return true;
-
-            gx_monitor_enter(icc_link_cache->lock);	    /* restore the lock */
-            /* we will re-test the num_links above while locked to insure */
-            /* that some other thread didn't grab the slot and max us out */
-            if (retries++ > 10)
-                return false;
-        } else {
-            /* Remove the zero ref_count link profile we found.		*/
-            /* Even if we remove this link, we may still be maxed out so*/
-            /* the outermost 'while' will check to make sure some other	*/
-            /* thread did not grab the one we remove.			*/
-            gsicc_remove_link(link, cache_mem);
+    /* Make room by removing the least recently used links that nobody is
+       using. When ref counts go to zero, the icc_link is moved to the start
+       of the unused links at the end of the list, so the last of them is
+       the oldest. If they are all in use, go over the limit rather than
+       wait: they will be removed here once they are released. */
+    while (icc_link_cache->shared == NULL ?
+           icc_link_cache->size >= ICC_CACHE_MAXSIZE :
+           icc_link_cache->num_links >= ICC_CACHE_THREAD_MAXLINKS) {
+        unused = NULL;
+        for (link = icc_link_cache->head; link != NULL; link = link->next) {
+            if (link->ref_count == 0)
+                unused = link;
         }
+        if (unused == NULL)
+            break;
+        gsicc_remove_link(unused, cache_mem);
     }
     /* insert an empty link that we will reserve so we can unlock while	*/
     /* building the link contents. If successful, the entry will set	*/
@@ -945,7 +1020,126 @@ gsicc_alloc_link_entry(gsicc_link_cache_t *icc_link_cache,
     }
     /* unlock before returning */
     gx_monitor_leave(icc_link_cache->lock);
-    return false;	/* we didn't find it, but return a link to be filled */
+}
+
+/* The on-disk link cache.  If ICCLinkCacheDir is set, the links the CMS
+   can save (see gscms_save_link) are kept in files there, named from the
+   link hash, so other jobs and processes can read them rather than build
+   them again.  A file is written under a temporary name and then renamed,
+   so it is complete if it is there at all, and any number of processes can
+   share the directory.  The header holds everything the link was built
+   from, so a file from another configuration or machine is not used. */
+typedef struct gsicc_link_file_header_s {
+    char magic[8];
+    int64_t src_hash;
+    int64_t des_hash;
+    int64_t rend_hash;
+    int cms_flags;
+    int accuracy;
+    int size;			/* of the CMS data that follows */
+} gsicc_link_file_header_t;
+
+static void
+gsicc_link_file_header(gsicc_link_file_header_t *header, gsicc_hashlink_t *hash,
+                       int cms_flags, gs_memory_t *memory)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, "GSICCLK1", 8);
+    header->src_hash = hash->src_hash;
+    header->des_hash = hash->des_hash;
+    header->rend_hash = hash->rend_hash;
+    header->cms_flags = cms_flags;
+    header->accuracy = gs_lib_ctx_get_interp_instance(memory)->icc_color_accuracy;
+}
+
+static int
+gsicc_link_file_name(char *fname, gsicc_hashlink_t *hash, int cms_flags,
+                     gs_memory_t *memory)
+{
+    char dir[gp_file_name_sizeof];
+    const char *sep = gp_file_name_directory_separator();
+    int len = gs_lib_ctx_get_icc_link_cache_directory(memory, dir, sizeof(dir));
+
+    if (len < 0)
+        return -1;		/* No cache directory */
+    if (len > 0 && strncmp(dir + len - strlen(sep), sep, strlen(sep)) == 0)
+        sep = "";
+    len = gs_snprintf(fname, gp_file_name_sizeof, "%s%sgs_%08x%08x_%x_%d.icl",
+                      dir, sep, (uint)((uint64_t)hash->link_hashcode >> 32),
+                      (uint)hash->link_hashcode, cms_flags,
+                      gs_lib_ctx_get_interp_instance(memory)->icc_color_accuracy);
+    return len < 0 || len >= gp_file_name_sizeof ? -1 : 0;
+}
+
+static gcmmhlink_t
+gsicc_read_link_file(gsicc_hashlink_t *hash, int cms_flags, gs_memory_t *memory)
+{
+    char fname[gp_file_name_sizeof];
+    gsicc_link_file_header_t header, expected;
+    gp_file *f;
+    byte *data = NULL;
+    gcmmhlink_t link_handle = NULL;
+    int size;
+
+    if (gsicc_link_file_name(fname, hash, cms_flags, memory) < 0)
+        return NULL;
+    f = gp_fopen(memory, fname, "rb");
+    if (f == NULL)
+        return NULL;
+    gsicc_link_file_header(&expected, hash, cms_flags, memory);
+    if (gp_fread(&header, sizeof(header), 1, f) == 1) {
+        size = header.size;
+        header.size = 0;
+        if (memcmp(&header, &expected, sizeof(header)) == 0 &&
+            size > 0 && size <= ICC_LINK_FILE_MAXSIZE)
+            data = gs_alloc_bytes(memory, size, "gsicc_read_link_file");
+        if (data != NULL && gp_fread(data, 1, size, f) == size)
+            link_handle = gscms_load_link(data, size, memory);
+        gs_free_object(memory, data, "gsicc_read_link_file");
+    }
+    gp_fclose(f);
+    if (link_handle != NULL)
+        if_debug1m(gs_debug_flag_icc, memory, "[icc] Link read from %s\n", fname);
+    return link_handle;
+}
+
+static void
+gsicc_write_link_file(gcmmhlink_t link_handle, gsicc_hashlink_t *hash,
+                      int cms_flags, gs_memory_t *memory)
+{
+    char fname[gp_file_name_sizeof];
+    char prefix[gp_file_name_sizeof];
+    char tmpname[gp_file_name_sizeof];
+    gsicc_link_file_header_t header;
+    gp_file *f;
+    byte *data;
+    int size, code = -1;
+
+    if (gsicc_link_file_name(fname, hash, cms_flags, memory) < 0)
+        return;
+    data = gscms_save_link(link_handle, &size, memory);
+    if (data == NULL)
+        return;
+    /* The name of the temporary file starts with that of the real one */
+    memcpy(prefix, fname, strlen(fname) - 4);
+    prefix[strlen(fname) - 4] = 0;
+    f = gp_open_scratch_file(memory, prefix, tmpname, "wb");
+    if (f != NULL) {
+        gsicc_link_file_header(&header, hash, cms_flags, memory);
+        header.size = size;
+        if (gp_fwrite(&header, sizeof(header), 1, f) == 1 &&
+            gp_fwrite(data, 1, size, f) == size)
+            code = 0;
+        if (gp_fclose(f) != 0)
+            code = -1;
+        if (code == 0)
+            code = gp_rename(memory, tmpname, fname);
+        if (code != 0)
+            gp_unlink(memory, tmpname);
+        else
+            if_debug1m(gs_debug_flag_icc, memory, "[icc] Link written to %s\n", fname);
+    }
+    gs_free_object(memory, data, "gsicc_write_link_file");
 }
 
 /* This is the main function called to obtain a linked transform from the ICC
@@ -961,13 +1155,25 @@ gsicc_get_link_profile(const gs_gstate *pgs, gx_device *dev,
                        cmm_profile_t *gs_output_profile,
                        gsicc_rendering_param_t *rendering_params,
                        gs_memory_t *memory, bool devicegraytok)
+{
+    return gsicc_get_link_cache(pgs, dev, pgs->icc_link_cache, gs_input_profile,
+                                gs_output_profile, rendering_params, memory,
+                                devicegraytok);
+}
+
+static gsicc_link_t*
+gsicc_get_link_cache(const gs_gstate *pgs, gx_device *dev,
+                     gsicc_link_cache_t *icc_link_cache,
+                     cmm_profile_t *gs_input_profile,
+                     cmm_profile_t *gs_output_profile,
+                     gsicc_rendering_param_t *rendering_params,
+                     gs_memory_t *memory, bool devicegraytok)
 {
     gsicc_hashlink_t hash;
     gsicc_link_t *link, *found_link;
     gcmmhlink_t link_handle = NULL;
     gsicc_manager_t *icc_manager = pgs->icc_manager;
-    gsicc_link_cache_t *icc_link_cache = pgs->icc_link_cache;
-    gs_memory_t *cache_mem = pgs->icc_link_cache->memory;
+    gs_memory_t *cache_mem = icc_link_cache->memory;
     gcmmhprofile_t *cms_input_profile = NULL;
     gcmmhprofile_t *cms_output_profile = NULL;
     gcmmhprofile_t *cms_proof_profile = NULL;
@@ -1077,12 +1283,28 @@ gsicc_get_link_profile(const gs_gstate *pgs, gx_device *dev,
            handle that properly. */
         src_dev_link = gs_input_profile->isdevlink;
     }
-    /* No link was found so lets create a new one if there is room. This will
-       usually return a link that is not yet valid, but may return a valid link
-       if another thread has already created it */
-    if (gsicc_alloc_link_entry(icc_link_cache, &link, hash, include_softproof,
-                               include_devicelink))
+    /* A render thread's own cache borrows the link from the shared cache,
+       which builds it if it doesn't have it either */
+    if (icc_link_cache->shared != NULL) {
+        gsicc_alloc_link_entry(icc_link_cache, &link, hash, include_softproof,
+                               include_devicelink);
+        if (link == NULL)
+            return NULL;
+        found_link = gsicc_get_link_cache(pgs, dev, icc_link_cache->shared,
+                                          gs_input_profile, gs_output_profile,
+                                          rendering_params, memory, devicegraytok);
+        if (found_link == NULL) {
+            link->ref_count--;
+            gx_monitor_leave(link->lock);
+            gsicc_remove_link(link, cache_mem);
+            return NULL;
+        }
+        gsicc_borrow_link(link, found_link, icc_link_cache->lock);
         return link;
+    }
+    /* No link was found so lets create a new one. It is not yet valid. */
+    gsicc_alloc_link_entry(icc_link_cache, &link, hash, include_softproof,
+                           include_devicelink);
     if (link == NULL)
         return NULL;		/* error, couldn't allocate a link.  Nothing to cleanup */
 
@@ -1254,9 +1476,17 @@ gsicc_get_link_profile(const gs_gstate *pgs, gx_device *dev,
         }
     }
     } else {
-        link_handle = gscms_get_link(cms_input_profile, cms_output_profile,
-                                     rendering_params, cms_flags,
-                                     cache_mem->non_gc_memory);
+        /* These do nothing if there is no ICCLinkCacheDir */
+        link_handle = gsicc_read_link_file(&hash, cms_flags,
+                                           cache_mem->non_gc_memory);
+        if (link_handle == NULL) {
+            link_handle = gscms_get_link(cms_input_profile, cms_output_profile,
+                                         rendering_params, cms_flags,
+                                         cache_mem->non_gc_memory);
+            if (link_handle != NULL)
+                gsicc_write_link_file(link_handle, &hash, cms_flags,
+                                      cache_mem->non_gc_memory);
+        }
     }
     if (!gscms_is_threadsafe()) {
         if (!src_dev_link) {
@@ -1289,11 +1519,6 @@ gsicc_get_link_profile(const gs_gstate *pgs, gx_device *dev,
         link->ref_count--;	/* this thread no longer using this link entry	*/
         if_debug2m('^', link->memory, "[^]icclink "PRI_INTPTR" -- => %d\n",
                    (intptr_t)link, link->ref_count);
-
-        if (icc_link_cache->cache_full) {
-            icc_link_cache->cache_full = false;
-            gx_semaphore_signal(icc_link_cache->full_wait);	/* let a waiting thread run */
-        }
         gx_monitor_leave(link->lock);
         goto icc_link_error;
     }
@@ -1837,11 +2062,6 @@ gsicc_release_link(gsicc_link_t *icclink)
             prev->next = icclink;
             icclink->next = curr;
         }
-        /* Finally, if some thread was waiting because the cache was full, let it run */
-        if (icc_link_cache->cache_full) {
-            icc_link_cache->cache_full = false;
-            gx_semaphore_signal(icc_link_cache->full_wait);	/* let a waiting thread run */
-        }
     }
     gx_monitor_leave(icc_link_cache->lock);
 }
@@ -1876,3 +2096,224 @@ gsicc_get_device_profile_comps(const cmm_dev_profile_t *dev_profile)
        return dev_profile->link_profile->num_comps_out;
     }
 }
+
+/* The device colors that recent client colors in ICC color spaces were
+   mapped to.  A document that keeps switching between a few colors would
+   otherwise have each of them looked up in the link cache, transformed
+   and encoded for every object.  Only the plain cases are kept: no
+   halftoning, no transfer functions, no gray detection, and a device
+   color that is a color index or DeviceN values.  All the entries depend
+   on the same device and graphics state settings, which are kept once
+   for the lot, and if any of them change the cache starts again.  Only
+   the thread that the link cache belongs to uses this, so there is no
+   locking. */
+#define ICC_DEVCOLOR_CACHE_SIZE 32	/* must be a power of 2 */
+#define ICC_DEVCOLOR_MAX_COMPS 4
+
+typedef struct gsicc_devcolor_s {
+    int num_comps;		/* 0 if the entry is unused */
+    float values[ICC_DEVCOLOR_MAX_COMPS];
+    int64_t src_hash;
+    int rendering_intent;
+    bool black_point_comp;
+    gs_graphics_type_tag_t graphics_type_tag;
+    bool is_devn;
+    gx_color_index pure;
+    ushort devn[GX_DEVICE_COLOR_MAX_COMPONENTS];
+} gsicc_devcolor_t;
+
+typedef struct gsicc_devcolor_cache_s {
+    const gx_device *dev;
+    dev_proc_encode_color((*encode_color));
+    gx_device_color_info color_info;
+    const cmm_dev_profile_t *dev_profile;
+    cmm_dev_profile_t dev_profile_settings;	/* up to the memory member */
+    int64_t des_hash[NUM_DEVICE_PROFILES];
+    const gx_color_map_procs *cmap_procs;
+    const gsicc_manager_t *icc_manager;
+    gs_id black_generation;
+    gs_id undercolor_removal;
+    gsicc_devcolor_t entries[ICC_DEVCOLOR_CACHE_SIZE];
+} gsicc_devcolor_cache_t;
+
+#define DEV_PROFILE_SETTINGS_SIZE offsetof(cmm_dev_profile_t, memory)
+
+static bool
+gsicc_devcolor_cacheable(const gs_gstate *pgs, gx_device *dev,
+                         const cmm_dev_profile_t *dev_profile,
+                         const gs_color_space *pcs)
+{
+    const cmm_profile_t *src_profile = pcs->cmm_icc_profile_data;
+    int num_des_comps;
+
+    if (pgs->icc_link_cache == NULL || src_profile == NULL ||
+        !src_profile->hash_is_valid ||
+        src_profile->num_comps > ICC_DEVCOLOR_MAX_COMPS ||
+        gx_device_must_halftone(dev) ||
+        pgs->effective_transfer_non_identity_count != 0 ||
+        dev_profile->graydetection)
+        return false;
+    /* Not an NCLR profile, which needs the colorant map of the gstate */
+    num_des_comps = gsicc_get_device_profile_comps(dev_profile);
+    return num_des_comps == 1 || num_des_comps == 3 || num_des_comps == 4;
+}
+
+static void
+gsicc_devcolor_des_hash(int64_t *des_hash, const cmm_dev_profile_t *dev_profile)
+{
+    int k;
+
+    for (k = 0; k < NUM_DEVICE_PROFILES; k++) {
+        const cmm_profile_t *profile = dev_profile->device_profile[k];
+
+        des_hash[k] = profile != NULL && profile->hash_is_valid ? profile->hashcode : 0;
+    }
+}
+
+/* Check that the device colors in the cache are still good for this
+   device and graphics state. */
+static bool
+gsicc_devcolor_state_same(const gsicc_devcolor_cache_t *cache,
+                          const gs_gstate *pgs, gx_device *dev,
+                          const cmm_dev_profile_t *dev_profile)
+{
+    int64_t des_hash[NUM_DEVICE_PROFILES];
+
+    if (cache->dev != dev || cache->encode_color != dev_proc(dev, encode_color) ||
+        cache->dev_profile != dev_profile || cache->cmap_procs != pgs->cmap_procs ||
+        cache->icc_manager != pgs->icc_manager ||
+        cache->black_generation != (pgs->black_generation == NULL ? gs_no_id :
+                                    pgs->black_generation->id) ||
+        cache->undercolor_removal != (pgs->undercolor_removal == NULL ? gs_no_id :
+                                      pgs->undercolor_removal->id) ||
+        memcmp(&cache->color_info, &dev->color_info, sizeof(dev->color_info)) != 0 ||
+        memcmp(&cache->dev_profile_settings, dev_profile, DEV_PROFILE_SETTINGS_SIZE) != 0)
+        return false;
+    /* A new profile could have been put where an old one was freed */
+    gsicc_devcolor_des_hash(des_hash, dev_profile);
+    return memcmp(cache->des_hash, des_hash, sizeof(des_hash)) == 0;
+}
+
+static void
+gsicc_devcolor_set_state(gsicc_devcolor_cache_t *cache, const gs_gstate *pgs,
+                         gx_device *dev, const cmm_dev_profile_t *dev_profile)
+{
+    int k;
+
+    cache->dev = dev;
+    cache->encode_color = dev_proc(dev, encode_color);
+    cache->dev_profile = dev_profile;
+    cache->cmap_procs = pgs->cmap_procs;
+    cache->icc_manager = pgs->icc_manager;
+    cache->black_generation = pgs->black_generation == NULL ? gs_no_id :
+                              pgs->black_generation->id;
+    cache->undercolor_removal = pgs->undercolor_removal == NULL ? gs_no_id :
+                                pgs->undercolor_removal->id;
+    memcpy(&cache->color_info, &dev->color_info, sizeof(dev->color_info));
+    memcpy(&cache->dev_profile_settings, dev_profile, DEV_PROFILE_SETTINGS_SIZE);
+    gsicc_devcolor_des_hash(cache->des_hash, dev_profile);
+    for (k = 0; k < ICC_DEVCOLOR_CACHE_SIZE; k++)
+        cache->entries[k].num_comps = 0;
+}
+
+static gsicc_devcolor_t *
+gsicc_devcolor_entry(gsicc_devcolor_cache_t *cache, const gs_client_color *pcc,
+                     int num_comps, int64_t src_hash)
+{
+    uint hash = (uint)src_hash ^ (uint)(src_hash >> 32);
+    int k;
+
+    for (k = 0; k < num_comps; k++) {
+        uint bits;
+
+        memcpy(&bits, &pcc->paint.values[k], sizeof(bits));
+        hash = hash * 31 + bits;
+    }
+    hash ^= hash >> 16;
+    hash ^= hash >> 8;
+    return &cache->entries[hash & (ICC_DEVCOLOR_CACHE_SIZE - 1)];
+}
+
+/* If the client color has been mapped to a device color since the device
+   and graphics state last changed, set *pdc as gx_remap_ICC would and
+   return true. */
+bool
+gsicc_get_devcolor(const gs_gstate *pgs, gx_device *dev,
+                   const cmm_dev_profile_t *dev_profile,
+                   const gs_color_space *pcs, const gs_client_color *pcc,
+                   gx_device_color *pdc)
+{
+    gsicc_devcolor_cache_t *cache;
+    gsicc_devcolor_t *entry;
+    int num_comps, k;
+
+    if (!gsicc_devcolor_cacheable(pgs, dev, dev_profile, pcs))
+        return false;
+    cache = pgs->icc_link_cache->devcolors;
+    if (cache == NULL)
+        return false;
+    num_comps = pcs->cmm_icc_profile_data->num_comps;
+    entry = gsicc_devcolor_entry(cache, pcc, num_comps,
+                                 pcs->cmm_icc_profile_data->hashcode);
+    if (entry->num_comps != num_comps ||
+        entry->src_hash != pcs->cmm_icc_profile_data->hashcode ||
+        memcmp(entry->values, pcc->paint.values, num_comps * sizeof(float)) != 0 ||
+        entry->rendering_intent != pgs->renderingintent ||
+        entry->black_point_comp != pgs->blackptcomp ||
+        entry->graphics_type_tag != dev->graphics_type_tag ||
+        !gsicc_devcolor_state_same(cache, pgs, dev, dev_profile))
+        return false;
+    if (entry->is_devn) {
+        for (k = 0; k < dev->color_info.num_components; k++)
+            pdc->colors.devn.values[k] = entry->devn[k];
+        pdc->type = gx_dc_type_devn;
+    } else
+        color_set_pure(pdc, entry->pure);
+    for (k = 0; k < num_comps; k++)
+        pdc->ccolor.paint.values[k] = pcc->paint.values[k];
+    pdc->ccolor_valid = true;
+    return true;
+}
+
+/* Remember the device color that gx_remap_ICC mapped a client color to. */
+void
+gsicc_put_devcolor(const gs_gstate *pgs, gx_device *dev,
+                   const cmm_dev_profile_t *dev_profile,
+                   const gs_color_space *pcs, const gs_client_color *pcc,
+                   const gx_device_color *pdc)
+{
+    gsicc_link_cache_t *link_cache = pgs->icc_link_cache;
+    gsicc_devcolor_cache_t *cache;
+    gsicc_devcolor_t *entry;
+    int num_comps, k;
+
+    if ((pdc->type != gx_dc_type_pure && pdc->type != gx_dc_type_devn) ||
+        !gsicc_devcolor_cacheable(pgs, dev, dev_profile, pcs))
+        return;
+    cache = link_cache->devcolors;
+    if (cache == NULL) {
+        cache = (gsicc_devcolor_cache_t *)gs_alloc_bytes(link_cache->memory->non_gc_memory,
+                                                         sizeof(gsicc_devcolor_cache_t),
+                                                         "gsicc_put_devcolor");
+        if (cache == NULL)
+            return;
+        link_cache->devcolors = cache;
+        gsicc_devcolor_set_state(cache, pgs, dev, dev_profile);
+    } else if (!gsicc_devcolor_state_same(cache, pgs, dev, dev_profile))
+        gsicc_devcolor_set_state(cache, pgs, dev, dev_profile);
+    num_comps = pcs->cmm_icc_profile_data->num_comps;
+    entry = gsicc_devcolor_entry(cache, pcc, num_comps,
+                                 pcs->cmm_icc_profile_data->hashcode);
+    entry->num_comps = num_comps;
+    memcpy(entry->values, pcc->paint.values, num_comps * sizeof(float));
+    entry->src_hash = pcs->cmm_icc_profile_data->hashcode;
+    entry->rendering_intent = pgs->renderingintent;
+    entry->black_point_comp = pgs->blackptcomp;
+    entry->graphics_type_tag = dev->graphics_type_tag;
+    entry->is_devn = pdc->type == gx_dc_type_devn;
+    if (entry->is_devn) {
+        for (k = 0; k < dev->color_info.num_components; k++)
+            entry->devn[k] = pdc->colors.devn.values[k];
+    } else
+        entry->pure = pdc->colors.pure;
+}
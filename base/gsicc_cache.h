@@ -21,6 +21,7 @@
 #include "gsgstate.h"
 #include "gscms.h"
 #include "gxcvalue.h"
+#include "gsdcolor.h"
 
 /* Used in named color handling */
 typedef struct gsicc_namedcolor_s {
@@ -30,6 +31,8 @@ typedef struct gsicc_namedcolor_s {
 } gsicc_namedcolor_t;
 
 gsicc_link_cache_t* gsicc_cache_new(gs_memory_t *memory);
+gsicc_link_cache_t* gsicc_cache_new_thread(gs_memory_t *memory,
+                                          gsicc_link_cache_t *shared);
 gsicc_link_t* gsicc_findcachelink(gsicc_hashlink_t hashcode,
                                   gsicc_link_cache_t *icc_link_cache,
                                   bool includes_proof, bool includes_devlink);
@@ -37,7 +40,7 @@ void gsicc_init_buffer(gsicc_bufferdesc_t *buffer_desc, unsigned char num_chan,
                   unsigned char bytes_per_chan, bool has_alpha, bool alpha_first,
                   bool is_planar, int plane_stride, int row_stride, int num_rows,
                   int pixels_per_row);
-bool gsicc_alloc_link_entry(gsicc_link_cache_t *icc_link_cache,
+void gsicc_alloc_link_entry(gsicc_link_cache_t *icc_link_cache,
                             gsicc_link_t **ret_link, gsicc_hashlink_t hash,
                             bool include_softproof, bool include_devlink);
 gsicc_link_t* gsicc_get_link(const gs_gstate * pgs, gx_device *dev,
@@ -64,6 +67,14 @@ int gsicc_transform_named_color(const float tint_values[],
                             gsicc_rendering_param_t *rendering_params);
 bool gsicc_support_named_color(const gs_color_space *pcs, const gs_gstate *pgs);
 int  gsicc_get_device_profile_comps(const cmm_dev_profile_t *dev_profile);
+bool gsicc_get_devcolor(const gs_gstate *pgs, gx_device *dev,
+                        const cmm_dev_profile_t *dev_profile,
+                        const gs_color_space *pcs, const gs_client_color *pcc,
+                        gx_device_color *pdc);
+void gsicc_put_devcolor(const gs_gstate *pgs, gx_device *dev,
+                        const cmm_dev_profile_t *dev_profile,
+                        const gs_color_space *pcs, const gs_client_color *pcc,
+                        const gx_device_color *pdc);
 gsicc_link_t * gsicc_alloc_link_dev(gs_memory_t *memory, cmm_profile_t *src_profile,
     cmm_profile_t *des_profile, gsicc_rendering_param_t *rendering_params);
 void gsicc_free_link_dev(gs_memory_t *memory, gsicc_link_t *link);
@@ -91,6 +91,8 @@ void gscms_get_name2device_link(gsicc_link_t *icclink,
 int gscms_get_input_channel_count(gcmmhprofile_t profile, gs_memory_t *memory);
 int gscms_get_output_channel_count(gcmmhprofile_t profile, gs_memory_t *memory);
 void gscms_get_link_dim(gcmmhlink_t link, int *num_inputs, int *num_outputs, gs_memory_t *memory);
+byte *gscms_save_link(gcmmhlink_t link, int *size, gs_memory_t *memory);
+gcmmhlink_t gscms_load_link(const byte *data, int size, gs_memory_t *memory);
 int gscms_avoid_white_fix_flag(gs_memory_t *memory);
 bool gscms_is_threadsafe(void);
 #endif
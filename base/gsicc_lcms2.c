@@ -504,6 +504,19 @@ gscms_get_link_dim(gcmmhlink_t link, int *num_inputs, int *num_outputs,
     *num_outputs = T_CHANNELS(cmsGetTransformOutputFormat(link));
 }
 
+/* The on-disk link cache is only supported with lcms2mt */
+byte *
+gscms_save_link(gcmmhlink_t link, int *size, gs_memory_t *memory)
+{
+    return NULL;
+}
+
+gcmmhlink_t
+gscms_load_link(const byte *data, int size, gs_memory_t *memory)
+{
+    return NULL;
+}
+
 /* Get the link from the CMS. TODO:  Add error checking */
 gcmmhlink_t
 gscms_get_link(gcmmhprofile_t  lcms_srchandle,
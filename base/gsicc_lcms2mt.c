@@ -199,6 +199,481 @@ gscms_get_accuracy(gs_memory_t *mem)
     }
 }
 
+#ifndef WITH_CAL
+/* Without CAL we supply a transform plugin of our own.  When lcms optimises
+   a 3 or 4 input link down to a single 16 bit CLUT (which it does for
+   nearly all of the links we ask for) we keep hold of that CLUT and
+   evaluate it ourselves, a buffer at a time, rather than sending every
+   pixel through lcms's formatters and interpolator.  The arithmetic
+   follows lcms's own 16 bit interpolators exactly, so it makes no
+   difference which of the two paths a colour takes. */
+
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+/* lcms2mt exports this, but only declares it in its internal header */
+CMSAPI cmsBool CMSEXPORT _cmsOptimizePipeline(cmsContext ContextID,
+                                              cmsPipeline **PtrLut,
+                                              cmsUInt32Number Intent,
+                                              cmsUInt32Number *InputFormat,
+                                              cmsUInt32Number *OutputFormat,
+                                              cmsUInt32Number *dwFlags);
+
+/* Likewise, as the fast float plugin does */
+#ifndef cmsFLAGS_CAN_CHANGE_FORMATTER
+#define cmsFLAGS_CAN_CHANGE_FORMATTER 0x02000000
+#endif
+
+#define GSCMS_CLUT_MAX_OUT 16
+
+/* Our own transform flag, which lcms passes on to the plugin untouched:
+   the pipeline is a table that gscms_save_link saved, and is already
+   optimised.  cmsFLAGS_NOOPTIMIZE would keep it from the plugin too. */
+#define GSCMS_FLAGS_SAVED_TABLE 0x80000000
+
+/* Where a value falls along one input of the table: the offset of the
+   cell below it, its fractional position in the cell (16 bits) and the
+   offset to the next cell, which is 0 at the top of the range. */
+typedef struct gscms_clut_coord_s {
+    int base;
+    int step;
+    int rest;
+} gscms_clut_coord_t;
+
+typedef struct gscms_clut_s gscms_clut_t;
+struct gscms_clut_s {
+    const cmsInterpParams *params;  /* Belongs to the CLUT stage of the link */
+    int num_in;
+    int num_out;
+    void (*eval)(const cmsInterpParams *p, const gscms_clut_coord_t co[],
+                 cmsUInt16Number out[]);
+    gscms_clut_coord_t coord8[4][256];  /* For 8 bit input */
+};
+
+/* As the start of lcms's interpolators. _cmsToFixedDomain is spelt out. */
+static inline void
+gscms_clut_coord(const cmsInterpParams *p, int c, int v, gscms_clut_coord_t *co)
+{
+    int opta = p->opta[p->nInputs - 1 - c];
+    int f = v * (int)p->Domain[c];
+
+    f += (f + 0x7fff) / 0xffff;
+    co->base = opta * (f >> 16);
+    co->rest = f & 0xffff;
+    co->step = v == 0xffff ? 0 : opta;
+}
+
+/* The order to take the three steps through the cube in a tetrahedral
+   interpolation, indexed by (rx >= ry) << 2 | (ry >= rz) << 1 | (rx >= rz).
+   Two of the combinations can't happen. Where weights tie, lcms may take
+   another path, but the result is identical. */
+static const byte gscms_clut_order[8][3] = {
+    {2, 1, 0}, {0, 1, 2}, {1, 2, 0}, {1, 0, 2},
+    {2, 0, 1}, {0, 2, 1}, {0, 1, 2}, {0, 1, 2}
+};
+
+/* The weights of the three steps, in decreasing order, and the cumulative
+   offsets into the table after each. Done without branches, as the order
+   is as good as random from one pixel to the next. */
+static inline void
+gscms_clut_path(const gscms_clut_coord_t co[3], int w[3], int o[3])
+{
+    const byte *order = gscms_clut_order[(co[0].rest >= co[1].rest) << 2 |
+                                         (co[1].rest >= co[2].rest) << 1 |
+                                         (co[0].rest >= co[2].rest)];
+
+    w[0] = co[order[0]].rest;
+    w[1] = co[order[1]].rest;
+    w[2] = co[order[2]].rest;
+    o[0] = co[order[0]].step;
+    o[1] = o[0] + co[order[1]].step;
+    o[2] = co[0].step + co[1].step + co[2].step;
+}
+
+#ifdef HAVE_SSE2
+/* The sum of the weighted differences along the path, for four outputs at
+   once.  Rearranged as v1*(w0-w1) + v2*(w1-w2) + v3*w2 - v0*w0 every
+   product is of two unsigned 16 bit values, which SSE2 can form exactly,
+   and the total is the same as lcms's modulo 2^32. */
+static inline __m128i
+gscms_clut_rest4(const cmsUInt16Number *t, const int w[3], const int o[3])
+{
+    __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(t + o[0])),
+                                   _mm_loadl_epi64((const __m128i *)(t + o[1])));
+    __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(t + o[2])),
+                                   _mm_loadl_epi64((const __m128i *)t));
+    short d0 = (short)(w[0] - w[1]), d1 = (short)(w[1] - w[2]);
+    short w2 = (short)w[2], w0 = (short)w[0];
+    __m128i wa = _mm_set_epi16(d1, d1, d1, d1, d0, d0, d0, d0);
+    __m128i wb = _mm_set_epi16(w0, w0, w0, w0, w2, w2, w2, w2);
+    __m128i lo, hi, sum;
+
+    lo = _mm_mullo_epi16(a, wa);
+    hi = _mm_mulhi_epu16(a, wa);
+    sum = _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), _mm_unpackhi_epi16(lo, hi));
+    lo = _mm_mullo_epi16(b, wb);
+    hi = _mm_mulhi_epu16(b, wb);
+    sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(lo, hi));
+    return _mm_sub_epi32(sum, _mm_unpackhi_epi16(lo, hi));
+}
+
+static inline __m128i
+gscms_clut_load4(const cmsUInt16Number *t)
+{
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)t), _mm_setzero_si128());
+}
+
+/* Keep the low 16 bits of each lane, as the casts in lcms do */
+static inline void
+gscms_clut_store4(cmsUInt16Number *out, __m128i v)
+{
+    v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    _mm_storel_epi64((__m128i *)out, _mm_packs_epi32(v, v));
+}
+
+/* c0 + ROUND_FIXED_TO_INT(_cmsToFixedDomain(rest)), for Eval4Inputs. The
+   division by 0xffff rounds towards zero, so it is done on the magnitude. */
+static inline __m128i
+gscms_clut_round4(__m128i c0, __m128i rest)
+{
+    __m128i b = _mm_add_epi32(rest, _mm_set1_epi32(0x7fff));
+    __m128i s = _mm_srai_epi32(b, 31);
+    __m128i m = _mm_sub_epi32(_mm_xor_si128(b, s), s);
+
+    m = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(m, _mm_srli_epi32(m, 16)),
+                                     _mm_set1_epi32(1)), 16);
+    rest = _mm_add_epi32(rest, _mm_sub_epi32(_mm_xor_si128(m, s), s));
+    rest = _mm_srai_epi32(_mm_add_epi32(rest, _mm_set1_epi32(0x8000)), 16);
+    return _mm_and_si128(_mm_add_epi32(c0, rest), _mm_set1_epi32(0xffff));
+}
+#endif
+
+/* As TetrahedralInterp16 */
+static void
+gscms_clut_eval3(const cmsInterpParams *p, const gscms_clut_coord_t co[],
+                 cmsUInt16Number out[])
+{
+    const cmsUInt16Number *t = (const cmsUInt16Number *)p->Table +
+                               co[0].base + co[1].base + co[2].base;
+    int w[3], o[3];
+    int k, n = p->nOutputs;
+
+    gscms_clut_path(co, w, o);
+
+#ifdef HAVE_SSE2
+    if (n == 4) {
+        __m128i rest = _mm_add_epi32(gscms_clut_rest4(t, w, o), _mm_set1_epi32(0x8001));
+
+        rest = _mm_srai_epi32(_mm_add_epi32(rest, _mm_srai_epi32(rest, 16)), 16);
+        gscms_clut_store4(out, _mm_add_epi32(gscms_clut_load4(t), rest));
+        return;
+    }
+#endif
+    for (k = 0; k < n; k++, t++) {
+        int c0 = t[0], c1 = t[o[0]], c2 = t[o[1]], c3 = t[o[2]];
+        int rest = (int)((unsigned int)(c1 - c0) * w[0] + (unsigned int)(c2 - c1) * w[1] +
+                         (unsigned int)(c3 - c2) * w[2] + 0x8001);
+
+        out[k] = (cmsUInt16Number)(c0 + ((rest + (rest >> 16)) >> 16));
+    }
+}
+
+/* As Eval4Inputs: a tetrahedral interpolation in each of the two CMY cubes
+   either side of K, then linear between them. */
+static void
+gscms_clut_eval4(const cmsInterpParams *p, const gscms_clut_coord_t co[],
+                 cmsUInt16Number out[])
+{
+    const cmsUInt16Number *t0 = (const cmsUInt16Number *)p->Table +
+                                co[0].base + co[1].base + co[2].base + co[3].base;
+    const cmsUInt16Number *t1 = t0 + co[0].step;
+    int rk = co[0].rest;
+    int w[3], o[3];
+    int k, n = p->nOutputs;
+
+    gscms_clut_path(co + 1, w, o);
+
+#ifdef HAVE_SSE2
+    if (n == 4) {
+        __m128i l = gscms_clut_round4(gscms_clut_load4(t0), gscms_clut_rest4(t0, w, o));
+        __m128i h = gscms_clut_round4(gscms_clut_load4(t1), gscms_clut_rest4(t1, w, o));
+        __m128i bias = _mm_set1_epi32(0x8000);
+        __m128i lh = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(l, bias),
+                                                   _mm_sub_epi32(h, bias)),
+                                   _mm_set1_epi16((short)0x8000));
+        __m128i r = _mm_set1_epi16((short)rk);
+        __m128i lo = _mm_mullo_epi16(lh, r);
+        __m128i hi = _mm_mulhi_epu16(lh, r);
+        __m128i dif;
+
+        /* LinearInterp: (h - l) * rk, unsigned, formed as h*rk - l*rk */
+        dif = _mm_sub_epi32(_mm_unpackhi_epi16(lo, hi), _mm_unpacklo_epi16(lo, hi));
+        dif = _mm_srli_epi32(_mm_add_epi32(dif, bias), 16);
+        gscms_clut_store4(out, _mm_add_epi32(dif, l));
+        return;
+    }
+#endif
+    for (k = 0; k < n; k++, t0++, t1++) {
+        int c0, rest, l, h;
+
+        c0 = t0[0];
+        rest = (int)((unsigned int)(t0[o[0]] - c0) * w[0] +
+                     (unsigned int)(t0[o[1]] - t0[o[0]]) * w[1] +
+                     (unsigned int)(t0[o[2]] - t0[o[1]]) * w[2]);
+        rest += (rest + 0x7fff) / 0xffff;
+        l = (cmsUInt16Number)(c0 + ((rest + 0x8000) >> 16));
+        c0 = t1[0];
+        rest = (int)((unsigned int)(t1[o[0]] - c0) * w[0] +
+                     (unsigned int)(t1[o[1]] - t1[o[0]]) * w[1] +
+                     (unsigned int)(t1[o[2]] - t1[o[1]]) * w[2]);
+        rest += (rest + 0x7fff) / 0xffff;
+        h = (cmsUInt16Number)(c0 + ((rest + 0x8000) >> 16));
+        out[k] = (cmsUInt16Number)((((unsigned int)(h - l) * rk + 0x8000) >> 16) + l);
+    }
+}
+
+/* Transform chunky 8 or 16 bit data with no extra channels. The 8 bit
+   conversions are lcms's FROM_8_TO_16 and FROM_16_TO_8. Runs of the same
+   colour are common, so the last one is remembered. */
+static forceinline void
+template_gscms_clut_rows(const gscms_clut_t *clut, const byte *in, byte *out,
+                         int num_in, int num_out, int bytes_in, int bytes_out,
+                         int width, int height, int in_stride, int out_stride)
+{
+    const cmsInterpParams *p = clut->params;
+    int in_size = num_in * bytes_in, out_size = num_out * bytes_out;
+    gscms_clut_coord_t co[4];
+    cmsUInt16Number dst[GSCMS_CLUT_MAX_OUT];
+    byte prev[8], last[GSCMS_CLUT_MAX_OUT * 2];
+    bool have_prev = false;
+    int x, y, k;
+
+    for (y = 0; y < height; y++) {
+        const byte *ip = in + (size_t)y * in_stride;
+        byte *op = out + (size_t)y * out_stride;
+
+        for (x = 0; x < width; x++, ip += in_size, op += out_size) {
+            if (!have_prev || memcmp(ip, prev, in_size) != 0) {
+                if (bytes_in == 1) {
+                    for (k = 0; k < num_in; k++)
+                        co[k] = clut->coord8[k][ip[k]];
+                } else {
+                    for (k = 0; k < num_in; k++)
+                        gscms_clut_coord(p, k, ((const cmsUInt16Number *)ip)[k], &co[k]);
+                }
+                clut->eval(p, co, dst);
+                if (bytes_out == 1) {
+                    for (k = 0; k < num_out; k++)
+                        last[k] = (byte)((dst[k] * 65281U + 8388608U) >> 24);
+                } else {
+                    memcpy(last, dst, out_size);
+                }
+                memcpy(prev, ip, in_size);
+                have_prev = true;
+            }
+            memcpy(op, last, out_size);
+        }
+    }
+}
+
+static void
+gscms_clut_rows_3_1(const gscms_clut_t *clut, const byte *in, byte *out,
+                    int width, int height, int in_stride, int out_stride)
+{
+    template_gscms_clut_rows(clut, in, out, 3, 1, 1, 1, width, height, in_stride, out_stride);
+}
+
+static void
+gscms_clut_rows_3_3(const gscms_clut_t *clut, const byte *in, byte *out,
+                    int width, int height, int in_stride, int out_stride)
+{
+    template_gscms_clut_rows(clut, in, out, 3, 3, 1, 1, width, height, in_stride, out_stride);
+}
+
+static void
+gscms_clut_rows_3_4(const gscms_clut_t *clut, const byte *in, byte *out,
+                    int width, int height, int in_stride, int out_stride)
+{
+    template_gscms_clut_rows(clut, in, out, 3, 4, 1, 1, width, height, in_stride, out_stride);
+}
+
+static void
+gscms_clut_rows_4_1(const gscms_clut_t *clut, const byte *in, byte *out,
+                    int width, int height, int in_stride, int out_stride)
+{
+    template_gscms_clut_rows(clut, in, out, 4, 1, 1, 1, width, height, in_stride, out_stride);
+}
+
+static void
+gscms_clut_rows_4_3(const gscms_clut_t *clut, const byte *in, byte *out,
+                    int width, int height, int in_stride, int out_stride)
+{
+    template_gscms_clut_rows(clut, in, out, 4, 3, 1, 1, width, height, in_stride, out_stride);
+}
+
+static void
+gscms_clut_rows_4_4(const gscms_clut_t *clut, const byte *in, byte *out,
+                    int width, int height, int in_stride, int out_stride)
+{
+    template_gscms_clut_rows(clut, in, out, 4, 4, 1, 1, width, height, in_stride, out_stride);
+}
+
+/* The 8 bit gray, RGB and CMYK cases get their own copies of the loop */
+static void
+gscms_clut_transform(const gscms_clut_t *clut, const byte *in, byte *out,
+                     int bytes_in, int bytes_out, int width, int height,
+                     int in_stride, int out_stride)
+{
+    void (*rows)(const gscms_clut_t *, const byte *, byte *, int, int, int, int) = NULL;
+
+    if (bytes_in == 1 && bytes_out == 1) {
+        switch (clut->num_out) {
+            case 1:
+                rows = clut->num_in == 3 ? gscms_clut_rows_3_1 : gscms_clut_rows_4_1;
+                break;
+            case 3:
+                rows = clut->num_in == 3 ? gscms_clut_rows_3_3 : gscms_clut_rows_4_3;
+                break;
+            case 4:
+                rows = clut->num_in == 3 ? gscms_clut_rows_3_4 : gscms_clut_rows_4_4;
+                break;
+        }
+    }
+    if (rows != NULL)
+        rows(clut, in, out, width, height, in_stride, out_stride);
+    else
+        template_gscms_clut_rows(clut, in, out, clut->num_in, clut->num_out,
+                                 bytes_in, bytes_out, width, height,
+                                 in_stride, out_stride);
+}
+
+static void
+gscms_clut_xform(cmsContext ContextID, struct _cmstransform_struct *CMMcargo,
+                 const void *InputBuffer, void *OutputBuffer,
+                 cmsUInt32Number PixelsPerLine, cmsUInt32Number LineCount,
+                 const cmsStride *Stride)
+{
+    const gscms_clut_t *clut = (const gscms_clut_t *)_cmsGetTransformUserData(CMMcargo);
+
+    /* The factory only accepts 16 bit formats */
+    gscms_clut_transform(clut, InputBuffer, OutputBuffer, 2, 2,
+                         PixelsPerLine, LineCount,
+                         Stride->BytesPerLineIn, Stride->BytesPerLineOut);
+}
+
+static void
+gscms_clut_free(cmsContext ContextID, void *data)
+{
+    _cmsFree(ContextID, data);
+}
+
+/* Chunky native 16 bit, no extra channels and nothing that changes how
+   lcms packs the values. */
+static bool
+gscms_clut_format_ok(cmsUInt32Number format)
+{
+    if ((format & ~(COLORSPACE_SH(31) | CHANNELS_SH(15))) != BYTES_SH(2))
+        return false;
+    switch (T_COLORSPACE(format)) {
+        case PT_XYZ:
+        case PT_Lab:
+        case PT_LabV2:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static cmsBool
+gscms_clut_factory(cmsContext ContextID, _cmsTransform2Fn *xform,
+                   void **UserData, _cmsFreeUserDataFn *FreeUserData,
+                   cmsPipeline **Lut, cmsUInt32Number *InputFormat,
+                   cmsUInt32Number *OutputFormat, cmsUInt32Number *dwFlags)
+{
+    int num_in = T_CHANNELS(*InputFormat);
+    int num_out = T_CHANNELS(*OutputFormat);
+    cmsStage *stage;
+    const _cmsStageCLutData *data;
+    gscms_clut_t *clut;
+    int i, v;
+
+    if (*dwFlags & (cmsFLAGS_GAMUTCHECK | cmsFLAGS_NULLTRANSFORM | cmsFLAGS_PREMULT |
+                    cmsFLAGS_CLUT_PRE_LINEARIZATION | cmsFLAGS_CLUT_POST_LINEARIZATION))
+        return FALSE;
+    if (!gscms_clut_format_ok(*InputFormat) || !gscms_clut_format_ok(*OutputFormat))
+        return FALSE;
+    if ((num_in != 3 && num_in != 4) || num_out < 1 || num_out > GSCMS_CLUT_MAX_OUT)
+        return FALSE;
+
+    /* Have lcms optimise the pipeline as it would have done anyway.  We
+       aren't told the intent, which only matters to stop the white fixup
+       for absolute colorimetric; gscms_intent_flags asks for that with a
+       flag instead.  A link read back from the disk cache is already just
+       the table. */
+    if (!(*dwFlags & GSCMS_FLAGS_SAVED_TABLE) &&
+        !_cmsOptimizePipeline(ContextID, Lut, INTENT_PERCEPTUAL,
+                              InputFormat, OutputFormat, dwFlags))
+        return FALSE;
+
+    /* Anything other than a plain 16 bit CLUT is left to lcms, but as the
+       pipeline is already optimised, it mustn't be optimised again. */
+    stage = cmsPipelineGetPtrToFirstStage(ContextID, *Lut);
+    if (cmsPipelineStageCount(ContextID, *Lut) != 1 ||
+        cmsStageType(ContextID, stage) != cmsSigCLutElemType) {
+        *dwFlags |= cmsFLAGS_NOOPTIMIZE;
+        return FALSE;
+    }
+    data = (const _cmsStageCLutData *)cmsStageData(ContextID, stage);
+    if (data->HasFloatValues || data->Params->nInputs != num_in ||
+        data->Params->nOutputs != num_out ||
+        (data->Params->dwFlags & CMS_LERP_FLAGS_TRILINEAR)) {
+        *dwFlags |= cmsFLAGS_NOOPTIMIZE;
+        return FALSE;
+    }
+
+    clut = (gscms_clut_t *)_cmsMalloc(ContextID, sizeof(gscms_clut_t));
+    if (clut == NULL) {
+        *dwFlags |= cmsFLAGS_NOOPTIMIZE;
+        return FALSE;
+    }
+    clut->params = data->Params;
+    clut->num_in = num_in;
+    clut->num_out = num_out;
+    clut->eval = num_in == 3 ? gscms_clut_eval3 : gscms_clut_eval4;
+    for (i = 0; i < num_in; i++)
+        for (v = 0; v < 256; v++)
+            gscms_clut_coord(data->Params, i, v * 0x101, &clut->coord8[i][v]);
+
+    *xform = gscms_clut_xform;
+    *UserData = clut;
+    *FreeUserData = gscms_clut_free;
+    /* Let gscms_transform_color_buffer clone it for other formats */
+    *dwFlags |= cmsFLAGS_CAN_CHANGE_FORMATTER;
+    return TRUE;
+}
+
+static cmsPluginTransform gs_cms_clut_plugin =
+{
+    {
+        cmsPluginMagicNumber,
+        LCMS_VERSION,
+        cmsPluginTransformSig,
+        NULL
+    },
+    { (_cmsTransformFactory)gscms_clut_factory }
+};
+#endif
+
+/* lcms only skips the white fixup for absolute colorimetric when it knows
+   the intent, which transform plugins aren't told, so say so explicitly.
+   This doesn't change what lcms itself does. */
+static unsigned int
+gscms_intent_flags(int intent)
+{
+    return intent == INTENT_ABSOLUTE_COLORIMETRIC ? cmsFLAGS_NOWHITEONWHITEFIXUP : 0;
+}
+
 /* Get the number of channels for the profile.
   Input count */
 int
@@ -376,6 +851,24 @@ gscms_transform_color_buffer(gx_device *dev, gsicc_link_t *icclink,
     /* This is really only going to be an issue when we have interleaved alpha data */
     hasalpha = input_buff_desc->has_alpha;
 
+#ifndef WITH_CAL
+    /* Chunky data without alpha can go straight to the CLUT, if we have one */
+    if (!hasalpha && !planarIN && !planarOUT && !swap_endianIN && !swap_endianOUT) {
+        const gscms_clut_t *clut = (const gscms_clut_t *)_cmsGetTransformUserData(hTransform);
+
+        if (clut != NULL && clut->num_in == input_buff_desc->num_chan &&
+            clut->num_out == output_buff_desc->num_chan) {
+            gscms_clut_transform(clut, inputbuffer, outputbuffer,
+                                 numbytesIN, numbytesOUT,
+                                 input_buff_desc->pixels_per_row,
+                                 input_buff_desc->num_rows,
+                                 input_buff_desc->row_stride,
+                                 output_buff_desc->row_stride);
+            return 0;
+        }
+    }
+#endif
+
     needed_flags = gsicc_link_flags(hasalpha, planarIN, planarOUT,
                                     swap_endianIN, swap_endianOUT,
                                     numbytesIN, numbytesOUT);
@@ -675,7 +1168,8 @@ gscms_get_link(gcmmhprofile_t  lcms_srchandle, gcmmhprofile_t lcms_deshandle,
     link_handle->hTransform = cmsCreateTransform(ctx, lcms_srchandle, src_data_type,
                                                     lcms_deshandle, des_data_type,
                                                     rendering_params->rendering_intent,
-                                                    flag | cmm_flags);
+                                                    flag | cmm_flags |
+                                                    gscms_intent_flags(rendering_params->rendering_intent));
     if (link_handle->hTransform == NULL) {
         int k;
 
@@ -685,7 +1179,8 @@ gscms_get_link(gcmmhprofile_t  lcms_srchandle, gcmmhprofile_t lcms_deshandle,
            that works. */
         for (k = 0; k <= gsABSOLUTECOLORIMETRIC; k++) {
             link_handle->hTransform = cmsCreateTransform(ctx, lcms_srchandle, src_data_type,
-                lcms_deshandle, des_data_type, k, flag | cmm_flags);
+                lcms_deshandle, des_data_type, k,
+                flag | cmm_flags | gscms_intent_flags(k));
             if (link_handle->hTransform != NULL)
                 break;
         }
@@ -703,6 +1198,148 @@ gscms_get_link(gcmmhprofile_t  lcms_srchandle, gcmmhprofile_t lcms_deshandle,
     /* cmsFLAGS_HIGHRESPRECALC)  cmsFLAGS_NOTPRECALC  cmsFLAGS_LOWRESPRECALC*/
 }
 
+/* For the on-disk link cache (see gsicc_cache.c).  We can only save the
+   links that our transform plugin evaluates, but they are nothing more
+   than a 16 bit table and are also the links that are slow to build.
+   The plugin is the only transform plugin without CAL, so any transform
+   with user data is one of its. The data is the lcms version, the formats
+   and the table dimensions, as 32 bit words, followed by the table. */
+byte *
+gscms_save_link(gcmmhlink_t link, int *size, gs_memory_t *memory)
+{
+#ifdef WITH_CAL
+    return NULL;
+#else
+    cmsContext ctx = gs_lib_ctx_get_cms_context(memory);
+    gsicc_lcms2mt_link_list_t *link_handle = (gsicc_lcms2mt_link_list_t *)(link);
+    cmsHTRANSFORM hTransform = (cmsHTRANSFORM)link_handle->hTransform;
+    const gscms_clut_t *clut;
+    cmsUInt32Number head[8];
+    size_t head_size, num_entries;
+    byte *data;
+    int k;
+
+    clut = (const gscms_clut_t *)_cmsGetTransformUserData((struct _cmstransform_struct *)hTransform);
+    if (clut == NULL)
+        return NULL;
+    head[0] = LCMS_VERSION;
+    head[1] = cmsGetTransformInputFormat(ctx, hTransform);
+    head[2] = cmsGetTransformOutputFormat(ctx, hTransform);
+    head[3] = clut->num_in;
+    /* We need the colour spaces to make the link again */
+    if (T_COLORSPACE(head[1]) == 0 || T_COLORSPACE(head[2]) == 0)
+        return NULL;
+    num_entries = clut->num_out;
+    for (k = 0; k < clut->num_in; k++) {
+        head[4 + k] = clut->params->nSamples[k];
+        num_entries *= clut->params->nSamples[k];
+    }
+    head_size = (4 + clut->num_in) * sizeof(cmsUInt32Number);
+    data = gs_alloc_bytes(memory->non_gc_memory,
+                          head_size + num_entries * sizeof(cmsUInt16Number),
+                          "gscms_save_link");
+    if (data == NULL)
+        return NULL;
+    memcpy(data, head, head_size);
+    memcpy(data + head_size, clut->params->Table, num_entries * sizeof(cmsUInt16Number));
+    *size = head_size + num_entries * sizeof(cmsUInt16Number);
+    return data;
+#endif
+}
+
+/* Make a link from what gscms_save_link saved.  The table goes in a device
+   link profile, made in memory, that must not be optimised again:
+   resampling it wouldn't quite give back the same table, so our plugin
+   takes it as it is.  Returns NULL if the data isn't something we would
+   have saved. */
+gcmmhlink_t
+gscms_load_link(const byte *data, int size, gs_memory_t *memory)
+{
+#ifdef WITH_CAL
+    return NULL;
+#else
+    cmsContext ctx = gs_lib_ctx_get_cms_context(memory);
+    gsicc_lcms2mt_link_list_t *link_handle;
+    cmsUInt32Number head[8];
+    cmsUInt32Number num_in, num_out, in_format, out_format;
+    size_t head_size, num_entries;
+    cmsHPROFILE hProfile;
+    cmsPipeline *lut;
+    cmsStage *stage;
+    cmsHTRANSFORM hTransform = NULL;
+    int k;
+
+    if (size < 4 * sizeof(cmsUInt32Number))
+        return NULL;
+    memcpy(head, data, 4 * sizeof(cmsUInt32Number));
+    in_format = head[1];
+    out_format = head[2];
+    num_in = head[3];
+    num_out = T_CHANNELS(out_format);
+    if (head[0] != LCMS_VERSION || (num_in != 3 && num_in != 4) ||
+        T_CHANNELS(in_format) != num_in || num_out < 1 ||
+        num_out > GSCMS_CLUT_MAX_OUT || T_COLORSPACE(in_format) == 0 ||
+        T_COLORSPACE(out_format) == 0 || !gscms_clut_format_ok(in_format) ||
+        !gscms_clut_format_ok(out_format))
+        return NULL;
+    head_size = (4 + num_in) * sizeof(cmsUInt32Number);
+    if (size < head_size)
+        return NULL;
+    memcpy(head + 4, data + 4 * sizeof(cmsUInt32Number),
+           num_in * sizeof(cmsUInt32Number));
+    num_entries = num_out;
+    for (k = 0; k < num_in; k++) {
+        if (head[4 + k] < 2 || head[4 + k] > 255)
+            return NULL;
+        num_entries *= head[4 + k];
+    }
+    if (size != head_size + num_entries * sizeof(cmsUInt16Number))
+        return NULL;
+
+    hProfile = cmsCreateProfilePlaceholder(ctx);
+    if (hProfile == NULL)
+        return NULL;
+    cmsSetProfileVersion(ctx, hProfile, 4.3);
+    cmsSetDeviceClass(ctx, hProfile, cmsSigLinkClass);
+    cmsSetColorSpace(ctx, hProfile, _cmsICCcolorSpace(ctx, T_COLORSPACE(in_format)));
+    cmsSetPCS(ctx, hProfile, _cmsICCcolorSpace(ctx, T_COLORSPACE(out_format)));
+    lut = cmsPipelineAlloc(ctx, num_in, num_out);
+    if (lut != NULL) {
+        stage = cmsStageAllocCLut16bitGranular(ctx, head + 4, num_in, num_out,
+                                               (const cmsUInt16Number *)(data + head_size));
+        if (stage != NULL && !cmsPipelineInsertStage(ctx, lut, cmsAT_BEGIN, stage)) {
+            cmsStageFree(ctx, stage);
+            stage = NULL;
+        }
+        if (stage != NULL && cmsWriteTag(ctx, hProfile, cmsSigAToB0Tag, lut))
+            hTransform = cmsCreateTransform(ctx, hProfile, in_format, NULL, out_format,
+                                            INTENT_PERCEPTUAL, GSCMS_FLAGS_SAVED_TABLE);
+        cmsPipelineFree(ctx, lut);
+    }
+    cmsCloseProfile(ctx, hProfile);
+    if (hTransform == NULL)
+        return NULL;
+    /* Without the plugin it would be slow, so better to build it again */
+    if (_cmsGetTransformUserData((struct _cmstransform_struct *)hTransform) == NULL) {
+        cmsDeleteTransform(ctx, hTransform);
+        return NULL;
+    }
+
+    link_handle = (gsicc_lcms2mt_link_list_t *)gs_alloc_bytes(memory->non_gc_memory,
+                                                         sizeof(gsicc_lcms2mt_link_list_t),
+                                                         "gscms_load_link");
+    if (link_handle == NULL) {
+        cmsDeleteTransform(ctx, hTransform);
+        return NULL;
+    }
+    link_handle->hTransform = hTransform;
+    link_handle->next = NULL;
+    link_handle->flags = gsicc_link_flags(0, 0, 0, 0, 0,    /* no alpha, not planar, no endian swap */
+                                          sizeof(gx_color_value), sizeof(gx_color_value));
+    return link_handle;
+#endif
+}
+
 /* Get the link from the CMS, but include proofing and/or a device link
    profile.  Note also, that the source may be a device link profile, in
    which case we will not have a destination profile but could still have
@@ -867,7 +1504,8 @@ gscms_get_link_proof_devlink(gcmmhprofile_t lcms_srchandle,
         }
         link_handle->hTransform =  cmsCreateMultiprofileTransform(ctx,
                                        hProfiles, nProfiles, src_data_type,
-                                       des_data_type, rendering_params->rendering_intent, flag);
+                                       des_data_type, rendering_params->rendering_intent,
+                                       flag | gscms_intent_flags(rendering_params->rendering_intent));
     }
     if (link_handle->hTransform == NULL) {
         gs_free_object(memory, link_handle, "gscms_get_link_proof_devlink");
@@ -894,6 +1532,8 @@ gscms_create(gs_memory_t *memory)
 #ifdef WITH_CAL
     cmsPlugin(ctx, cal_cms_extensions());
     cmsPlugin(ctx, cal_cms_extensions2());
+#else
+    cmsPlugin(ctx, (void *)&gs_cms_clut_plugin);
 #endif
 
     cmsSetLogErrorHandler(ctx, gscms_error);
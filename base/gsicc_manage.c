@@ -3039,6 +3039,30 @@ gs_seticcdirectory(const gs_gstate * pgs, gs_param_string * pval)
     return 0;
 }
 
+void
+gs_currenticclinkcachedirectory(const gs_gstate * pgs, gs_param_string * pval)
+{
+    const gs_lib_ctx_t *lib_ctx = pgs->memory->gs_lib_ctx;
+
+    if (lib_ctx->linkcachedir == NULL) {
+        pval->data = NULL;
+        pval->size = 0;
+        pval->persistent = true;
+    } else {
+        pval->data = (const byte *)(lib_ctx->linkcachedir);
+        pval->size = strlen(lib_ctx->linkcachedir);
+        pval->persistent = false;
+    }
+}
+
+int
+gs_seticclinkcachedirectory(const gs_gstate * pgs, gs_param_string * pval)
+{
+    return gs_lib_ctx_set_icc_link_cache_directory(pgs->memory,
+                                                   (const char *)pval->data,
+                                                   pval->size);
+}
+
 void
 gs_currentsrcgtagicc(const gs_gstate * pgs, gs_param_string * pval)
 {
@@ -340,11 +340,8 @@ gsicc_rcm_get_link(const gs_gstate *pgs, gx_device *dev,
     if (result != NULL) {
         return result;
     }
-    /* If not, then lets create a new one.  This may actually return a link if
-       another thread has already created it while we were trying to do so */
-    if (gsicc_alloc_link_entry(pgs->icc_link_cache, &result, hash, false, false))
-        return result;
-
+    /* If not, then lets create a new one */
+    gsicc_alloc_link_entry(pgs->icc_link_cache, &result, hash, false, false);
     if (result == NULL)
         return result;
 
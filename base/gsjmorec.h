@@ -34,7 +34,19 @@
  */
 
 #undef BLOCK_SMOOTHING_SUPPORTED
-#undef IDCT_SCALING_SUPPORTED
+/*
+ * IDCT scaling lets DCTDecode reduce images cheaply (see sdct.h), but it
+ * also makes the library upsample subsampled chroma in the IDCT rather
+ * than with the fancy upsampler, which changes full size output.  So it
+ * is only enabled on request.  The capability macros are only visible
+ * inside the library, so tell sdct.h separately.
+ */
+#ifdef GS_JPEG_IDCT_SCALING
+#  define DCTD_MAX_SCALE_DENOM 8
+#else
+#  undef IDCT_SCALING_SUPPORTED
+#  define DCTD_MAX_SCALE_DENOM 1
+#endif
 #undef UPSAMPLE_SCALING_SUPPORTED
 #undef UPSAMPLE_MERGING_SUPPORTED
 #undef QUANT_1PASS_SUPPORTED
@@ -48,6 +48,7 @@
 #include "gsicc_manage.h"
 #include "gserrors.h"
 #include "gscdefs.h"            /* for gs_lib_device_list */
+#include "gxhtmemo.h"
 #include "gsstruct.h"           /* for gs_gc_root_t */
 #ifdef WITH_CAL
 #include "cal.h"
@@ -106,6 +107,65 @@ gs_lib_ctx_set_icc_directory(const gs_memory_t *mem_gc, const char* pname,
     return 0;
 }
 
+/* Sets the directory of the on-disk ICC link cache (see gsicc_cache.c).  An
+   empty name turns the cache off.  The name must be absolute, as the
+   temporary files are made with gp_open_scratch_file, which puts them in
+   TMPDIR otherwise. */
+int
+gs_lib_ctx_set_icc_link_cache_directory(const gs_memory_t *mem_gc, const char* pname,
+                                        int dir_namelen)
+{
+    char *result = NULL, *old;
+    gs_lib_ctx_t *p_ctx = mem_gc->gs_lib_ctx;
+    gs_memory_t *p_ctx_mem = p_ctx->memory;
+
+    /* restore sets all the user params again, usually to the same value */
+    if (p_ctx->linkcachedir == NULL ? dir_namelen == 0 :
+        (strlen(p_ctx->linkcachedir) == dir_namelen &&
+         memcmp(pname, p_ctx->linkcachedir, dir_namelen) == 0))
+        return 0;
+    if (dir_namelen > 0) {
+        if (!gp_file_name_is_absolute(pname, dir_namelen))
+            return_error(gs_error_rangecheck);
+        /* User param string.  Must allocate in non-gc memory */
+        result = (char*) gs_alloc_bytes(p_ctx_mem, dir_namelen+1,
+                                        "gs_lib_ctx_set_icc_link_cache_directory");
+        if (result == NULL) {
+            return gs_error_VMerror;
+        }
+        memcpy(result, pname, dir_namelen);
+        result[dir_namelen] = 0;
+    }
+    /* Render threads may be reading it, see below */
+    gx_monitor_enter((gx_monitor_t *)(p_ctx->core->monitor));
+    old = p_ctx->linkcachedir;
+    p_ctx->linkcachedir = result;
+    gx_monitor_leave((gx_monitor_t *)(p_ctx->core->monitor));
+    gs_free_object(p_ctx_mem, old, "gs_lib_ctx_set_icc_link_cache_directory");
+    return 0;
+}
+
+/* Copies the directory of the on-disk ICC link cache into dir, which is
+   size bytes.  Returns the length, or -1 if there is no cache (or the name
+   doesn't fit).  Safe to call from any thread. */
+int
+gs_lib_ctx_get_icc_link_cache_directory(const gs_memory_t *mem, char *dir, int size)
+{
+    gs_lib_ctx_t *p_ctx = mem->gs_lib_ctx;
+    int len = -1;
+
+    gx_monitor_enter((gx_monitor_t *)(p_ctx->core->monitor));
+    if (p_ctx->linkcachedir != NULL) {
+        len = strlen(p_ctx->linkcachedir);
+        if (len < size)
+            memcpy(dir, p_ctx->linkcachedir, len + 1);
+        else
+            len = -1;
+    }
+    gx_monitor_leave((gx_monitor_t *)(p_ctx->core->monitor));
+    return len;
+}
+
 /* Sets/Gets the string containing the list of default devices we should try */
 int
 gs_lib_ctx_set_default_device_list(const gs_memory_t *mem, const char* dev_list_str,
@@ -360,6 +420,7 @@ core_create_failed:
     /* Initialize our default ICCProfilesDir */
     pio->profiledir = NULL;
     pio->profiledir_len = 0;
+    pio->linkcachedir = NULL;
     pio->icc_color_accuracy = MAX_COLOR_ACCURACY;
     if (gs_lib_ctx_set_icc_directory(mem, DEFAULT_DIR_ICC, strlen(DEFAULT_DIR_ICC)) < 0)
       goto Failure;
@@ -421,6 +482,8 @@ void gs_lib_ctx_fin(gs_memory_t *mem)
     sjpxd_destroy(mem);
     gs_free_object(ctx_mem, ctx->profiledir,
         "gs_lib_ctx_fin");
+    gs_free_object(ctx_mem, ctx->linkcachedir,
+        "gs_lib_ctx_fin");
 
     gs_free_object(ctx_mem, ctx->default_device_list,
                 "gs_lib_ctx_fin");
@@ -434,6 +497,7 @@ void gs_lib_ctx_fin(gs_memory_t *mem)
     gx_monitor_leave((gx_monitor_t *)(ctx->core->monitor));
     if (refs == 0) {
         gscms_destroy(ctx->core->cms_context);
+        gx_ht_memo_free(ctx->core);
         gx_monitor_free((gx_monitor_t *)(ctx->core->monitor));
 #ifdef WITH_CAL
         cal_fin(ctx->core->cal_ctx, ctx->core->memory);
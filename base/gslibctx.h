@@ -135,6 +135,10 @@ typedef struct {
 
     void *cms_context;  /* Opaque context pointer from underlying CMS in use */
 
+    /* Computed halftone orders and threshold arrays, shared by all the
+     * contexts (and hence threads) using this core. See gxhtmemo.h. */
+    struct gx_ht_memo_s *ht_memo;
+
     gs_callout_list_t *callouts;
 
     /* Stashed args */
@@ -175,6 +179,8 @@ typedef struct gs_lib_ctx_s
     uint screen_min_screen_levels;
     /* Accuracy vs. performance for ICC color */
     uint icc_color_accuracy;
+    /* Interpolate 1-input shading Functions from a table (see gxshade6.c). */
+    int shading_tabulate_functions;
     /* real time clock 'bias' value. Not strictly required, but some FTS
      * tests work better if realtime starts from 0 at boot time. */
     long real_time_0[2];
@@ -187,6 +193,7 @@ typedef struct gs_lib_ctx_s
      * and one in the device */
     char *profiledir;               /* Directory used in searching for ICC profiles */
     int profiledir_len;             /* length of directory name (allows for Unicode) */
+    char *linkcachedir;             /* Directory of the on-disk ICC link cache, or NULL */
     gs_fapi_server **fapi_servers;
     char *default_device_list;
     int gcsignal;
@@ -226,6 +233,10 @@ int gs_lib_ctx_nts_adjust(gs_memory_t *mem, int adjust);
 
 int gs_lib_ctx_set_icc_directory(const gs_memory_t *mem_gc, const char* pname,
                                  int dir_namelen);
+int gs_lib_ctx_set_icc_link_cache_directory(const gs_memory_t *mem_gc,
+                                            const char* pname, int dir_namelen);
+int gs_lib_ctx_get_icc_link_cache_directory(const gs_memory_t *mem,
+                                            char *dir, int size);
 
 
 /* Sets/Gets the string containing the list of device names we should search
@@ -39,6 +39,21 @@
 /* GC descriptors */
 private_st_shading();
 
+/* Shadings with a 1-input Function may own a table of its samples. */
+static struct_proc_finalize(shading_finalize);
+static void
+shading_finalize(const gs_memory_t *cmem, void *vptr)
+{
+    gs_shading_t *psh = (gs_shading_t *)vptr;
+
+    (void)cmem; /* unused */
+    if (psh->head.function_lut != NULL) {
+        gs_free_object(psh->head.function_lut->memory, psh->head.function_lut,
+                       "shading_finalize");
+        psh->head.function_lut = NULL;
+    }
+}
+
 static
 ENUM_PTRS_WITH(shading_mesh_enum_ptrs, gs_shading_mesh_t *psm)
 {
@@ -162,6 +177,7 @@ mesh_shading_params_init(gs_shading_mesh_params_t *params)
       return_error(gs_error_VMerror);\
     psh->head.type = stype;\
     psh->head.procs = sprocs;\
+    psh->head.function_lut = NULL;\
     psh->params = *params;\
     *ppsh = (gs_shading_t *)psh;\
   END
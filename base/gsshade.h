@@ -84,6 +84,9 @@ typedef struct gs_shading_procs_s {
 typedef struct gs_shading_head_s {
     gs_shading_type_t type;
     gs_shading_procs_t procs;
+    /* Samples of the Function, made on first use when filling and freed */
+    /* with the shading (see init_patch_function_lut in gxshade6.c). */
+    struct gs_shading_function_lut_s *function_lut;
 } gs_shading_head_t;
 
 /* Define a generic shading, for use as the target type of pointers. */
@@ -120,9 +123,9 @@ typedef struct gs_shading_A_params_s {
 } gs_shading_A_params_t;
 
 #define private_st_shading_A()	/* in gsshade.c */\
-  gs_private_st_suffix_add1(st_shading_A, gs_shading_A_t,\
+  gs_private_st_suffix_add1_final(st_shading_A, gs_shading_A_t,\
     "gs_shading_A_t", shading_A_enum_ptrs, shading_A_reloc_ptrs,\
-    st_shading, params.Function)
+    shading_finalize, st_shading, params.Function)
 
 /* Define Radial shading. */
 typedef struct gs_shading_R_params_s {
@@ -134,9 +137,9 @@ typedef struct gs_shading_R_params_s {
 } gs_shading_R_params_t;
 
 #define private_st_shading_R()	/* in gsshade.c */\
-  gs_private_st_suffix_add1(st_shading_R, gs_shading_R_t,\
+  gs_private_st_suffix_add1_final(st_shading_R, gs_shading_R_t,\
     "gs_shading_R_t", shading_R_enum_ptrs, shading_R_reloc_ptrs,\
-    st_shading, params.Function)
+    shading_finalize, st_shading, params.Function)
 
 /* Define common parameters for mesh shading. */
 #define gs_shading_mesh_params_common\
@@ -162,8 +165,9 @@ typedef struct gs_shading_FfGt_params_s {
 } gs_shading_FfGt_params_t;
 
 #define private_st_shading_FfGt()	/* in gsshade.c */\
-  gs_private_st_composite_only(st_shading_FfGt, gs_shading_FfGt_t,\
-    "gs_shading_FfGt_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs)
+  gs_private_st_composite_final(st_shading_FfGt, gs_shading_FfGt_t,\
+    "gs_shading_FfGt_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs,\
+    shading_finalize)
 
 /* Define Lattice-form Gouraud triangle mesh shading. */
 typedef struct gs_shading_LfGt_params_s {
@@ -172,8 +176,9 @@ typedef struct gs_shading_LfGt_params_s {
 } gs_shading_LfGt_params_t;
 
 #define private_st_shading_LfGt()	/* in gsshade.c */\
-  gs_private_st_composite_only(st_shading_LfGt, gs_shading_LfGt_t,\
-    "gs_shading_LfGt_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs)
+  gs_private_st_composite_final(st_shading_LfGt, gs_shading_LfGt_t,\
+    "gs_shading_LfGt_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs,\
+    shading_finalize)
 
 /* Define Coons patch mesh shading. */
 typedef struct gs_shading_Cp_params_s {
@@ -182,8 +187,9 @@ typedef struct gs_shading_Cp_params_s {
 } gs_shading_Cp_params_t;
 
 #define private_st_shading_Cp()	/* in gsshade.c */\
-  gs_private_st_composite_only(st_shading_Cp, gs_shading_Cp_t,\
-    "gs_shading_Cp_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs)
+  gs_private_st_composite_final(st_shading_Cp, gs_shading_Cp_t,\
+    "gs_shading_Cp_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs,\
+    shading_finalize)
 
 /* Define Tensor product patch mesh shading. */
 typedef struct gs_shading_Tpp_params_s {
@@ -192,8 +198,9 @@ typedef struct gs_shading_Tpp_params_s {
 } gs_shading_Tpp_params_t;
 
 #define private_st_shading_Tpp()	/* in gsshade.c */\
-  gs_private_st_composite_only(st_shading_Tpp, gs_shading_Tpp_t,\
-    "gs_shading_Tpp_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs)
+  gs_private_st_composite_final(st_shading_Tpp, gs_shading_Tpp_t,\
+    "gs_shading_Tpp_t", shading_mesh_enum_ptrs, shading_mesh_reloc_ptrs,\
+    shading_finalize)
 
 /* ---------------- Procedures ---------------- */
 
@@ -247,4 +254,8 @@ int gs_shading_do_fill_rectangle(const gs_shading_t *psh,
 int gs_shading_path_add_box(gx_path *ppath, const gs_rect *pbox,
                      const gs_matrix_fixed *pmat);
 
+/* TabulateShadingFunctions control */
+void gs_settabulateshadingfunctions(gs_memory_t *mem, bool tabulate);
+bool gs_currenttabulateshadingfunctions(const gs_memory_t *mem);
+
 #endif /* gsshade_INCLUDED */
@@ -170,6 +170,131 @@ tiff_from_filep(gx_device_printer *dev,  const char *name, gp_file *filep, int b
     return t;
 }
 
+/* libtiff i/o hooks for a TIFF written to a tiff_memory_buffer, see
+ * tiff_to_memory(). The message handlers expect a tifs_io_private at the
+ * start of the client data, so that comes first.
+ */
+typedef struct tifs_mem_private_t
+{
+    tifs_io_private io;
+    tiff_memory_buffer *buf;
+    uint64_t pos;
+} tifs_mem_private;
+
+static size_t
+gs_tifsMemReadProc(thandle_t fd, void* buf, size_t size)
+{
+    tifs_mem_private *tiffio = (tifs_mem_private *)fd;
+    tiff_memory_buffer *mbuf = tiffio->buf;
+
+    if (tiffio->pos >= mbuf->size)
+        return 0;
+    if (size > mbuf->size - tiffio->pos)
+        size = (size_t)(mbuf->size - tiffio->pos);
+    memcpy(buf, mbuf->data + tiffio->pos, size);
+    tiffio->pos += size;
+    return size;
+}
+
+static size_t
+gs_tifsMemWriteProc(thandle_t fd, void* buf, size_t size)
+{
+    tifs_mem_private *tiffio = (tifs_mem_private *)fd;
+    tiff_memory_buffer *mbuf = tiffio->buf;
+    uint64_t end = tiffio->pos + size;
+
+    if (end > mbuf->alloc) {
+        uint64_t alloc = max(end, mbuf->alloc * 2);
+        byte *data;
+
+        if ((size_t)alloc != alloc)
+            return (size_t) -1;
+        data = gs_alloc_bytes(mbuf->memory, (size_t)alloc, "gs_tifsMemWriteProc");
+        if (data == NULL)
+            return (size_t) -1;
+        if (mbuf->data != NULL) {
+            memcpy(data, mbuf->data, (size_t)mbuf->size);
+            gs_free_object(mbuf->memory, mbuf->data, "gs_tifsMemWriteProc");
+        }
+        mbuf->data = data;
+        mbuf->alloc = alloc;
+    }
+    if (tiffio->pos > mbuf->size)
+        memset(mbuf->data + mbuf->size, 0, (size_t)(tiffio->pos - mbuf->size));
+    memcpy(mbuf->data + tiffio->pos, buf, size);
+    tiffio->pos = end;
+    if (end > mbuf->size)
+        mbuf->size = end;
+    return size;
+}
+
+static uint64_t
+gs_tifsMemSeekProc(thandle_t fd, uint64_t off, int whence)
+{
+    tifs_mem_private *tiffio = (tifs_mem_private *)fd;
+
+    switch (whence) {
+        case SEEK_SET:
+            tiffio->pos = off;
+            break;
+        case SEEK_CUR:
+            tiffio->pos += off;
+            break;
+        case SEEK_END:
+            tiffio->pos = tiffio->buf->size + off;
+            break;
+        default:
+            return (uint64_t) -1;
+    }
+    return tiffio->pos;
+}
+
+static int
+gs_tifsMemCloseProc(thandle_t fd)
+{
+    tifs_mem_private *tiffio = (tifs_mem_private *)fd;
+
+    /* The data belongs to the caller's buffer, which outlives the TIFF. */
+    gs_free(tiffio->io.memory, tiffio, sizeof(tifs_mem_private), 1, "gs_tifsMemCloseProc");
+
+    return 0;
+}
+
+static uint64_t
+gs_tifsMemSizeProc(thandle_t fd)
+{
+    tifs_mem_private *tiffio = (tifs_mem_private *)fd;
+
+    return tiffio->buf->size;
+}
+
+TIFF *
+tiff_to_memory(tiff_memory_buffer *buf, const char *name, int big_endian)
+{
+    TIFF *t;
+    tifs_mem_private *tiffio;
+
+    tiffio = (tifs_mem_private *)gs_malloc(buf->memory, sizeof(tifs_mem_private), 1, "tiff_to_memory");
+    if (!tiffio) {
+        return NULL;
+    }
+    tiffio->io.f = NULL;
+    tiffio->io.memory = buf->memory;
+    tiffio->buf = buf;
+    tiffio->pos = 0;
+    buf->size = 0;
+
+    t = TIFFClientOpen(name, big_endian ? "wb" : "wl",
+        (thandle_t) tiffio, (TIFFReadWriteProc)gs_tifsMemReadProc,
+        (TIFFReadWriteProc)gs_tifsMemWriteProc, (TIFFSeekProc)gs_tifsMemSeekProc,
+        gs_tifsMemCloseProc, (TIFFSizeProc)gs_tifsMemSizeProc, gs_tifsDummyMapProc,
+        gs_tifsDummyUnmapProc);
+    if (t == NULL)
+        gs_free(buf->memory, tiffio, sizeof(tifs_mem_private), 1, "tiff_to_memory");
+
+    return t;
+}
+
 static void
 gs_tifsWarningHandlerEx(thandle_t client_data, const char* module, const char* fmt, va_list ap)
 {
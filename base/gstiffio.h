@@ -24,4 +24,18 @@ TIFF *
 tiff_from_filep(gx_device_printer *dev,  const char *name, gp_file *filep, int big_endian, bool usebigtiff);
 void tiff_set_handlers (void);
 
+/* A growable block of memory for tiff_to_memory() to write to. The data
+ * is allocated from 'memory' and stays with the buffer after TIFFClose, so
+ * one buffer can be reused for many TIFFs; the caller frees 'data'.
+ */
+typedef struct tiff_memory_buffer_s {
+    gs_memory_t *memory;
+    byte *data;
+    uint64_t size;
+    uint64_t alloc;
+} tiff_memory_buffer;
+
+TIFF *
+tiff_to_memory(tiff_memory_buffer *buf, const char *name, int big_endian);
+
 #endif /* gstiffio_INCLUDED */
@@ -775,7 +775,10 @@ clist_get_bits_rectangle(gx_device *dev, const gs_int_rect * prect,
     }
     {
         gs_get_bits_params_t band_params;
-        uint raster = gx_device_raster(bdev, true);
+        /* Step the client's pointers by the client's raster, which is not
+           the band's if it asked for a rectangle narrower than the page. */
+        uint raster = (options & GB_RASTER_SPECIFIED ? params->raster :
+                       gx_device_raster(bdev, true));
 
         code = gdev_create_buf_device(cdev->buf_procs.create_buf_device,
                                       &bdev, cdev->target, y, &render_plane,
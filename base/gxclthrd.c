@@ -239,9 +239,11 @@ setup_device_and_mem_for_thread(gs_memory_t *chunk_base_mem, gx_device *dev, boo
        point, the threads are torn down, the master clist reader device
        is changed to writer, and the icc_table and the icc_cache_cl freed */
     if (dev->icc_struct == ndev->icc_struct) {
-    /* safe to share the link cache */
-        ncdev->icc_cache_cl = cdev->icc_cache_cl;
-        rc_increment(cdev->icc_cache_cl);		/* FIXME: needs to be incdemented safely */
+        /* Safe to share the links, so the thread gets a cache of its own
+           that borrows them from the shared one. Then finding a link the
+           thread has used before doesn't contend with the other threads. */
+        if ((ncdev->icc_cache_cl = gsicc_cache_new_thread(thread_mem, cdev->icc_cache_cl)) == NULL)
+            goto out_cleanup;
     } else {
         /* each thread needs its own link cache */
         if (cachep != NULL) {
@@ -781,6 +781,8 @@ typedef struct gdev_pagelist_s {
         gs_graphics_type_tag_t   graphics_type_tag;   /* e.g. vector, image or text */\
         int interpolate_control;      /* default 1 (use image /Interpolate value), 0 is NOINTERPOLATE. */\
                                       /* > 1 limits interpolation, < 0 forces interpolation */\
+        int RegionOfInterest[4];      /* x0 y0 x1 y1 of the page in device pixels, */\
+                                      /* the device covers only this area; all 0 = whole page */\
         gx_page_device_procs page_procs;       /* must be last */\
                 /* end of std_device_body */\
         gx_device_procs procs	/* object procedures */
@@ -1712,6 +1714,12 @@ void gx_device_set_resolution(gx_device * dev, double x_dpi, double y_dpi);
 /* Set the MediaSize (in 1/72" units), updating width and height. */
 void gx_device_set_media_size(gx_device * dev, double media_width, double media_height);
 
+/* Set or clear (roi == NULL) the RegionOfInterest, updating width and height. */
+void gx_device_set_region_of_interest(gx_device * dev, const int *roi);
+
+/* Get the size (in pixels) of the whole page, ignoring any RegionOfInterest. */
+void gx_device_get_page_hwsize(const gx_device * dev, int *pwidth, int *pheight);
+
 /****** BACKWARD COMPATIBILITY ******/
 #define gx_device_set_page_size(dev, w, h)\
   gx_device_set_media_size(dev, w, h)
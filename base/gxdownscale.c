@@ -19,6 +19,11 @@
 #include "string_.h"
 #include "gdevprn.h"
 #include "assert_.h"
+#include "stdint_.h"
+
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 #ifdef WITH_CAL
 #include "cal_ets.h"
@@ -1184,110 +1189,6 @@ static void down_core4_mfs(gx_downscaler_t *ds,
 }
 
 /* Grey (or planar) downscale code */
-static void down_core16(gx_downscaler_t *ds,
-                        byte            *outp,
-                        byte            *in_buffer,
-                        int              row,
-                        int              plane,
-                        int              span)
-{
-    int   x, xx, y, value;
-    int   pad_white;
-    byte *inp;
-    int   width  = ds->width;
-    int   awidth = ds->awidth;
-    int   factor = ds->factor;
-    int   div    = factor*factor;
-
-    pad_white = (awidth - width) * factor;
-    if (pad_white < 0)
-        pad_white = 0;
-
-    if (pad_white)
-    {
-        inp = in_buffer + width*2*factor;
-        for (y = factor; y > 0; y--)
-        {
-            memset(inp, 0xFF, pad_white*2);
-            inp += span;
-        }
-    }
-
-    inp = in_buffer;
-    {
-        /* Left to Right pass (no min feature size) */
-        const int back = span * factor -2;
-        for (x = awidth; x > 0; x--)
-        {
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
-                {
-                    value += inp[0]<<8;
-                    value += inp[1];
-                    inp += span;
-                }
-                inp -= back;
-            }
-            value = (value + (div>>1))/div;
-            outp[0] = value>>8;
-            outp[1] = value;
-            outp += 2;
-        }
-    }
-}
-
-static void down_core8(gx_downscaler_t *ds,
-                       byte            *outp,
-                       byte            *in_buffer,
-                       int              row,
-                       int              plane,
-                       int              span)
-{
-    int   x, xx, y, value;
-    int   pad_white;
-    byte *inp;
-    int   width  = ds->width;
-    int   awidth = ds->awidth;
-    int   factor = ds->factor;
-    int   div    = factor*factor;
-
-    pad_white = (awidth - width) * factor;
-    if (pad_white < 0)
-        pad_white = 0;
-
-    if (pad_white)
-    {
-        inp = in_buffer + width*factor;
-        for (y = factor; y > 0; y--)
-        {
-            memset(inp, 0xFF, pad_white);
-            inp += span;
-        }
-    }
-
-    inp = in_buffer;
-    {
-        /* Left to Right pass (no min feature size) */
-        const int back = span * factor -1;
-        for (x = awidth; x > 0; x--)
-        {
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
-                {
-                    value += *inp;
-                    inp += span;
-                }
-                inp -= back;
-            }
-            *outp++ = (value+(div>>1))/div;
-        }
-    }
-}
-
 static void down_core8_2(gx_downscaler_t *ds,
                          byte            *outp,
                          byte            *in_buffer,
@@ -1519,181 +1420,280 @@ static void down_core8_3_4(gx_downscaler_t *ds,
     }
 }
 
-/* RGB downscale (no error diffusion) code */
+/* Box filter (no error diffusion) code for chunky data with 1, 3 or 4
+ * components of 8 or 16 bits.
+ *
+ * Each output sample is the rounded mean of a factor x factor block of
+ * input samples. Rather than walking down the columns of every block, we
+ * sum the factor rows of a chunk of pixels first (a contiguous pass that
+ * is vectorised where we have SSE2), then sum across the columns of the
+ * row sums. The division is a multiply by a reciprocal, which is exact
+ * for every sum we can get (checked for all factors up to 8). So the
+ * results are the same as those of the simple loops these replaced.
+ */
 
-static void down_core24(gx_downscaler_t *ds,
-                        byte            *outp,
-                        byte            *in_buffer,
-                        int              row,
-                        int              plane,
-                        int              span)
+/* Output pixels per chunk; the row sums for a chunk live on the stack. */
+#define BOX_CHUNK 64
+#define BOX_MAX_SAMPLES (BOX_CHUNK * 8 * 4)
+
+/* Sum n 8 bit samples down factor rows. */
+static void
+box_sum_rows8(ushort *sums, const byte *inp, int n, int factor, int span)
 {
-    int   x, xx, y, value;
-    int   pad_white;
+    int i = 0, y;
+
+#ifdef HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= n; i += 16) {
+        const byte *p = inp + i;
+        __m128i lo = zero, hi = zero;
+
+        for (y = factor; y > 0; y--) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+            p += span;
+        }
+        _mm_storeu_si128((__m128i *)(sums + i), lo);
+        _mm_storeu_si128((__m128i *)(sums + i + 8), hi);
+    }
+#endif
+    for (; i < n; i++) {
+        const byte *p = inp + i;
+        uint v = 0;
+
+        for (y = factor; y > 0; y--) {
+            v += *p;
+            p += span;
+        }
+        sums[i] = v;
+    }
+}
+
+/* Sum n 16 bit (big endian) samples down factor rows. */
+static void
+box_sum_rows16(uint *sums, const byte *inp, int n, int factor, int span)
+{
+    int i = 0, y;
+
+#ifdef HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= n; i += 8) {
+        const byte *p = inp + 2 * i;
+        __m128i lo = zero, hi = zero;
+
+        for (y = factor; y > 0; y--) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+            p += span;
+        }
+        _mm_storeu_si128((__m128i *)(sums + i), lo);
+        _mm_storeu_si128((__m128i *)(sums + i + 4), hi);
+    }
+#endif
+    for (; i < n; i++) {
+        const byte *p = inp + 2 * i;
+        uint v = 0;
+
+        for (y = factor; y > 0; y--) {
+            v += (p[0]<<8) | p[1];
+            p += span;
+        }
+        sums[i] = v;
+    }
+}
+
+static inline void
+down_core_box8(gx_downscaler_t *ds,
+               byte            *outp,
+               byte            *in_buffer,
+               int              span,
+               int              nc)
+{
+    ushort sums[BOX_MAX_SAMPLES];
+    int   x, xx, c, i, n, pad_white;
     byte *inp;
     int   width  = ds->width;
     int   awidth = ds->awidth;
     int   factor = ds->factor;
-    int   div    = factor*factor;
+    uint  div    = factor*factor;
+    uint  recip  = (1<<20)/div + 1;
+    const int step = factor*nc;
 
-    pad_white = (awidth - width) * factor * 3;
+    pad_white = (awidth - width) * step;
     if (pad_white < 0)
         pad_white = 0;
 
     if (pad_white)
     {
-        inp = in_buffer + width*factor*3;
-        for (y = factor; y > 0; y--)
+        inp = in_buffer + width*step;
+        for (x = factor; x > 0; x--)
         {
             memset(inp, 0xFF, pad_white);
             inp += span;
         }
     }
 
-    inp = in_buffer;
+    for (x = 0; x < awidth; x += n)
     {
-        /* Left to Right pass (no min feature size) */
-        const int back  = span * factor - 3;
-        const int back2 = factor * 3 - 1;
-        for (x = awidth; x > 0; x--)
+        const ushort *s = sums;
+
+        n = awidth - x;
+        if (n > BOX_CHUNK)
+            n = BOX_CHUNK;
+        box_sum_rows8(sums, in_buffer + x*step, n*step, factor, span);
+        for (i = n; i > 0; i--)
         {
-            /* R */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
-                {
-                    value += *inp;
-                    inp += span;
-                }
-                inp -= back;
-            }
-            inp -= back2;
-            *outp++ = (value+(div>>1))/div;
-            /* G */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
+            for (c = 0; c < nc; c++)
             {
-                for (y = factor; y > 0; y--)
-                {
-                    value += *inp;
-                    inp += span;
-                }
-                inp -= back;
-            }
-            inp -= back2;
-            *outp++ = (value+(div>>1))/div;
-            /* B */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
+                const ushort *p = s + c;
+                uint value = div>>1;
+
+                for (xx = factor; xx > 0; xx--)
                 {
-                    value += *inp;
-                    inp += span;
+                    value += *p;
+                    p += nc;
                 }
-                inp -= back;
+                *outp++ = (value * recip)>>20;
             }
-            inp -= 2;
-            *outp++ = (value+(div>>1))/div;
+            s += step;
         }
     }
 }
 
-/* CMYK downscale (no error diffusion) code */
-
-static void down_core32(gx_downscaler_t *ds,
-                        byte            *outp,
-                        byte            *in_buffer,
-                        int              row,
-                        int              plane,
-                        int              span)
+static inline void
+down_core_box16(gx_downscaler_t *ds,
+                byte            *outp,
+                byte            *in_buffer,
+                int              span,
+                int              nc)
 {
-    int   x, xx, y, value;
-    int   pad_white;
+    uint  sums[BOX_MAX_SAMPLES];
+    int   x, xx, c, i, n, pad_white;
     byte *inp;
     int   width  = ds->width;
     int   awidth = ds->awidth;
     int   factor = ds->factor;
-    int   div    = factor*factor;
+    uint  div    = factor*factor;
+    uint64_t recip = ((uint64_t)1<<28)/div + 1;
+    const int step = factor*nc;
 
-    pad_white = (awidth - width) * factor * 4;
+    pad_white = (awidth - width) * step;
     if (pad_white < 0)
         pad_white = 0;
 
     if (pad_white)
     {
-        inp = in_buffer + width*factor*4;
-        for (y = factor; y > 0; y--)
+        inp = in_buffer + width*2*step;
+        for (x = factor; x > 0; x--)
         {
-            memset(inp, 0xFF, pad_white);
+            memset(inp, 0xFF, pad_white*2);
             inp += span;
         }
     }
 
-    inp = in_buffer;
+    for (x = 0; x < awidth; x += n)
     {
-        /* Left to Right pass (no min feature size) */
-        const int back  = span * factor - 4;
-        const int back2 = factor * 4 - 1;
-        for (x = awidth; x > 0; x--)
+        const uint *s = sums;
+
+        n = awidth - x;
+        if (n > BOX_CHUNK)
+            n = BOX_CHUNK;
+        box_sum_rows16(sums, in_buffer + x*2*step, n*step, factor, span);
+        for (i = n; i > 0; i--)
         {
-            /* C */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
+            for (c = 0; c < nc; c++)
             {
-                for (y = factor; y > 0; y--)
-                {
-                    value += *inp;
-                    inp += span;
-                }
-                inp -= back;
-            }
-            inp -= back2;
-            *outp++ = (value+(div>>1))/div;
-            /* M */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
-                {
-                    value += *inp;
-                    inp += span;
-                }
-                inp -= back;
-            }
-            inp -= back2;
-            *outp++ = (value+(div>>1))/div;
-            /* Y */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
-                {
-                    value += *inp;
-                    inp += span;
-                }
-                inp -= back;
-            }
-            inp -= back2;
-            *outp++ = (value+(div>>1))/div;
-            /* K */
-            value = 0;
-            for (xx = factor; xx > 0; xx--)
-            {
-                for (y = factor; y > 0; y--)
+                const uint *p = s + c;
+                uint value = div>>1;
+
+                for (xx = factor; xx > 0; xx--)
                 {
-                    value += *inp;
-                    inp += span;
+                    value += *p;
+                    p += nc;
                 }
-                inp -= back;
+                value = (uint)((value * recip)>>28);
+                outp[0] = value>>8;
+                outp[1] = value;
+                outp += 2;
             }
-            inp -= 3;
-            *outp++ = (value+(div>>1))/div;
+            s += step;
         }
     }
 }
 
+/* Grey downscale (no error diffusion) code */
+
+static void down_core8(gx_downscaler_t *ds,
+                       byte            *outp,
+                       byte            *in_buffer,
+                       int              row,
+                       int              plane,
+                       int              span)
+{
+    down_core_box8(ds, outp, in_buffer, span, 1);
+}
+
+static void down_core16(gx_downscaler_t *ds,
+                        byte            *outp,
+                        byte            *in_buffer,
+                        int              row,
+                        int              plane,
+                        int              span)
+{
+    down_core_box16(ds, outp, in_buffer, span, 1);
+}
+
+/* RGB downscale (no error diffusion) code */
+
+static void down_core24(gx_downscaler_t *ds,
+                        byte            *outp,
+                        byte            *in_buffer,
+                        int              row,
+                        int              plane,
+                        int              span)
+{
+    down_core_box8(ds, outp, in_buffer, span, 3);
+}
+
+static void down_core48(gx_downscaler_t *ds,
+                        byte            *outp,
+                        byte            *in_buffer,
+                        int              row,
+                        int              plane,
+                        int              span)
+{
+    down_core_box16(ds, outp, in_buffer, span, 3);
+}
+
+/* CMYK downscale (no error diffusion) code */
+
+static void down_core32(gx_downscaler_t *ds,
+                        byte            *outp,
+                        byte            *in_buffer,
+                        int              row,
+                        int              plane,
+                        int              span)
+{
+    down_core_box8(ds, outp, in_buffer, span, 4);
+}
+
+static void down_core64(gx_downscaler_t *ds,
+                        byte            *outp,
+                        byte            *in_buffer,
+                        int              row,
+                        int              plane,
+                        int              span)
+{
+    down_core_box16(ds, outp, in_buffer, span, 4);
+}
+
 void gx_downscaler_decode_factor(int factor, int *up, int *down)
 {
     if (factor == 32)
@@ -2565,12 +2565,24 @@ int gx_downscaler_init_cm(gx_downscaler_t      *ds,
                                           params->ets ? &bogus_ets_halftone : NULL);
 }
 
+/* Choose a core to average chunky data with 8 or 16 bits per component. */
 static gx_downscale_core *
-select_8_to_8_core(int nc, int factor)
+select_box_core(int nc, int bpc, int factor)
 {
     if (factor == 1)
         return NULL; /* No sense doing anything */
-    if (nc == 1)
+    if (bpc == 16)
+    {
+        if (nc == 1)
+            return &down_core16;
+        else if (nc == 3)
+            return &down_core48;
+        else if (nc == 4)
+            return &down_core64;
+    }
+    else if (bpc != 8)
+        return NULL;
+    else if (nc == 1)
     {
         if (factor == 4)
             return &down_core8_4;
@@ -2589,6 +2601,12 @@ select_8_to_8_core(int nc, int factor)
     return NULL;
 }
 
+static gx_downscale_core *
+select_8_to_8_core(int nc, int factor)
+{
+    return select_box_core(nc, 8, factor);
+}
+
 int
 gx_downscaler_init_cm_halftone(gx_downscaler_t      *ds,
                                gx_device            *dev,
@@ -2795,9 +2813,9 @@ gx_downscaler_init_cm_halftone(gx_downscaler_t      *ds,
             code = gs_note_error(gs_error_rangecheck);
             goto cleanup;
         }
-        else if ((src_bpc == 16) && (dst_bpc == 16) && (nc == 1))
+        else if ((src_bpc == 16) && (dst_bpc == 16))
         {
-            core = &down_core16;
+            core = select_box_core(nc, 16, factor);
         }
         else if ((src_bpc == 8) && (dst_bpc == 1) && (nc == 4))
         {
@@ -3186,7 +3204,7 @@ static int downscaler_init_fn(void *arg_, gx_device *dev, gs_memory_t *memory, i
                                                  &buffer->orig_buffer);
         if (code < 0) {
             if (buffer->bdev)
-                dev_proc(dev, close_device)(dev);
+                gx_default_destroy_buf_device(buffer->bdev);
             gs_free_object(memory, buffer, "downscaler process_page buffer");
             return code;
         }
@@ -3219,15 +3237,19 @@ static int downscaler_process_fn(void *arg_, gx_device *dev, gx_device *bdev, co
     code = dev_proc(bdev, get_bits_rectangle)(bdev, &in_rect, &params);
     if (code < 0)
         return code;
-    raster_in = params.raster;
+    /* A returned pointer comes back with GB_RASTER_STANDARD, and no raster */
+    raster_in = (params.options & GB_RASTER_SPECIFIED ? params.raster :
+                 gx_device_raster(bdev, 1));
     in_ptr = params.data[0];
 
     /* Where do we write it to? */
     if (buffer->bdev) {
+        params.options = GB_COLORS_NATIVE | GB_ALPHA_NONE | GB_PACKING_CHUNKY | GB_RETURN_POINTER | GB_ALIGN_ANY | GB_OFFSET_0 | GB_RASTER_ANY;
         code = dev_proc(bdev, get_bits_rectangle)(buffer->bdev, &out_rect, &params);
         if (code < 0)
             return code;
-        raster_out = params.raster;
+        raster_out = (params.options & GB_RASTER_SPECIFIED ? params.raster :
+                      gx_device_raster(buffer->bdev, 1));
         out_ptr = params.data[0];
     } else {
         raster_out = raster_in;
@@ -3239,8 +3261,8 @@ static int downscaler_process_fn(void *arg_, gx_device *dev, gx_device *bdev, co
         int y;
         for (y = rect->p.y; y < rect->q.y; y += arg->downfactor)
         {
-            arg->ds.down_core(&arg->ds, out_ptr, in_ptr, y, 0, arg->ds.span);
-            in_ptr += arg->ds.span * arg->downfactor;
+            arg->ds.down_core(&arg->ds, out_ptr, in_ptr, y, 0, raster_in);
+            in_ptr += raster_in * arg->downfactor;
             out_ptr += raster_out * arg->upfactor;
         }
     }
@@ -3265,7 +3287,7 @@ downscaler_free_fn(void *arg_, gx_device *dev, gs_memory_t *memory, void *buffer
     arg->orig_options->free_buffer_fn(arg->orig_options->arg, dev, memory,
                                       buffer->orig_buffer);
     if (buffer->bdev)
-        dev_proc(dev, close_device)(dev);
+        gx_default_destroy_buf_device(buffer->bdev);
     gs_free_object(memory, buffer, "downscaler process_page buffer");
 }
 
@@ -3288,7 +3310,8 @@ int gx_downscaler_process_page(gx_device                 *dev,
     downscaler_process_page_arg_t arg = { 0 };
     gx_process_page_options_t my_options = { 0 };
     int num_comps = dev->color_info.num_components;
-    int src_bpc = dev->color_info.comp_bits[0];
+    /* comp_bits is only filled in for separable devices */
+    int src_bpc = dev->color_info.depth / num_comps;
     int scaled_w;
     gx_downscale_core *core;
 
@@ -3306,33 +3329,10 @@ int gx_downscaler_process_page(gx_device                 *dev,
 
     /* Choose an appropriate core */
     if (factor > 8)
-    {
         return gs_note_error(gs_error_rangecheck);
-    }
-    else if ((src_bpc == 16) && (num_comps == 1))
-    {
-        core = &down_core16;
-    }
-    else if (factor == 1)
-        core = NULL;
-    else if ((src_bpc == 8) && (num_comps == 1))
-    {
-        if (factor == 4)
-            core = &down_core8_4;
-        else if (factor == 3)
-            core = &down_core8_3;
-        else if (factor == 2)
-            core = &down_core8_2;
-        else
-            core = &down_core8;
-    }
-    else if ((src_bpc == 8) && (num_comps == 3))
-        core = &down_core24;
-    else if ((src_bpc == 8) && (num_comps == 4))
-         core = &down_core32;
-    else {
+    core = select_box_core(num_comps, src_bpc, factor);
+    if (core == NULL && factor != 1)
         return gs_note_error(gs_error_rangecheck);
-    }
     arg.ds.down_core = core;
 
     my_options.init_buffer_fn = downscaler_init_fn;
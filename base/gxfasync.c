@@ -0,0 +1,541 @@
+/* Copyright (C) 2001-2021 Artifex Software, Inc.
+   All Rights Reserved.
+
+   This software is provided AS-IS with no warranty, either express or
+   implied.
+
+   This software is distributed under license and may not be copied,
+   modified or distributed except as expressly authorized under the terms
+   of the license contained in the file LICENSE in this distribution.
+
+   Refer to licensing information at http://www.artifex.com or contact
+   Artifex Software, Inc.,  1305 Grant Avenue - Suite 200, Novato,
+   CA 94945, U.S.A., +1(415)492-9861, for further information.
+*/
+
+
+/* Write-behind gp_file: writes are queued for a writer thread */
+
+/* glibc only declares O_DIRECT for _GNU_SOURCE. This must come before
+ * any system header is included. */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE
+#endif
+
+#include "errno_.h"
+#include "fcntl_.h"
+#include "stdio_.h"
+#include "memory_.h"
+#include "stdint_.h"
+#include "gp.h"
+#include "gpsync.h"
+#include "gsmemory.h"
+#include "gserrors.h"
+#include "gxsync.h"
+#include "gxfasync.h"
+
+#if defined(O_DIRECT) && defined(F_SETFL)
+#  define ASYNC_DIRECT_IO
+   /* Not unistd_.h, whose _XOPEN_SOURCE clashes with _GNU_SOURCE. */
+#  include <unistd.h>
+#endif
+
+/* Alignment (of memory, file offset and length) for direct writes */
+#define ASYNC_DIRECT_ALIGN 4096
+
+typedef struct async_buffer_s {
+    byte *data;
+    uint start;			/* data is in [start, end) */
+    uint end;
+    bool flush;			/* flush the target after writing it */
+} async_buffer_t;
+
+/*
+ * The buffers form a ring. The caller fills buffers[fill]; the thread
+ * writes buffers[next], and the ones after it up to fill. 'queued' counts
+ * the buffers handed to the thread, 'idle' the ones it has finished with
+ * (other than the one being filled).
+ */
+typedef struct gx_async_file_s {
+    gp_file base;
+    gp_file *target;
+    int num_buffers;
+    uint size;
+    async_buffer_t *buffers;
+    byte *block;		/* the (unaligned) allocation for the data */
+    int fill;
+    int next;			/* only used by the thread */
+    gx_semaphore_t *queued;
+    gx_semaphore_t *idle;
+    gp_thread_id thread;
+    bool stop;
+    volatile int error;		/* set by the thread */
+    /* Direct writes */
+    int fd;			/* < 0 if not writing directly */
+    uint align;			/* ASYNC_DIRECT_ALIGN if direct, otherwise 1 */
+    gs_offset_t pos;		/* file position of the next byte queued */
+    bool direct_on;		/* O_DIRECT is currently set on fd */
+} gx_async_file;
+
+/* ---------------- The writer thread ---------------- */
+
+#ifdef ASYNC_DIRECT_IO
+static int
+async_set_direct(gx_async_file *af, bool on)
+{
+    int flags;
+
+    if (af->direct_on == on)
+        return 0;
+    flags = fcntl(af->fd, F_GETFL);
+    if (flags == -1 ||
+        fcntl(af->fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT) == -1)
+        return -1;
+    af->direct_on = on;
+    return 0;
+}
+
+static int
+async_write_fd(gx_async_file *af, const byte *p, uint len, bool direct)
+{
+    if (len == 0)
+        return 0;
+    if (direct && async_set_direct(af, true) < 0)
+        direct = false;
+    if (!direct && async_set_direct(af, false) < 0)
+        return -1;
+    while (len > 0) {
+        ssize_t n = write(af->fd, p, len);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            /* Not every file system takes direct writes; carry on without. */
+            if (errno == EINVAL && direct) {
+                if (async_set_direct(af, false) < 0)
+                    return -1;
+                af->align = 1;
+                direct = false;
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+#endif
+
+static int
+async_write_buffer(gx_async_file *af, async_buffer_t *b)
+{
+    uint len = b->end - b->start;
+
+#ifdef ASYNC_DIRECT_IO
+    if (af->fd >= 0) {
+        /* The data's position in the buffer matches its position in the
+         * file, modulo the alignment, so the whole blocks in the middle
+         * are aligned in both. */
+        uint align = ASYNC_DIRECT_ALIGN;
+        uint head = min((b->start + align - 1) / align * align, b->end);
+        uint tail = max(b->end / align * align, head);
+
+        if (async_write_fd(af, b->data + b->start, head - b->start, false) < 0 ||
+            async_write_fd(af, b->data + head, tail - head, true) < 0 ||
+            async_write_fd(af, b->data + tail, b->end - tail, false) < 0)
+            return -1;
+        return 0;
+    }
+#endif
+    if (len > 0 && gp_fwrite(b->data + b->start, 1, len, af->target) != len)
+        return -1;
+    if (b->flush)
+        gp_fflush(af->target);
+    return 0;
+}
+
+static void
+async_thread(void *arg)
+{
+    gx_async_file *af = (gx_async_file *)arg;
+
+    for (;;) {
+        async_buffer_t *b;
+
+        gx_semaphore_wait(af->queued);
+        if (af->stop)
+            break;
+        b = &af->buffers[af->next];
+        /* After an error, just drop the data. */
+        if (!af->error && async_write_buffer(af, b) < 0)
+            af->error = 1;
+        af->next = (af->next + 1) % af->num_buffers;
+        gx_semaphore_signal(af->idle);
+    }
+}
+
+/* ---------------- The caller's side ---------------- */
+
+/* Hand the current buffer to the thread, and wait for another one. */
+static void
+async_submit(gx_async_file *af, bool flush)
+{
+    async_buffer_t *b = &af->buffers[af->fill];
+
+    b->flush = flush;
+    gx_semaphore_signal(af->queued);
+    af->fill = (af->fill + 1) % af->num_buffers;
+    gx_semaphore_wait(af->idle);
+    b = &af->buffers[af->fill];
+    b->start = b->end = (uint)(af->pos % af->align);
+    b->flush = false;
+}
+
+/* Wait until everything written so far has reached the target. */
+static void
+async_drain(gx_async_file *af)
+{
+    int i;
+
+    if (af->buffers[af->fill].end > af->buffers[af->fill].start)
+        async_submit(af, false);
+    for (i = 1; i < af->num_buffers; i++)
+        gx_semaphore_wait(af->idle);
+    for (i = 1; i < af->num_buffers; i++)
+        gx_semaphore_signal(af->idle);
+    /* The stdio stream didn't see the direct writes. */
+    if (af->fd >= 0)
+        gp_fseek(af->target, af->pos, SEEK_SET);
+}
+
+/* Stop the thread and free everything except the wrapper itself. */
+static int
+async_finish(gx_async_file *af)
+{
+    gs_memory_t *mem = af->base.memory;
+
+    if (af->thread != NULL) {
+        async_drain(af);
+        af->stop = true;
+        gx_semaphore_signal(af->queued);
+        gp_thread_finish(af->thread);
+        af->thread = NULL;
+#ifdef ASYNC_DIRECT_IO
+        if (af->fd >= 0)
+            async_set_direct(af, false);
+#endif
+    }
+    if (af->queued)
+        gx_semaphore_free(af->queued);
+    if (af->idle)
+        gx_semaphore_free(af->idle);
+    af->queued = af->idle = NULL;
+    gs_free_object(mem, af->block, "gx_async_file(data)");
+    gs_free_object(mem, af->buffers, "gx_async_file(buffers)");
+    af->block = NULL;
+    af->buffers = NULL;
+    return (af->error ? gs_note_error(gs_error_ioerror) : 0);
+}
+
+static int
+async_close(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+    int code = async_finish(af);
+    int ret = gp_fclose(af->target);
+
+    return (code < 0 ? -1 : ret);
+}
+
+static int
+async_write(gp_file *file, size_t size, unsigned int count, const void *buf)
+{
+    gx_async_file *af = (gx_async_file *)file;
+    const byte *p = (const byte *)buf;
+    size_t left = size * count;
+
+    if (af->error)
+        return 0;
+    while (left > 0) {
+        async_buffer_t *b = &af->buffers[af->fill];
+        uint n = (uint)min(left, (size_t)(af->size - b->end));
+
+        memcpy(b->data + b->end, p, n);
+        b->end += n;
+        af->pos += n;
+        p += n;
+        left -= n;
+        if (b->end == af->size)
+            async_submit(af, false);
+    }
+    return count;
+}
+
+static int
+async_putc(gp_file *file, int c)
+{
+    byte b = (byte)c;
+
+    return (async_write(file, 1, 1, &b) == 1 ? (int)b : EOF);
+}
+
+static void
+async_fflush(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    /* Don't wait: the thread flushes the target once it gets this far. */
+    if (!af->error)
+        async_submit(af, true);
+}
+
+static int
+async_ferror(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    return af->error || gp_ferror(af->target);
+}
+
+static void
+async_clearerr(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    af->error = 0;
+    gp_clearerr(af->target);
+}
+
+/* Everything else waits for the queue, then goes to the target. */
+
+static int
+async_getc(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    return gp_fgetc(af->target);
+}
+
+static int
+async_read(gp_file *file, size_t size, unsigned int count, void *buf)
+{
+    gx_async_file *af = (gx_async_file *)file;
+    int n;
+
+    async_drain(af);
+    n = gp_fread(buf, size, count, af->target);
+    if (af->fd >= 0)
+        af->pos = gp_ftell(af->target);
+    return n;
+}
+
+static int
+async_seek(gp_file *file, gs_offset_t offset, int whence)
+{
+    gx_async_file *af = (gx_async_file *)file;
+    int code;
+
+    async_drain(af);
+    code = gp_fseek(af->target, offset, whence);
+    af->pos = gp_ftell(af->target);
+    af->buffers[af->fill].start = af->buffers[af->fill].end =
+        (uint)(af->pos % af->align);
+    return code;
+}
+
+static gs_offset_t
+async_tell(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    return gp_ftell(af->target);
+}
+
+static int
+async_eof(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    return gp_feof(af->target);
+}
+
+static gp_file *
+async_dup(gp_file *file, const char *mode)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    return gp_fdup(af->target, mode);
+}
+
+static int
+async_seekable(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    return gp_fseekable(af->target);
+}
+
+static int
+async_pread(gp_file *file, size_t count, gs_offset_t offset, void *buf)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    return gp_fpread(buf, count, offset, af->target);
+}
+
+static int
+async_pwrite(gp_file *file, size_t count, gs_offset_t offset, const void *buf)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    async_drain(af);
+    return gp_fpwrite((void *)buf, count, offset, af->target);
+}
+
+static int
+async_is_char_buffered(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    return gp_file_is_char_buffered(af->target);
+}
+
+static FILE *
+async_get_file(gp_file *file)
+{
+    gx_async_file *af = (gx_async_file *)file;
+
+    /* The caller may write to the FILE * directly, so from now on the
+     * position can't be tracked for direct writes. */
+    async_drain(af);
+#ifdef ASYNC_DIRECT_IO
+    if (af->fd >= 0) {
+        async_set_direct(af, false);
+        af->fd = -1;
+        af->align = 1;
+    }
+#endif
+    return gp_get_file(af->target);
+}
+
+static const gp_file_ops_t gx_async_file_prototype =
+{
+    async_close,
+    async_getc,
+    async_putc,
+    async_read,
+    async_write,
+    async_seek,
+    async_tell,
+    async_eof,
+    async_dup,
+    async_seekable,
+    async_pread,
+    async_pwrite,
+    async_is_char_buffered,
+    async_fflush,
+    async_ferror,
+    async_get_file,
+    async_clearerr,
+    NULL			/* reopen */
+};
+
+gp_file *
+gx_async_file_wrap(const gs_memory_t *mem, gp_file *target, int num_buffers,
+                   uint buffer_size, int flags)
+{
+    gx_async_file *af;
+    gs_memory_t *amem;
+    uint align = 1;
+    int fd = -1;
+    byte *data;
+    int i;
+
+    if (target == NULL || num_buffers < 1 || buffer_size == 0)
+        return NULL;
+    /* One to fill while the thread writes the rest. */
+    num_buffers++;
+#ifdef ASYNC_DIRECT_IO
+    if ((flags & GX_ASYNC_FILE_DIRECT) && buffer_size % ASYNC_DIRECT_ALIGN == 0 &&
+        gp_get_file(target) != NULL && gp_fseekable(target)) {
+        FILE *f = gp_get_file(target);
+        int fl;
+
+        /* Check that the flag can be set; it's only set for the writes. */
+        fflush(f);
+        fd = fileno(f);
+        fl = fcntl(fd, F_GETFL);
+        if (fl == -1 || fcntl(fd, F_SETFL, fl | O_DIRECT) == -1 ||
+            fcntl(fd, F_SETFL, fl) == -1)
+            fd = -1;
+        else
+            align = ASYNC_DIRECT_ALIGN;
+    }
+#endif
+
+    af = (gx_async_file *)gp_file_alloc(mem, &gx_async_file_prototype,
+                                        sizeof(gx_async_file), "gx_async_file");
+    if (af == NULL)
+        return NULL;
+    amem = af->base.memory;
+    af->target = target;
+    af->num_buffers = num_buffers;
+    af->size = buffer_size;
+    af->fd = fd;
+    af->align = align;
+    af->pos = (fd >= 0 ? gp_ftell(target) : 0);
+    if (af->pos < 0)
+        af->pos = 0;
+    af->buffers = (async_buffer_t *)gs_alloc_bytes(amem,
+                        num_buffers * sizeof(async_buffer_t), "gx_async_file(buffers)");
+    af->block = gs_alloc_bytes(amem, (size_t)num_buffers * buffer_size + align - 1,
+                               "gx_async_file(data)");
+    af->queued = gx_semaphore_label(gx_semaphore_alloc(amem), "gx_async_file(queued)");
+    af->idle = gx_semaphore_label(gx_semaphore_alloc(amem), "gx_async_file(idle)");
+    if (af->buffers == NULL || af->block == NULL || af->queued == NULL ||
+        af->idle == NULL)
+        goto fail;
+    data = (byte *)(((uintptr_t)af->block + align - 1) / align * align);
+    for (i = 0; i < num_buffers; i++) {
+        af->buffers[i].data = data + (size_t)i * buffer_size;
+        af->buffers[i].start = af->buffers[i].end = 0;
+        af->buffers[i].flush = false;
+    }
+    af->buffers[0].start = af->buffers[0].end = (uint)(af->pos % align);
+    for (i = 1; i < num_buffers; i++)
+        gx_semaphore_signal(af->idle);
+    /* This fails in builds without threads. */
+    if (gp_thread_start(async_thread, af, &af->thread) < 0) {
+        af->thread = NULL;
+        goto fail;
+    }
+    gp_thread_label(af->thread, "Output writer");
+    return (gp_file *)af;
+
+  fail:
+    async_finish(af);
+    gp_file_dealloc((gp_file *)af);
+    return NULL;
+}
+
+gp_file *
+gx_async_file_unwrap(gp_file *file, int *pcode)
+{
+    gx_async_file *af = (gx_async_file *)file;
+    gp_file *target;
+
+    *pcode = 0;
+    if (file == NULL || file->ops.write != async_write)
+        return file;
+    *pcode = async_finish(af);
+    target = af->target;
+    gp_file_dealloc(file);
+    return target;
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2001-2021 Artifex Software, Inc.
+   All Rights Reserved.
+
+   This software is provided AS-IS with no warranty, either express or
+   implied.
+
+   This software is distributed under license and may not be copied,
+   modified or distributed except as expressly authorized under the terms
+   of the license contained in the file LICENSE in this distribution.
+
+   Refer to licensing information at http://www.artifex.com or contact
+   Artifex Software, Inc.,  1305 Grant Avenue - Suite 200, Novato,
+   CA 94945, U.S.A., +1(415)492-9861, for further information.
+*/
+
+
+/* Write-behind gp_file: writes are queued for a writer thread */
+
+#ifndef gxfasync_INCLUDED
+#  define gxfasync_INCLUDED
+
+#include "gp.h"
+
+/*
+ * Wrap a gp_file that is open for writing, so that writes are copied into
+ * one of num_buffers buffers of buffer_size bytes, and written to the
+ * target by a writer thread. The caller only blocks when every buffer is
+ * waiting to be written. gp_fflush hands over the buffer being filled
+ * without waiting for it; anything else that needs the target to be up to
+ * date (seeking, reading, gp_get_file...) waits for the queue to empty
+ * first. A write error on the thread is reported by gp_ferror, and by the
+ * close.
+ *
+ * With GX_ASYNC_FILE_DIRECT, and a seekable stdio target on a platform
+ * with O_DIRECT, the whole blocks of each buffer are written with O_DIRECT
+ * (buffer_size should be a multiple of 4096), to keep very large output
+ * out of the page cache. The flag is ignored where that isn't possible.
+ *
+ * Returns NULL, with the target untouched, if the wrapper can't be
+ * created (for instance in a build without threads). Otherwise the
+ * wrapper owns the target: gp_fclose of the wrapper closes it too.
+ */
+#define GX_ASYNC_FILE_DIRECT 1
+
+gp_file *gx_async_file_wrap(const gs_memory_t *mem, gp_file *target,
+                            int num_buffers, uint buffer_size, int flags);
+
+/*
+ * If file is a wrapper made by gx_async_file_wrap, wait for the writes to
+ * finish, stop the thread, free the wrapper and return the target; *pcode
+ * is set to an error if any write failed, 0 otherwise. Any other file is
+ * returned as it is.
+ */
+gp_file *gx_async_file_unwrap(gp_file *file, int *pcode);
+
+#endif /* gxfasync_INCLUDED */
@@ -0,0 +1,299 @@
+/* Copyright (C) 2001-2021 Artifex Software, Inc.
+   All Rights Reserved.
+
+   This software is provided AS-IS with no warranty, either express or
+   implied.
+
+   This software is distributed under license and may not be copied,
+   modified or distributed except as expressly authorized under the terms
+   of the license contained in the file LICENSE in this distribution.
+
+   Refer to licensing information at http://www.artifex.com or contact
+   Artifex Software, Inc.,  1305 Grant Avenue - Suite 200, Novato,
+   CA 94945, U.S.A., +1(415)492-9861, for further information.
+*/
+
+
+/* Shared memo of computed halftone data */
+#include "memory_.h"
+#include "gx.h"
+#include "gsmemory.h"
+#include "gslibctx.h"
+#include "gxsync.h"
+#include "gxhtmemo.h"
+
+/*
+ * The entries are kept on a doubly linked list in order of use, most
+ * recent first.  There are only ever a handful of screens in use, so a
+ * linear search is quite adequate.  The key material follows the entry
+ * header, and the data follows that.
+ */
+typedef struct gx_ht_memo_entry_s gx_ht_memo_entry_t;
+struct gx_ht_memo_entry_s {
+    gx_ht_memo_entry_t *next;
+    gx_ht_memo_entry_t *prev;
+    gx_ht_memo_kind_t kind;
+    uint64_t hash;
+    size_t key_size, size0, size1;
+};
+
+#define memo_entry_key(pe) ((byte *)((pe) + 1))
+#define memo_entry_data(pe) (memo_entry_key(pe) + (pe)->key_size)
+#define memo_entry_size(pe)\
+  (sizeof(gx_ht_memo_entry_t) + (pe)->key_size + (pe)->size0 + (pe)->size1)
+
+struct gx_ht_memo_s {
+    gs_memory_t *memory;
+    gx_ht_memo_entry_t *head;	/* most recently used */
+    gx_ht_memo_entry_t *tail;	/* least recently used */
+    size_t size;		/* total size of the entries */
+    size_t max_size;
+};
+
+/* ------ Keys ------ */
+
+/* The mixing constants are those of MurmurHash3's 64 bit finalizer. */
+#define MEMO_K1 (((uint64_t)0xff51afd7 << 32) | 0xed558ccd)
+#define MEMO_K2 (((uint64_t)0xc4ceb9fe << 32) | 0x1a85ec53)
+
+static inline uint64_t
+memo_mix(uint64_t h, uint64_t w)
+{
+    h ^= w * MEMO_K1;
+    h = (h << 31) | (h >> 33);
+    return h * MEMO_K2;
+}
+
+void
+gx_ht_memo_key_init(gx_ht_memo_key_t *pkey, gx_ht_memo_kind_t kind,
+                    gs_memory_t *mem)
+{
+    pkey->kind = kind;
+    pkey->hash = memo_mix(0, (uint64_t)kind + 1);
+    pkey->memory = (mem == NULL ? NULL : mem->non_gc_memory);
+    pkey->data = NULL;
+    pkey->size = pkey->alloc_size = 0;
+}
+
+void
+gx_ht_memo_key_add(gx_ht_memo_key_t *pkey, const void *data, size_t size)
+{
+    const byte *p = (const byte *)data;
+    uint64_t h = memo_mix(pkey->hash, (uint64_t)size);
+    uint64_t w;
+
+    if (pkey->memory == NULL)
+        return;
+    if (pkey->size + size > pkey->alloc_size) {
+        size_t new_size = max(pkey->size + size, pkey->alloc_size * 2);
+        byte *new_data = gs_alloc_bytes(pkey->memory, new_size,
+                                        "gx_ht_memo_key_add");
+
+        if (new_data == NULL) {
+            gx_ht_memo_key_release(pkey);
+            return;
+        }
+        if (pkey->size)
+            memcpy(new_data, pkey->data, pkey->size);
+        gs_free_object(pkey->memory, pkey->data, "gx_ht_memo_key_add");
+        pkey->data = new_data;
+        pkey->alloc_size = new_size;
+    }
+    memcpy(pkey->data + pkey->size, data, size);
+    pkey->size += size;
+
+    for (; size >= sizeof(w); p += sizeof(w), size -= sizeof(w)) {
+        memcpy(&w, p, sizeof(w));
+        h = memo_mix(h, w);
+    }
+    if (size) {
+        w = 0;
+        memcpy(&w, p, size);
+        h = memo_mix(h, w);
+    }
+    pkey->hash = h;
+}
+
+void
+gx_ht_memo_key_release(gx_ht_memo_key_t *pkey)
+{
+    if (pkey->memory != NULL)
+        gs_free_object(pkey->memory, pkey->data, "gx_ht_memo_key_release");
+    pkey->memory = NULL;
+    pkey->data = NULL;
+    pkey->size = pkey->alloc_size = 0;
+}
+
+/* ------ Lookup and storage ------ */
+
+static inline gx_ht_memo_t *
+memo_of(const gs_memory_t *mem)
+{
+    return (mem->gs_lib_ctx == NULL ? NULL : mem->gs_lib_ctx->core->ht_memo);
+}
+
+/* Unlink an entry.  The caller holds the monitor. */
+static void
+memo_unlink(gx_ht_memo_t *memo, gx_ht_memo_entry_t *pe)
+{
+    if (pe->prev)
+        pe->prev->next = pe->next;
+    else
+        memo->head = pe->next;
+    if (pe->next)
+        pe->next->prev = pe->prev;
+    else
+        memo->tail = pe->prev;
+}
+
+/* Link an entry at the head of the list.  The caller holds the monitor. */
+static void
+memo_link_first(gx_ht_memo_t *memo, gx_ht_memo_entry_t *pe)
+{
+    pe->prev = NULL;
+    pe->next = memo->head;
+    if (memo->head)
+        memo->head->prev = pe;
+    else
+        memo->tail = pe;
+    memo->head = pe;
+}
+
+static gx_ht_memo_entry_t *
+memo_find(const gx_ht_memo_t *memo, const gx_ht_memo_key_t *pkey)
+{
+    gx_ht_memo_entry_t *pe;
+
+    for (pe = memo->head; pe != NULL; pe = pe->next)
+        if (pe->hash == pkey->hash && pe->kind == pkey->kind &&
+            pe->key_size == pkey->size &&
+            !memcmp(memo_entry_key(pe), pkey->data, pkey->size))
+            return pe;
+    return NULL;
+}
+
+int
+gx_ht_memo_lookup(const gs_memory_t *mem, const gx_ht_memo_key_t *pkey,
+                  void *data0, size_t size0, void *data1, size_t size1)
+{
+    gx_ht_memo_t *memo = memo_of(mem);
+    gx_monitor_t *monitor;
+    gx_ht_memo_entry_t *pe;
+    int found = 0;
+
+    if (memo == NULL || pkey->memory == NULL)
+        return 0;
+    monitor = (gx_monitor_t *)mem->gs_lib_ctx->core->monitor;
+    gx_monitor_enter(monitor);
+    pe = memo_find(memo, pkey);
+    if (pe != NULL && pe->size0 == size0 && pe->size1 == size1) {
+        memcpy(data0, memo_entry_data(pe), size0);
+        if (size1)
+            memcpy(data1, memo_entry_data(pe) + size0, size1);
+        if (pe != memo->head) {
+            memo_unlink(memo, pe);
+            memo_link_first(memo, pe);
+        }
+        found = 1;
+    }
+    gx_monitor_leave(monitor);
+    if_debug3m('h', mem, "[h]memo lookup kind=%d hash=0x%08lx: %s\n",
+               (int)pkey->kind, (ulong)pkey->hash, (found ? "hit" : "miss"));
+    return found;
+}
+
+void
+gx_ht_memo_store(const gs_memory_t *mem, const gx_ht_memo_key_t *pkey,
+                 const void *data0, size_t size0,
+                 const void *data1, size_t size1)
+{
+    gs_lib_ctx_core_t *core;
+    gx_monitor_t *monitor;
+    gx_ht_memo_t *memo;
+    gx_ht_memo_entry_t *pe;
+    size_t size = sizeof(gx_ht_memo_entry_t) + pkey->size + size0 + size1;
+
+    if (mem->gs_lib_ctx == NULL || pkey->memory == NULL)
+        return;
+    core = mem->gs_lib_ctx->core;
+    monitor = (gx_monitor_t *)core->monitor;
+    /* Entries that would crowd out everything else aren't worth keeping. */
+    if (size > max_ht_memo_size / 4)
+        return;
+
+    /* Create the memo itself on first use. */
+    if (core->ht_memo == NULL) {
+        gx_ht_memo_t *new_memo =
+            (gx_ht_memo_t *)gs_alloc_bytes_immovable(core->memory,
+                                                     sizeof(gx_ht_memo_t),
+                                                     "gx_ht_memo_store(memo)");
+
+        if (new_memo == NULL)
+            return;
+        new_memo->memory = core->memory;
+        new_memo->head = new_memo->tail = NULL;
+        new_memo->size = 0;
+        new_memo->max_size = max_ht_memo_size;
+        gx_monitor_enter(monitor);
+        if (core->ht_memo == NULL) {
+            core->ht_memo = new_memo;
+            new_memo = NULL;
+        }
+        gx_monitor_leave(monitor);
+        if (new_memo != NULL)
+            gs_free_object(core->memory, new_memo, "gx_ht_memo_store(memo)");
+    }
+    memo = core->ht_memo;
+
+    pe = (gx_ht_memo_entry_t *)gs_alloc_bytes(memo->memory, size,
+                                              "gx_ht_memo_store(entry)");
+    if (pe == NULL)
+        return;
+    pe->kind = pkey->kind;
+    pe->hash = pkey->hash;
+    pe->key_size = pkey->size;
+    pe->size0 = size0;
+    pe->size1 = size1;
+    memcpy(memo_entry_key(pe), pkey->data, pkey->size);
+    memcpy(memo_entry_data(pe), data0, size0);
+    if (size1)
+        memcpy(memo_entry_data(pe) + size0, data1, size1);
+
+    gx_monitor_enter(monitor);
+    if (memo_find(memo, pkey) != NULL) {
+        /* Another thread got here first. */
+        gx_monitor_leave(monitor);
+        gs_free_object(memo->memory, pe, "gx_ht_memo_store(entry)");
+        return;
+    }
+    memo_link_first(memo, pe);
+    memo->size += size;
+    while (memo->size > memo->max_size) {
+        gx_ht_memo_entry_t *old = memo->tail;
+
+        memo_unlink(memo, old);
+        memo->size -= memo_entry_size(old);
+        gs_free_object(memo->memory, old, "gx_ht_memo_store(evict)");
+    }
+    gx_monitor_leave(monitor);
+    if_debug3m('h', mem, "[h]memo store kind=%d hash=0x%08lx size=%lu\n",
+               (int)pkey->kind, (ulong)pkey->hash, (ulong)size);
+}
+
+void
+gx_ht_memo_free(gs_lib_ctx_core_t *core)
+{
+    gx_ht_memo_t *memo = core->ht_memo;
+    gx_ht_memo_entry_t *pe;
+
+    if (memo == NULL)
+        return;
+    for (pe = memo->head; pe != NULL;) {
+        gx_ht_memo_entry_t *next = pe->next;
+
+        gs_free_object(memo->memory, pe, "gx_ht_memo_free(entry)");
+        pe = next;
+    }
+    gs_free_object(memo->memory, memo, "gx_ht_memo_free(memo)");
+    core->ht_memo = NULL;
+}
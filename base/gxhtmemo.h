@@ -0,0 +1,97 @@
+/* Copyright (C) 2001-2021 Artifex Software, Inc.
+   All Rights Reserved.
+
+   This software is provided AS-IS with no warranty, either express or
+   implied.
+
+   This software is distributed under license and may not be copied,
+   modified or distributed except as expressly authorized under the terms
+   of the license contained in the file LICENSE in this distribution.
+
+   Refer to licensing information at http://www.artifex.com or contact
+   Artifex Software, Inc.,  1305 Grant Avenue - Suite 200, Novato,
+   CA 94945, U.S.A., +1(415)492-9861, for further information.
+*/
+
+
+/* Shared memo of computed halftone data */
+
+#ifndef gxhtmemo_INCLUDED
+#  define gxhtmemo_INCLUDED
+
+#include "stdint_.h"
+#include "gslibctx.h"
+
+/*
+ * Sampling a spot function, sorting a threshold array into an order and
+ * building a threshold array back from an order are all expensive for
+ * large or high resolution screens, and the same screens tend to be set
+ * up again for every page, every job and every rendering thread.  The
+ * memo keeps the results in the library context core, where they are
+ * shared by all the contexts (and hence threads) cloned from it.
+ *
+ * Entries are keyed by everything the result depends on.  The key keeps
+ * a copy of this material as well as a 64 bit hash of it: the hash only
+ * picks out the candidates, and a lookup compares the material itself.
+ * Entries are never modified once stored.  A lookup copies the data out,
+ * so the orders and threshold arrays the callers build are owned and
+ * freed exactly as before.  The total size is bounded; the least
+ * recently used entries are dropped first.
+ */
+
+typedef enum {
+    ht_memo_spot_samples,	/* spot function samples of a strip */
+    ht_memo_threshold_order,	/* levels and bit_data from thresholds */
+    ht_memo_threshold_array	/* threshold array built from an order */
+} gx_ht_memo_kind_t;
+
+typedef struct gx_ht_memo_key_s {
+    gx_ht_memo_kind_t kind;
+    uint64_t hash;
+    gs_memory_t *memory;	/* for data, NULL if the key is unusable */
+    byte *data;			/* the key material */
+    size_t size, alloc_size;
+} gx_ht_memo_key_t;
+
+typedef struct gx_ht_memo_s gx_ht_memo_t;
+
+/* Define the bound on the total size of the memo. */
+#define max_ht_memo_size_LARGE (16*1024*1024)
+#define max_ht_memo_size_SMALL (256*1024)
+
+#if ARCH_SMALL_MEMORY
+#  define max_ht_memo_size max_ht_memo_size_SMALL
+#else
+#  define max_ht_memo_size max_ht_memo_size_LARGE
+#endif
+
+/*
+ * Start a key, and accumulate data into it.  If the key material can't
+ * be allocated, the key is quietly marked unusable: lookups with it fail
+ * and stores do nothing.  Keys must be released when no longer needed.
+ */
+void gx_ht_memo_key_init(gx_ht_memo_key_t *pkey, gx_ht_memo_kind_t kind,
+                         gs_memory_t *mem);
+void gx_ht_memo_key_add(gx_ht_memo_key_t *pkey, const void *data,
+                        size_t size);
+void gx_ht_memo_key_release(gx_ht_memo_key_t *pkey);
+
+/*
+ * Look up an entry, copying its data into one or two buffers whose sizes
+ * must match those it was stored with.  Return 1 if found, 0 if not.
+ */
+int gx_ht_memo_lookup(const gs_memory_t *mem, const gx_ht_memo_key_t *pkey,
+                      void *data0, size_t size0, void *data1, size_t size1);
+
+/*
+ * Store an entry.  This is only an optimization, so failures (including
+ * running out of memory) are silently ignored.
+ */
+void gx_ht_memo_store(const gs_memory_t *mem, const gx_ht_memo_key_t *pkey,
+                      const void *data0, size_t size0,
+                      const void *data1, size_t size1);
+
+/* Free the memo when the library context core goes away. */
+void gx_ht_memo_free(gs_lib_ctx_core_t *core);
+
+#endif /* gxhtmemo_INCLUDED */
@@ -32,6 +32,9 @@
 #include "gxdevmem.h"
 #include "gxcpath.h"
 #include "gximage.h"
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 /* ---------------- Unpacking procedures ---------------- */
 
@@ -48,6 +51,30 @@ sample_unpack_16(byte * bptr, int *pdata_x, const byte * data,
     uint sample;
     int left = dsize - dskip;
 
+#ifdef HAVE_SSE2
+    if (spread == sizeof(frac)) {
+        /*
+         * Compute frac_1 * (sample + 1) >> 16 for 8 samples at a time
+         * as frac_1 * sample + frac_1, propagating the carry out of the
+         * low half by hand, since sample + 1 doesn't fit in 16 bits.
+         */
+        const __m128i f1 = _mm_set1_epi16(frac_1);
+        const __m128i sign = _mm_set1_epi16(-0x8000);
+
+        for (; left >= 16; left -= 16, psrc += 16, bufp += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *)psrc);
+            __m128i lo, hi, sum;
+
+            s = _mm_or_si128(_mm_slli_epi16(s, 8), _mm_srli_epi16(s, 8));
+            hi = _mm_mulhi_epu16(s, f1);
+            lo = _mm_mullo_epi16(s, f1);
+            sum = _mm_add_epi16(lo, f1);
+            hi = _mm_sub_epi16(hi, _mm_cmplt_epi16(_mm_xor_si128(sum, sign),
+                                                   _mm_xor_si128(lo, sign)));
+            _mm_storeu_si128((__m128i *)bufp, hi);
+        }
+    }
+#endif
     while (left >= 2) {
         sample = ((uint) psrc[0] << 8) + psrc[1];
         *bufp = (frac)((frac_1 * (sample + 1)) >> 16);
@@ -72,6 +99,18 @@ sample_unpackicc_16(byte * bptr, int *pdata_x, const byte * data,
     uint sample;
     int left = dsize - dskip;
 
+#ifdef HAVE_SSE2
+    if (spread == sizeof(unsigned short)) {
+        /* Byte swap 8 big-endian samples at a time. */
+        for (; left >= 16; left -= 16, psrc += 16, bufp += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *)psrc);
+
+            _mm_storeu_si128((__m128i *)bufp,
+                             _mm_or_si128(_mm_slli_epi16(s, 8),
+                                          _mm_srli_epi16(s, 8)));
+        }
+    }
+#endif
     while (left >= 2) {
         sample = ((uint) psrc[0] << 8) + psrc[1];
         *bufp = (unsigned short)(sample);
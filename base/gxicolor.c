@@ -440,15 +440,31 @@ decode_row(const gx_image_enum *penum, const byte *psrc, int spp, byte *pdes,
     }
 }
 
+/* Get the scratch buffer used for colour converting rows of the image. It is
+   kept with the enumerator, rather than allocated for every row. */
+static byte *
+image_color_icc_scratch(gx_image_enum *penum, uint size)
+{
+    if (penum->icc_scratch_size < size) {
+        gs_free_object(penum->memory, penum->icc_scratch, "image_color_icc_scratch");
+        penum->icc_scratch_size = 0;
+        penum->icc_scratch = gs_alloc_bytes(penum->memory, size, "image_color_icc_scratch");
+        if (penum->icc_scratch == NULL)
+            return NULL;
+        penum->icc_scratch_size = size;
+    }
+    return penum->icc_scratch;
+}
+
 /* Common code shared amongst the thresholding and non thresholding color image
-   renderers */
+   renderers.  The converted data is left in a buffer that belongs to the
+   enumerator, and is only valid until the next call. */
 static int
 image_color_icc_prep(gx_image_enum *penum_orig, const byte *psrc, uint w,
                      gx_device *dev, int *spp_cm_out, byte **psrc_cm,
-                     byte **psrc_cm_start, byte **bufend, int *pspan, bool planar_out)
+                     byte **bufend, int *pspan, bool planar_out)
 {
     const gx_image_enum *const penum = penum_orig; /* const within proc */
-    const gs_gstate *pgs = penum->pgs;
     bool need_decode = penum->icc_setup.need_decode;
     gsicc_bufferdesc_t input_buff_desc;
     gsicc_bufferdesc_t output_buff_desc;
@@ -458,6 +474,7 @@ image_color_icc_prep(gx_image_enum *penum_orig, const byte *psrc, uint w,
     int num_des_comps;
     int code;
     cmm_dev_profile_t *dev_profile;
+    byte *scratch;
     byte *psrc_decode;
     const byte *planar_src;
     byte *planar_des;
@@ -484,45 +501,46 @@ image_color_icc_prep(gx_image_enum *penum_orig, const byte *psrc, uint w,
         *psrc_cm = (unsigned char *) psrc;
         spp_cm = spp;
         *bufend = *psrc_cm + w;
-        *psrc_cm_start = NULL;
     } else {
         int width = w/spp;
         int span = (width+31)&~31;
+        uint cm_size, decode_size;
+
         spp_cm = num_des_comps;
 
         if (pspan)
             *pspan = span;
         /* Put the buffer on a 32 byte memory alignment for SSE/AVX for every
-         * line. Also extra space for 32 byte overrun. */
-        *psrc_cm_start = gs_alloc_bytes(pgs->memory,  span * spp_cm + 64,
-                                        "image_color_icc_prep");
-        *psrc_cm = *psrc_cm_start + ((32 - (intptr_t)(*psrc_cm_start)) & 31);
+         * line. Also extra space for 32 byte overrun.  The decoded row, if
+         * needed, follows it. */
+        cm_size = span * spp_cm + 64;
+        decode_size = need_decode ? w : 0;
+        scratch = image_color_icc_scratch(penum_orig, cm_size + decode_size);
+        if (scratch == NULL)
+            return_error(gs_error_VMerror);
+        *psrc_cm = scratch + ((32 - (intptr_t)scratch) & 31);
         *bufend = *psrc_cm +  span * spp_cm;
+        psrc_decode = scratch + cm_size;
+        if (need_decode) {
+            /* This is slow but does not happen that often */
+            if (!penum->use_cie_range) {
+                decode_row(penum, psrc, spp, psrc_decode, psrc_decode+w);
+            } else {
+                /* Decode needs to include adjustment for CIE range */
+                decode_row_cie(penum, psrc, spp, psrc_decode,
+                                psrc_decode+w, get_cie_range(penum->pcs));
+            }
+            psrc = psrc_decode;
+        }
         if (penum->icc_link->is_identity) {
             if (!force_planar) {
-                /* decode only. no CM.  This is slow but does not happen that often */
-                decode_row(penum, psrc, spp, *psrc_cm, *bufend);
+                /* decode only. no CM. */
+                memcpy(*psrc_cm, psrc, w);
             } else {
                 /* CM is identity but we may need to do decode and then off
                    to planar. The planar out case is only used when coming from
                    imager_render_color_thresh, which is limited to 8 bit case */
-                if (need_decode) {
-                    /* Need decode and then to planar */
-                    psrc_decode = gs_alloc_bytes(pgs->memory,  w,
-                                                  "image_color_icc_prep");
-                    if (!penum->use_cie_range) {
-                        decode_row(penum, psrc, spp, psrc_decode, psrc_decode+w);
-                    } else {
-                        /* Decode needs to include adjustment for CIE range */
-                        decode_row_cie(penum, psrc, spp, psrc_decode,
-                                        psrc_decode + w, get_cie_range(penum->pcs));
-                    }
-                    planar_src = psrc_decode;
-                } else {
-                    psrc_decode = NULL;
-                    planar_src = psrc;
-                }
-                /* Now to planar */
+                planar_src = psrc;
                 planar_des = *psrc_cm;
                 for (k = 0; k < width; k++) {
                     for (j = 0; j < spp; j++) {
@@ -530,11 +548,6 @@ image_color_icc_prep(gx_image_enum *penum_orig, const byte *psrc, uint w,
                     }
                     planar_des++;
                 }
-                /* Free up decode if we used it */
-                if (psrc_decode != NULL) {
-                    gs_free_object(pgs->memory, (byte *) psrc_decode,
-                                   "image_render_color_icc");
-                }
             }
         } else {
             /* Set up the buffer descriptors. planar out always ends up here */
@@ -550,40 +563,13 @@ image_color_icc_prep(gx_image_enum *penum_orig, const byte *psrc, uint w,
                               false, false, true, span, span,
                               1, width);
             }
-            /* For now, just blast it all through the link. If we had a significant reduction
-               we will want to repack the data first and then do this.  That will be
-               an optimization shortly.  For now just allocate a new output
-               buffer.  We can reuse the old one if the number of channels in the output is
-               less than or equal to the new one.  */
-            if (need_decode) {
-                /* Need decode and CM.  This is slow but does not happen that often */
-                psrc_decode = gs_alloc_bytes(pgs->memory, w,
-                                              "image_color_icc_prep");
-                if (!penum->use_cie_range) {
-                    decode_row(penum, psrc, spp, psrc_decode, psrc_decode+w);
-                } else {
-                    /* Decode needs to include adjustment for CIE range */
-                    decode_row_cie(penum, psrc, spp, psrc_decode,
-                                    psrc_decode+w, get_cie_range(penum->pcs));
-                }
-                code = (penum->icc_link->procs.map_buffer)(dev, penum->icc_link,
-                                                    &input_buff_desc,
-                                                    &output_buff_desc,
-                                                    (void*) psrc_decode,
-                                                    (void*) *psrc_cm);
-                gs_free_object(pgs->memory, psrc_decode, "image_color_icc_prep");
-                if (code < 0)
-                    return code;
-            } else {
-                /* CM only. No decode */
-                code = (penum->icc_link->procs.map_buffer)(dev, penum->icc_link,
-                                                    &input_buff_desc,
-                                                    &output_buff_desc,
-                                                    (void*) psrc,
-                                                    (void*) *psrc_cm);
-                if (code < 0)
-                    return code;
-            }
+            code = (penum->icc_link->procs.map_buffer)(dev, penum->icc_link,
+                                                &input_buff_desc,
+                                                &output_buff_desc,
+                                                (void*) psrc,
+                                                (void*) *psrc_cm);
+            if (code < 0)
+                return code;
         }
     }
     *spp_cm_out = spp_cm;
@@ -598,7 +584,7 @@ image_render_color_ht_cal(gx_image_enum *penum, const byte *buffer, int data_x,
     const byte *psrc = buffer + data_x;
     int code = 0;
     int spp_cm = 0;
-    byte *psrc_cm = NULL, *psrc_cm_start = NULL;
+    byte *psrc_cm = NULL;
     byte *bufend = NULL;
     byte *input[GX_DEVICE_COLOR_MAX_COMPONENTS];    /* to ensure 128 bit boundary */
     int i;
@@ -609,7 +595,7 @@ image_render_color_ht_cal(gx_image_enum *penum, const byte *buffer, int data_x,
 
     /* Get the buffer into the device color space */
     code = image_color_icc_prep(penum, psrc, w, dev, &spp_cm, &psrc_cm,
-                                &psrc_cm_start,  &bufend, &planestride, true);
+                                &bufend, &planestride, true);
     if (code < 0)
         return code;
 
@@ -619,11 +605,6 @@ image_render_color_ht_cal(gx_image_enum *penum, const byte *buffer, int data_x,
     code = cal_halftone_process_planar(penum->cal_ht, penum->memory->non_gc_memory,
                                        (const byte * const *)input, color_halftone_callback, dev);
 
-    /* Free cm buffer, if it was used */
-    if (psrc_cm_start != NULL) {
-        gs_free_object(penum->pgs->memory, (byte *)psrc_cm_start,
-                       "image_render_color_thresh");
-    }
     return code;
 }
 #else
@@ -655,14 +636,14 @@ image_render_color_thresh(gx_image_enum *penum_orig, const byte *buffer, int dat
     int xn, xr;		/* destination position (pixel, not contone buffer offset) */
     int code = 0;
     int spp_cm = 0;
-    byte *psrc_cm = NULL, *psrc_cm_start = NULL;
+    byte *psrc_cm = NULL;
     byte *bufend = NULL;
     int psrc_planestride = w/penum->spp;
 
     if (h != 0 && penum->line_size != 0) {      /* line_size == 0, nothing to do */
         /* Get the buffer into the device color space */
         code = image_color_icc_prep(penum, psrc, w, dev, &spp_cm, &psrc_cm,
-                                    &psrc_cm_start,  &bufend, &psrc_planestride, true);
+                                    &bufend, &psrc_planestride, true);
         if (code < 0)
             return code;
     } else {
@@ -1040,11 +1021,6 @@ flush:
     code = gxht_thresh_planes(penum, xrun, dest_width, dest_height,
                               thresh_align, dev, offset_contone,
                               contone_stride);
-    /* Free cm buffer, if it was used */
-    if (psrc_cm_start != NULL) {
-        gs_free_object(penum->pgs->memory, (byte *)psrc_cm_start,
-                       "image_render_color_thresh");
-    }
     return code;
 }
 #endif
@@ -1067,7 +1043,7 @@ image_render_color_icc_tpr(gx_image_enum *penum_orig, const byte *buffer, int da
     int spp = penum->spp;
     const byte *psrc = buffer + data_x * spp;
     int code;
-    byte *psrc_cm = NULL, *psrc_cm_start = NULL;
+    byte *psrc_cm = NULL;
     byte *psrc_cm_initial;
     byte *bufend = NULL;
     int spp_cm = 0;
@@ -1079,7 +1055,7 @@ image_render_color_icc_tpr(gx_image_enum *penum_orig, const byte *buffer, int da
     if (h == 0)
         return 0;
     code = image_color_icc_prep(penum_orig, psrc, w, dev, &spp_cm, &psrc_cm,
-                                &psrc_cm_start, &bufend, NULL, false);
+                                &bufend, NULL, false);
     if (code < 0) return code;
     psrc_cm_initial = psrc_cm;
     gx_get_cmapper(&cmapper, pgs, dev, has_transfer, must_halftone, gs_color_select_source);
@@ -1089,7 +1065,6 @@ image_render_color_icc_tpr(gx_image_enum *penum_orig, const byte *buffer, int da
     data.u.process_data.data_x = 0;
     data.u.process_data.cmapper = &cmapper;
     code = dev_proc(dev, transform_pixel_region)(dev, transform_pixel_region_process_data, &data);
-    gs_free_object(pgs->memory, (byte *)psrc_cm_start, "image_render_color_icc");
 
     if (code < 0) {
         /* Save position if error, in case we resume. */
@@ -1099,6 +1074,83 @@ image_render_color_icc_tpr(gx_image_enum *penum_orig, const byte *buffer, int da
     return code;
 }
 
+/* Put the pixels of a row that image_render_color_DeviceN will map (each
+   one that differs from the pixel before it) through the ICC link in one
+   call, rather than one at a time.  The values go through the link as 16
+   bits, as gx_remap_ICC_with_link does for a single color.  *prow_cm is
+   left NULL if the row should be mapped pixel by pixel. */
+static int
+image_color_DeviceN_row(gx_image_enum *penum, const byte *psrc, uint w,
+                        gx_device *dev, unsigned short **prow_cm,
+                        cmm_dev_profile_t **pdev_profile)
+{
+    const gs_gstate *pgs = penum->pgs;
+    const gs_color_space *pcs = penum->pcs;
+    int spp = penum->spp;
+    const byte *bufend = psrc + w;
+    const byte *prev = NULL;
+    bool skewed = penum->posture == image_skewed;
+    uint width = w / spp;
+    gsicc_link_t *icc_link = penum->icc_link;
+    gsicc_rendering_param_t rendering_params;
+    gsicc_bufferdesc_t input_buff_desc;
+    gsicc_bufferdesc_t output_buff_desc;
+    gs_client_color cc;
+    unsigned short *row, *p;
+    int num_des_comps, num = 0;
+    int i, code;
+
+    *prow_cm = NULL;
+    code = dev_proc(dev, get_profile)(dev, pdev_profile);
+    if (code < 0)
+        return code;
+    if (*pdev_profile == NULL)
+        return 0;
+    if (icc_link == NULL) {
+        /* Same link as gx_remap_ICC would use */
+        rendering_params.black_point_comp = pgs->blackptcomp;
+        rendering_params.graphics_type_tag = dev->graphics_type_tag;
+        rendering_params.override_icc = false;
+        rendering_params.preserve_black = gsBKPRESNOTSPECIFIED;
+        rendering_params.rendering_intent = pgs->renderingintent;
+        rendering_params.cmm = gsCMM_DEFAULT;
+        icc_link = gsicc_get_link(pgs, dev, pcs, NULL, &rendering_params, pgs->memory);
+        if (icc_link == NULL)
+            return_error(gs_error_unknownerror);
+    }
+    if (icc_link->is_identity)
+        goto done;
+    num_des_comps = gsicc_get_device_profile_comps(*pdev_profile);
+    row = (unsigned short *)image_color_icc_scratch(penum,
+                    width * (spp + num_des_comps) * sizeof(unsigned short));
+    if (row == NULL) {
+        code = gs_note_error(gs_error_VMerror);
+        goto done;
+    }
+    for (p = row; psrc < bufend; psrc += spp) {
+        if (!skewed && prev != NULL && !memcmp(psrc, prev, spp))
+            continue;
+        for (i = 0; i < spp; i++) {
+            decode_sample(psrc[i], cc, i);
+            *p++ = (unsigned short)(cc.paint.values[i] * 65535.0);
+        }
+        prev = psrc;
+        num++;
+    }
+    gsicc_init_buffer(&input_buff_desc, spp, 2, false, false, false, 0,
+                      num * spp * 2, 1, num);
+    gsicc_init_buffer(&output_buff_desc, num_des_comps, 2, false, false, false, 0,
+                      num * num_des_comps * 2, 1, num);
+    code = (icc_link->procs.map_buffer)(dev, icc_link, &input_buff_desc,
+                                        &output_buff_desc, row, row + width * spp);
+    if (code >= 0)
+        *prow_cm = row + width * spp;
+done:
+    if (icc_link != penum->icc_link)
+        gsicc_release_link(icc_link);
+    return code;
+}
+
 /* Render a color image for deviceN source color with no ICC profile.  This
    is also used if the image has any masking (type4 image) since we will not
    be blasting through quickly */
@@ -1137,6 +1189,10 @@ image_render_color_DeviceN(gx_image_enum *penum_orig, const byte *buffer, int da
     bits32 mask = penum->mask_color.mask;
     bits32 test = penum->mask_color.test;
     bool lab_case = false;
+    unsigned short *row_cm = NULL;     /* Device values of the pixels to map */
+    const unsigned short *next_cm = NULL;
+    cmm_dev_profile_t *dev_profile = NULL;
+    int num_des_comps = 0;
 
     if (device_encodes_tags(dev)) {
         devc1.tag = (dev->graphics_type_tag & ~GS_DEVICE_ENCODES_TAGS);
@@ -1158,6 +1214,17 @@ image_render_color_DeviceN(gx_image_enum *penum_orig, const byte *buffer, int da
     } else {
         remap_color = pcs->type->remap_color;
     }
+    /* Color convert the row up front, if we would be going through an ICC
+       link pixel by pixel */
+    if (!lab_case && pcs->cmm_icc_profile_data != NULL &&
+        pcs->cmm_icc_profile_data->data_cs != gsCIELAB &&
+        (penum->icc_link != NULL || pcs->type == &gs_color_space_type_ICC)) {
+        code = image_color_DeviceN_row(penum_orig, psrc, w, dev, &row_cm, &dev_profile);
+        if (code < 0)
+            return code;
+        if (row_cm != NULL)
+            num_des_comps = gsicc_get_device_profile_comps(dev_profile);
+    }
     pdevc = &devc1;
     pdevc_next = &devc2;
     /* In case these are devn colors */
@@ -1201,6 +1268,10 @@ image_render_color_DeviceN(gx_image_enum *penum_orig, const byte *buffer, int da
         }
         memcpy(next.v, psrc, spp);
         psrc += spp;
+        if (row_cm != NULL) {
+            next_cm = row_cm;
+            row_cm += num_des_comps;
+        }
     /* Check for transparent color. */
         if ((next.all[0] & mask) == test &&
             (penum->mask_color.exact ||
@@ -1224,7 +1295,10 @@ image_render_color_DeviceN(gx_image_enum *penum_orig, const byte *buffer, int da
             dmputs(dev->memory, "\n");
         }
 #endif
-        if (lab_case || penum->icc_link == NULL || pcs->cmm_icc_profile_data == NULL)
+        if (next_cm != NULL)
+            mcode = gx_remap_ICC_linked(&cc, pcs, pdevc_next, pgs, dev,
+                                        gs_color_select_source, dev_profile, next_cm);
+        else if (lab_case || penum->icc_link == NULL || pcs->cmm_icc_profile_data == NULL)
             mcode = remap_color(&cc, pcs, pdevc_next, pgs, dev, gs_color_select_source);
         else
             mcode = gx_remap_ICC_with_link(&cc, pcs, pdevc_next, pgs, dev,
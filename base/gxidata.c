@@ -518,6 +518,9 @@ gx_image1_end_image(gx_image_enum_common_t * info, bool draw_last)
     if (penum->ht_buffer != NULL) {
         gs_free_object(mem, penum->ht_buffer, "image ht_buffer");
     }
+    if (penum->icc_scratch != NULL) {
+        gs_free_object(mem, penum->icc_scratch, "image icc_scratch");
+    }
     if (penum->clues != NULL) {
         gs_free_object(mem,penum->clues, "image clues");
     }
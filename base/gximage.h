@@ -289,6 +289,8 @@ struct gx_image_enum_s {
     int ht_plane_height;    /* Needed during the copy_planes operation */
     byte *thresh_buffer;    /* A buffer to hold threshold values for HT */
     int thresh_stride;
+    byte *icc_scratch;      /* A buffer for colour converting rows */
+    uint icc_scratch_size;
     gs_image_parent_t image_parent_type;   /* Need to avoid threshold of type3 images */
     ht_landscape_info_t ht_landscape;
     gx_image_icc_setup_t icc_setup;
@@ -305,8 +307,8 @@ struct gx_image_enum_s {
   m(0,pgs) m(1,pcs) m(2,dev) m(3,buffer) m(4,line)\
   m(5,clip_dev) m(6,rop_dev) m(7,scaler) m(8,icc_link)\
   m(9,color_cache) m(10,ht_buffer) m(11,thresh_buffer) \
-  m(12,clues)
-#define gx_image_enum_num_ptrs 13
+  m(12,clues) m(13,icc_scratch)
+#define gx_image_enum_num_ptrs 14
 #define private_st_gx_image_enum() /* in gsimage.c */\
   gs_private_st_composite(st_gx_image_enum, gx_image_enum, "gx_image_enum",\
     image_enum_enum_ptrs, image_enum_reloc_ptrs)
@@ -19,6 +19,9 @@
 #include "gxsample.h"
 #include "gxfixed.h"
 #include "gximage.h"
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
 /* #include "gxsamplp.h" Do not remove - this file is included below. */
 
 /* ---------------- Lookup tables ---------------- */
@@ -78,6 +78,32 @@ TEMPLATE_sample_unpack_1(byte * bptr, int *pdata_x, const byte * data, int data_
             psrc++, bufp += 2;
         }
         left >>= 1;
+#if defined(HAVE_SSE2) && !MULTIPLE_MAPS
+        {
+            /*
+             * The map only ever produces two byte values, so expand 16
+             * samples at a time by testing each bit and selecting.
+             */
+            const __m128i bit = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                             1, 2, 4, 8, 16, 32, 64, -128);
+            const byte v0 = ((const byte *)map)[0];
+            const byte v1 = ((const byte *)(map + 15))[0];
+            const __m128i zero_val = _mm_set1_epi8((char)v0);
+            const __m128i diff = _mm_set1_epi8((char)(v0 ^ v1));
+            __m128i x;
+
+            for (; left > 0; left--) {
+                x = _mm_cvtsi32_si128(psrc[0] | (psrc[1] << 8));
+                x = _mm_unpacklo_epi8(x, x);
+                x = _mm_unpacklo_epi16(x, x);
+                x = _mm_unpacklo_epi32(x, x);
+                x = _mm_cmpeq_epi8(_mm_and_si128(x, bit), bit);
+                _mm_storeu_si128((__m128i *)bufp,
+                                 _mm_xor_si128(zero_val, _mm_and_si128(x, diff)));
+                psrc += 2, bufp += 4;
+            }
+        }
+#endif
         while (left--) {
             b = psrc[0];
             bufp[0] = map[b >> 4];
@@ -35,6 +35,7 @@
 #include "gxscanc.h"
 #include "gxfill.h"
 #include "gxdcolor.h"
+#include "gpsync.h"
 #include "assert_.h"
 #include <stdlib.h>             /* for qsort */
 #include <limits.h>             /* For INT_MAX */
@@ -148,6 +149,108 @@ enum
     DIRN_DOWN = 1
 };
 
+/* Parallel scan conversion.
+ *
+ * Once the index has been built, each scanline of the table is only ever
+ * written by the marking of edges that cross it, and only ever read by
+ * the sort of that scanline. We can therefore split the scanlines into
+ * disjoint ranges and give each range to a different thread. Each thread
+ * walks the whole path, but only marks (and then sorts) the scanlines in
+ * its own range. Edges are stepped identically regardless of the range
+ * being marked, and each scanline is sorted into a total order, so the
+ * output is identical to that of the serial code.
+ *
+ * Filling stays on the calling thread, as devices are not reentrant.
+ *
+ * Tables with fewer than SCANC_PARALLEL_THRESHOLD entries are not worth
+ * the cost of starting threads for. Set SCANC_MAX_THREADS to 1 to
+ * disable this entirely.
+ */
+#ifndef SCANC_MAX_THREADS
+#define SCANC_MAX_THREADS 4
+#endif
+
+#ifndef SCANC_PARALLEL_THRESHOLD
+#define SCANC_PARALLEL_THRESHOLD (1<<16)
+#endif
+
+/* Minimum number of scanlines worth giving to a thread */
+#define SCANC_MIN_ROWS_PER_THREAD 16
+
+typedef void (scanc_rows_fn)(void *arg, int lo, int hi);
+
+typedef struct {
+    scanc_rows_fn *fn;
+    void          *arg;
+    int            lo;
+    int            hi;
+} scanc_rows_job;
+
+static void
+scanc_rows_thread(void *arg)
+{
+    scanc_rows_job *job = (scanc_rows_job *)arg;
+
+    job->fn(job->arg, job->lo, job->hi);
+}
+
+/* Call fn for ranges of scanlines that together cover [0, scanlines),
+ * possibly in parallel. index is the table index as returned by
+ * make_table_template; it is used to balance the ranges by the number
+ * of table entries they contain rather than by height. */
+static void
+scanc_run_rows(int scanlines, const int *index, scanc_rows_fn *fn, void *arg)
+{
+    scanc_rows_job job[SCANC_MAX_THREADS];
+    gp_thread_id   thread[SCANC_MAX_THREADS];
+    int64_t        total, share;
+    int            nthreads, i, y;
+
+    total = scanlines > 0 ? index[scanlines-1] : 0;
+    nthreads = SCANC_MAX_THREADS;
+    if (nthreads > scanlines / SCANC_MIN_ROWS_PER_THREAD)
+        nthreads = scanlines / SCANC_MIN_ROWS_PER_THREAD;
+    if (nthreads <= 1 || total < SCANC_PARALLEL_THRESHOLD) {
+        fn(arg, 0, scanlines);
+        return;
+    }
+
+    /* Split at the scanlines where the running table offset passes
+     * each successive share of the total. */
+    share = total / nthreads;
+    y = 0;
+    for (i = 0; i < nthreads; i++) {
+        job[i].fn  = fn;
+        job[i].arg = arg;
+        job[i].lo  = y;
+        if (i == nthreads-1)
+            y = scanlines;
+        else {
+            while (y < scanlines && index[y] < share * (i+1))
+                y++;
+        }
+        job[i].hi  = y;
+    }
+
+    /* Threads take all but the first range; we do that one ourselves.
+     * If we can't start a thread (e.g. in a build without threads)
+     * just run its range here. */
+    for (i = 1; i < nthreads; i++) {
+        thread[i] = NULL;
+        if (job[i].lo == job[i].hi)
+            continue;
+        if (gp_thread_start(scanc_rows_thread, &job[i], &thread[i]) < 0) {
+            thread[i] = NULL;
+            scanc_rows_thread(&job[i]);
+        }
+    }
+    scanc_rows_thread(&job[0]);
+    for (i = 1; i < nthreads; i++) {
+        if (thread[i] != NULL)
+            gp_thread_finish(thread[i]);
+    }
+}
+
 /* Centre of a pixel routines */
 
 static int intcmp(const void *a, const void *b)
@@ -316,10 +419,16 @@ zero_case(gx_device      * gs_restrict pdev,
     return 0;
 }
 
-static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int height, int *table, int *index)
+/* Mark the scanline intersections of a line into table. Only scanlines
+ * lo <= y < hi (relative to base_y) are written; this allows several
+ * threads to mark disjoint ranges of the same table (see
+ * scanc_run_rows). The line is always stepped exactly as if the whole
+ * of 0 <= y < height was being marked, so the values written do not
+ * depend on the window. */
+static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int height, int lo, int hi, int *table, int *index)
 {
     int64_t delta;
-    int iy, ih;
+    int iy, ih, skip, last;
     fixed clip_sy, clip_ey;
     int dirn = DIRN_UP;
     int *row;
@@ -386,10 +495,20 @@ static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int he
         dlprintf2("    iy=%x ih=%x\n", iy, ih);
 #endif
     assert(iy >= 0 && iy < height);
-    /* We always cross at least one scanline */
-    row = &table[index[iy]];
-    *row = (*row)+1; /* Increment the count */
-    row[*row] = (sx&~1) | dirn;
+    /* Restrict to the window we are marking. */
+    if (iy + ih < lo || iy >= hi)
+        return;
+    skip = lo - iy;
+    last = iy + ih;
+    if (last >= hi)
+        last = hi - 1;
+    if (skip <= 0) {
+        /* We always cross at least one scanline */
+        row = &table[index[iy]];
+        *row = (*row)+1; /* Increment the count */
+        row[*row] = (sx&~1) | dirn;
+        skip = 0;
+    }
     if (ih == 0)
         return;
     if (ex >= 0) {
@@ -401,8 +520,20 @@ static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int he
         x_inc = ex/ih;
         n_inc = ex-(x_inc*ih);
         f     = ih>>1;
-        delta = ih;
-        do {
+        if (skip > 0) {
+            /* Jump straight to the first scanline in the window, landing
+             * on exactly the values the loop below would have produced. */
+            int64_t carry = (int64_t)skip * n_inc - f;
+            carry = carry <= 0 ? 0 : (carry + ih - 1) / ih;
+            sx += skip * x_inc + (int)carry;
+            f   = (int)(f - (int64_t)skip * n_inc + carry * ih);
+            iy += skip;
+            row = &table[index[iy]];
+            *row = (*row)+1; /* Increment the count */
+            row[*row] = (sx&~1) | dirn;
+        }
+        delta = last - iy;
+        while (delta-- > 0) {
             int count;
             iy++;
             sx += x_inc;
@@ -415,7 +546,7 @@ static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int he
             row = &table[index[iy]];
             count = *row = (*row)+1; /* Increment the count */
             row[count] = (sx&~1) | dirn;
-        } while (--delta);
+        }
     } else {
         int x_dec, n_dec, f;
 
@@ -426,8 +557,18 @@ static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int he
         x_dec = ex/ih;
         n_dec = ex-(x_dec*ih);
         f     = ih>>1;
-        delta = ih;
-        do {
+        if (skip > 0) {
+            int64_t carry = (int64_t)skip * n_dec - f;
+            carry = carry <= 0 ? 0 : (carry + ih - 1) / ih;
+            sx -= skip * x_dec + (int)carry;
+            f   = (int)(f - (int64_t)skip * n_dec + carry * ih);
+            iy += skip;
+            row = &table[index[iy]];
+            *row = (*row)+1; /* Increment the count */
+            row[*row] = (sx&~1) | dirn;
+        }
+        delta = last - iy;
+        while (delta-- > 0) {
             int count;
             iy++;
             sx -= x_dec;
@@ -440,11 +581,11 @@ static void mark_line(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int he
             row = &table[index[iy]];
             count = *row = (*row)+1; /* Increment the count */
             row[count] = (sx&~1) | dirn;
-        } while (--delta);
+        }
     }
 }
 
-static void mark_curve(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int *table, int *index, int depth)
+static void mark_curve(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int lo, int hi, int *table, int *index, int depth)
 {
     fixed ax = (sx + c1x)>>1;
     fixed ay = (sy + c1y)>>1;
@@ -461,15 +602,15 @@ static void mark_curve(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixe
 
     assert(depth >= 0);
     if (depth == 0)
-        mark_line(sx, sy, ex, ey, base_y, height, table, index);
+        mark_line(sx, sy, ex, ey, base_y, height, lo, hi, table, index);
     else {
         depth--;
-        mark_curve(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, table, index, depth);
-        mark_curve(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, table, index, depth);
+        mark_curve(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, lo, hi, table, index, depth);
+        mark_curve(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, lo, hi, table, index, depth);
     }
 }
 
-static void mark_curve_big(fixed64 sx, fixed64 sy, fixed64 c1x, fixed64 c1y, fixed64 c2x, fixed64 c2y, fixed64 ex, fixed64 ey, fixed base_y, fixed height, int *table, int *index, int depth)
+static void mark_curve_big(fixed64 sx, fixed64 sy, fixed64 c1x, fixed64 c1y, fixed64 c2x, fixed64 c2y, fixed64 ex, fixed64 ey, fixed base_y, fixed height, int lo, int hi, int *table, int *index, int depth)
 {
     fixed64 ax = (sx + c1x)>>1;
     fixed64 ay = (sy + c1y)>>1;
@@ -486,22 +627,22 @@ static void mark_curve_big(fixed64 sx, fixed64 sy, fixed64 c1x, fixed64 c1y, fix
 
     assert(depth >= 0);
     if (depth == 0)
-        mark_line((fixed)sx, (fixed)sy, (fixed)ex, (fixed)ey, base_y, height, table, index);
+        mark_line((fixed)sx, (fixed)sy, (fixed)ex, (fixed)ey, base_y, height, lo, hi, table, index);
     else {
         depth--;
-        mark_curve_big(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, table, index, depth);
-        mark_curve_big(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, table, index, depth);
+        mark_curve_big(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, lo, hi, table, index, depth);
+        mark_curve_big(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, lo, hi, table, index, depth);
     }
 }
 
-static void mark_curve_top(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int *table, int *index, int depth)
+static void mark_curve_top(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int lo, int hi, int *table, int *index, int depth)
 {
     fixed test = (sx^(sx<<1))|(sy^(sy<<1))|(c1x^(c1x<<1))|(c1y^(c1y<<1))|(c2x^(c2x<<1))|(c2y^(c2y<<1))|(ex^(ex<<1))|(ey^(ey<<1));
 
     if (test < 0)
-        mark_curve_big(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, table, index, depth);
+        mark_curve_big(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, lo, hi, table, index, depth);
     else
-        mark_curve(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, table, index, depth);
+        mark_curve(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, lo, hi, table, index, depth);
 }
 
 static int make_bbox(gx_path       * path,
@@ -854,50 +995,59 @@ fill_zero(int *row, const fixed *x)
     row[n  ] = (x[1]|1);
 }
 
-int gx_scan_convert(gx_device     * gs_restrict pdev,
-                    gx_path       * gs_restrict path,
-              const gs_fixed_rect * gs_restrict clip,
-                    gx_edgebuffer * gs_restrict edgebuffer,
-                    fixed                       fixed_flat)
-{
-    gs_fixed_rect  ibox;
-    gs_fixed_rect  bbox;
-    int            scanlines;
-    const subpath *psub;
-    int           *index;
-    int           *table;
-    int            i;
-    int            code;
-    int            zero;
-
-    edgebuffer->index = NULL;
-    edgebuffer->table = NULL;
+typedef struct {
+    gx_path *path;
+    fixed    fixed_flat;
+    int      base_y;
+    int      scanlines;
+    int     *index;
+    int     *table;
+} scan_convert_rows_arg;
 
-    /* Bale out if no actual path. We see this with the clist */
-    if (path->first_subpath == NULL)
-        return 0;
-
-    zero = make_bbox(path, clip, &bbox, &ibox, fixed_half);
-    if (zero < 0)
-        return zero;
-
-    if (ibox.q.y <= ibox.p.y)
-        return 0;
+/* Step 3: Sort the intersects on x, for scanlines lo <= y < hi. */
+static void
+sort_rows(void *arg_, int lo, int hi)
+{
+    scan_convert_rows_arg *arg = (scan_convert_rows_arg *)arg_;
+    int *table = arg->table;
+    int *index = arg->index;
+    int  i;
 
-    code = make_table(pdev, path, &ibox, &scanlines, &index, &table);
-    if (code != 0) /* >0 means "retry with smaller height" */
-        return code;
+    for (i=lo; i < hi; i++) {
+        int *row = &table[index[i]];
+        int  rowlen = *row++;
 
-    if (scanlines == 0)
-        return 0;
+        /* Bubblesort short runs, qsort longer ones. */
+        /* FIXME: Check "6" below */
+        if (rowlen <= 6) {
+            int j, k;
+            for (j = 0; j < rowlen-1; j++) {
+                int t = row[j];
+                for (k = j+1; k < rowlen; k++) {
+                    int s = row[k];
+                    if (t > s)
+                         row[k] = t, t = row[j] = s;
+                }
+            }
+        } else
+            qsort(row, rowlen, sizeof(int), intcmp);
+    }
+}
 
-    if (zero) {
-        code = zero_case(pdev, path, &ibox, index, table, fixed_flat, fill_zero);
-    } else {
+/* Steps 2 and 3 for scanlines lo <= y < hi. */
+static void
+scan_convert_rows(void *arg_, int lo, int hi)
+{
+    scan_convert_rows_arg *arg = (scan_convert_rows_arg *)arg_;
+    const subpath *psub;
+    int            base_y    = arg->base_y;
+    int            scanlines = arg->scanlines;
+    int           *index     = arg->index;
+    int           *table     = arg->table;
 
     /* Step 2 continued: Now we run through the path, filling in the real
      * values. */
-    for (psub = path->first_subpath; psub != 0;) {
+    for (psub = arg->path->first_subpath; psub != 0;) {
         const segment *pseg = (const segment *)psub;
         fixed ex = pseg->pt.x;
         fixed ey = pseg->pt.y;
@@ -920,25 +1070,76 @@ int gx_scan_convert(gx_device     * gs_restrict pdev,
                     break;
                 case s_curve: {
                     const curve_segment *const pcur = (const curve_segment *)pseg;
-                    int k = gx_curve_log2_samples(sx, sy, pcur, fixed_flat);
+                    int k = gx_curve_log2_samples(sx, sy, pcur, arg->fixed_flat);
 
-                    mark_curve_top(sx, sy, pcur->p1.x, pcur->p1.y, pcur->p2.x, pcur->p2.y, ex, ey, ibox.p.y, scanlines, table, index, k);
+                    mark_curve_top(sx, sy, pcur->p1.x, pcur->p1.y, pcur->p2.x, pcur->p2.y, ex, ey, base_y, scanlines, lo, hi, table, index, k);
                     break;
                 }
                 case s_gap:
                 case s_line:
                 case s_line_close:
                     if (sy != ey)
-                        mark_line(sx, sy, ex, ey, ibox.p.y, scanlines, table, index);
+                        mark_line(sx, sy, ex, ey, base_y, scanlines, lo, hi, table, index);
                     break;
             }
         }
         /* And close any open segments */
         if (iy != ey)
-            mark_line(ex, ey, ix, iy, ibox.p.y, scanlines, table, index);
+            mark_line(ex, ey, ix, iy, base_y, scanlines, lo, hi, table, index);
         psub = (const subpath *)pseg;
     }
-    }
+
+    sort_rows(arg, lo, hi);
+}
+
+int gx_scan_convert(gx_device     * gs_restrict pdev,
+                    gx_path       * gs_restrict path,
+              const gs_fixed_rect * gs_restrict clip,
+                    gx_edgebuffer * gs_restrict edgebuffer,
+                    fixed                       fixed_flat)
+{
+    gs_fixed_rect  ibox;
+    gs_fixed_rect  bbox;
+    int            scanlines;
+    int           *index;
+    int           *table;
+    int            code;
+    int            zero;
+    scan_convert_rows_arg arg;
+
+    edgebuffer->index = NULL;
+    edgebuffer->table = NULL;
+
+    /* Bale out if no actual path. We see this with the clist */
+    if (path->first_subpath == NULL)
+        return 0;
+
+    zero = make_bbox(path, clip, &bbox, &ibox, fixed_half);
+    if (zero < 0)
+        return zero;
+
+    if (ibox.q.y <= ibox.p.y)
+        return 0;
+
+    code = make_table(pdev, path, &ibox, &scanlines, &index, &table);
+    if (code != 0) /* >0 means "retry with smaller height" */
+        return code;
+
+    if (scanlines == 0)
+        return 0;
+
+    arg.path       = path;
+    arg.fixed_flat = fixed_flat;
+    arg.base_y     = ibox.p.y;
+    arg.scanlines  = scanlines;
+    arg.index      = index;
+    arg.table      = table;
+
+    if (zero) {
+        code = zero_case(pdev, path, &ibox, index, table, fixed_flat, fill_zero);
+        sort_rows(&arg, 0, scanlines);
+    } else
+        scanc_run_rows(scanlines, index, scan_convert_rows, &arg);
 
     /* Step 2 complete: We now have a complete list of intersection data in
      * table, indexed by index. */
@@ -952,32 +1153,11 @@ int gx_scan_convert(gx_device     * gs_restrict pdev,
 
 #ifdef DEBUG_SCAN_CONVERTER
     if (debugging_scan_converter) {
-        dlprintf("Before sorting:\n");
+        dlprintf("After sorting:\n");
         gx_edgebuffer_print(edgebuffer);
     }
 #endif
 
-    /* Step 3: Sort the intersects on x */
-    for (i=0; i < scanlines; i++) {
-        int *row = &table[index[i]];
-        int  rowlen = *row++;
-
-        /* Bubblesort short runs, qsort longer ones. */
-        /* FIXME: Check "6" below */
-        if (rowlen <= 6) {
-            int j, k;
-            for (j = 0; j < rowlen-1; j++) {
-                int t = row[j];
-                for (k = j+1; k < rowlen; k++) {
-                    int s = row[k];
-                    if (t > s)
-                         row[k] = t, t = row[j] = s;
-                }
-            }
-        } else
-            qsort(row, rowlen, sizeof(int), intcmp);
-    }
-
     return 0;
 }
 
@@ -2064,6 +2244,46 @@ fill_zero_app(int *row, const fixed *x)
     row[2*n  ] = x[1];
 }
 
+/* Step 3: Sort the intersects on x, for scanlines lo <= y < hi. */
+static void
+sort_rows_app(void *arg_, int lo, int hi)
+{
+    scan_convert_rows_arg *arg = (scan_convert_rows_arg *)arg_;
+    int *table = arg->table;
+    int *index = arg->index;
+    int  i;
+
+    for (i=lo; i < hi; i++) {
+        int *row = &table[index[i]];
+        int  rowlen = *row++;
+
+        /* Bubblesort short runs, qsort longer ones. */
+        /* FIXME: Verify the figure 6 below */
+        if (rowlen <= 6) {
+            int j, k;
+            for (j = 0; j < rowlen-1; j++) {
+                int * gs_restrict t = &row[j<<1];
+                for (k = j+1; k < rowlen; k++) {
+                    int * gs_restrict s = &row[k<<1];
+                    int tmp;
+                    if (t[0] < s[0])
+                        continue;
+                    if (t[0] > s[0])
+                        goto swap01;
+                    if (t[1] <= s[1])
+                        continue;
+                    if (0) {
+swap01:
+                        tmp = t[0], t[0] = s[0], s[0] = tmp;
+                    }
+                    tmp = t[1], t[1] = s[1], s[1] = tmp;
+                }
+            }
+        } else
+            qsort(row, rowlen, 2*sizeof(int), edgecmp);
+    }
+}
+
 int gx_scan_convert_app(gx_device     * gs_restrict pdev,
                         gx_path       * gs_restrict path,
                   const gs_fixed_rect * gs_restrict clip,
@@ -2076,7 +2296,7 @@ int gx_scan_convert_app(gx_device     * gs_restrict pdev,
     const subpath *psub;
     int           *index;
     int           *table;
-    int            i;
+    scan_convert_rows_arg arg;
     cursor         cr;
     int            code;
     int            zero;
@@ -2183,36 +2403,11 @@ int gx_scan_convert_app(gx_device     * gs_restrict pdev,
     }
 #endif
 
-    /* Step 3: Sort the intersects on x */
-    for (i=0; i < scanlines; i++) {
-        int *row = &table[index[i]];
-        int  rowlen = *row++;
-
-        /* Bubblesort short runs, qsort longer ones. */
-        /* FIXME: Verify the figure 6 below */
-        if (rowlen <= 6) {
-            int j, k;
-            for (j = 0; j < rowlen-1; j++) {
-                int * gs_restrict t = &row[j<<1];
-                for (k = j+1; k < rowlen; k++) {
-                    int * gs_restrict s = &row[k<<1];
-                    int tmp;
-                    if (t[0] < s[0])
-                        continue;
-                    if (t[0] > s[0])
-                        goto swap01;
-                    if (t[1] <= s[1])
-                        continue;
-                    if (0) {
-swap01:
-                        tmp = t[0], t[0] = s[0], s[0] = tmp;
-                    }
-                    tmp = t[1], t[1] = s[1], s[1] = tmp;
-                }
-            }
-        } else
-            qsort(row, rowlen, 2*sizeof(int), edgecmp);
-    }
+    /* Step 3: Sort the intersects on x. The marking above has to be
+     * done in order, but the rows can be sorted in parallel. */
+    arg.index = index;
+    arg.table = table;
+    scanc_run_rows(scanlines, index, sort_rows_app, &arg);
 
     return 0;
 }
@@ -2376,10 +2571,11 @@ gx_edgebuffer_print_tr(gx_edgebuffer * edgebuffer)
 }
 #endif
 
-static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int height, int *table, int *index, int id)
+/* As mark_line, but recording the line id too. */
+static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int height, int lo, int hi, int *table, int *index, int id)
 {
     int64_t delta;
-    int iy, ih;
+    int iy, ih, skip, last;
     fixed clip_sy, clip_ey;
     int dirn = DIRN_UP;
     int *row;
@@ -2446,12 +2642,22 @@ static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int
         dlprintf2("    iy=%x ih=%x\n", iy, ih);
 #endif
     assert(iy >= 0 && iy < height);
+    /* Restrict to the window we are marking. */
+    if (iy + ih < lo || iy >= hi)
+        return;
+    skip = lo - iy;
+    last = iy + ih;
+    if (last >= hi)
+        last = hi - 1;
     id = (id<<1) | dirn;
-    /* We always cross at least one scanline */
-    row = &table[index[iy]];
-    *row = (*row)+1; /* Increment the count */
-    row[*row * 2 - 1] = sx;
-    row[*row * 2    ] = id;
+    if (skip <= 0) {
+        /* We always cross at least one scanline */
+        row = &table[index[iy]];
+        *row = (*row)+1; /* Increment the count */
+        row[*row * 2 - 1] = sx;
+        row[*row * 2    ] = id;
+        skip = 0;
+    }
     if (ih == 0)
         return;
     if (ex >= 0) {
@@ -2463,8 +2669,19 @@ static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int
         x_inc = ex/ih;
         n_inc = ex-(x_inc*ih);
         f     = ih>>1;
-        delta = ih;
-        do {
+        if (skip > 0) {
+            int64_t carry = (int64_t)skip * n_inc - f;
+            carry = carry <= 0 ? 0 : (carry + ih - 1) / ih;
+            sx += skip * x_inc + (int)carry;
+            f   = (int)(f - (int64_t)skip * n_inc + carry * ih);
+            iy += skip;
+            row = &table[index[iy]];
+            *row = (*row)+1; /* Increment the count */
+            row[*row * 2 - 1] = sx;
+            row[*row * 2    ] = id;
+        }
+        delta = last - iy;
+        while (delta-- > 0) {
             int count;
             iy++;
             sx += x_inc;
@@ -2479,7 +2696,6 @@ static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int
             row[count * 2 - 1] = sx;
             row[count * 2    ] = id;
         }
-        while (--delta);
     } else {
         int x_dec, n_dec, f;
 
@@ -2490,8 +2706,19 @@ static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int
         x_dec = ex/ih;
         n_dec = ex-(x_dec*ih);
         f     = ih>>1;
-        delta = ih;
-        do {
+        if (skip > 0) {
+            int64_t carry = (int64_t)skip * n_dec - f;
+            carry = carry <= 0 ? 0 : (carry + ih - 1) / ih;
+            sx -= skip * x_dec + (int)carry;
+            f   = (int)(f - (int64_t)skip * n_dec + carry * ih);
+            iy += skip;
+            row = &table[index[iy]];
+            *row = (*row)+1; /* Increment the count */
+            row[*row * 2 - 1] = sx;
+            row[*row * 2    ] = id;
+        }
+        delta = last - iy;
+        while (delta-- > 0) {
             int count;
             iy++;
             sx -= x_dec;
@@ -2505,12 +2732,11 @@ static void mark_line_tr(fixed sx, fixed sy, fixed ex, fixed ey, int base_y, int
             count = *row = (*row)+1; /* Increment the count */
             row[count * 2 - 1] = sx;
             row[count * 2    ] = id;
-         }
-         while (--delta);
+        }
     }
 }
 
-static void mark_curve_tr(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int *table, int *index, int *id, int depth)
+static void mark_curve_tr(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int lo, int hi, int *table, int *index, int *id, int depth)
 {
     fixed ax = (sx + c1x)>>1;
     fixed ay = (sy + c1y)>>1;
@@ -2528,15 +2754,15 @@ static void mark_curve_tr(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, f
     assert(depth >= 0);
     if (depth == 0) {
         *id += 1;
-        mark_line_tr(sx, sy, ex, ey, base_y, height, table, index, *id);
+        mark_line_tr(sx, sy, ex, ey, base_y, height, lo, hi, table, index, *id);
     } else {
         depth--;
-        mark_curve_tr(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, table, index, id, depth);
-        mark_curve_tr(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, table, index, id, depth);
+        mark_curve_tr(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, lo, hi, table, index, id, depth);
+        mark_curve_tr(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, lo, hi, table, index, id, depth);
     }
 }
 
-static void mark_curve_big_tr(fixed64 sx, fixed64 sy, fixed64 c1x, fixed64 c1y, fixed64 c2x, fixed64 c2y, fixed64 ex, fixed64 ey, fixed base_y, fixed height, int *table, int *index, int *id, int depth)
+static void mark_curve_big_tr(fixed64 sx, fixed64 sy, fixed64 c1x, fixed64 c1y, fixed64 c2x, fixed64 c2y, fixed64 ex, fixed64 ey, fixed base_y, fixed height, int lo, int hi, int *table, int *index, int *id, int depth)
 {
     fixed64 ax = (sx + c1x)>>1;
     fixed64 ay = (sy + c1y)>>1;
@@ -2554,22 +2780,22 @@ static void mark_curve_big_tr(fixed64 sx, fixed64 sy, fixed64 c1x, fixed64 c1y,
     assert(depth >= 0);
     if (depth == 0) {
         *id += 1;
-        mark_line_tr((fixed)sx, (fixed)sy, (fixed)ex, (fixed)ey, base_y, height, table, index, *id);
+        mark_line_tr((fixed)sx, (fixed)sy, (fixed)ex, (fixed)ey, base_y, height, lo, hi, table, index, *id);
     } else {
         depth--;
-        mark_curve_big_tr(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, table, index, id, depth);
-        mark_curve_big_tr(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, table, index, id, depth);
+        mark_curve_big_tr(sx, sy, ax, ay, dx, dy, gx, gy, base_y, height, lo, hi, table, index, id, depth);
+        mark_curve_big_tr(gx, gy, fx, fy, cx, cy, ex, ey, base_y, height, lo, hi, table, index, id, depth);
     }
 }
 
-static void mark_curve_top_tr(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int *table, int *index, int *id, int depth)
+static void mark_curve_top_tr(fixed sx, fixed sy, fixed c1x, fixed c1y, fixed c2x, fixed c2y, fixed ex, fixed ey, fixed base_y, fixed height, int lo, int hi, int *table, int *index, int *id, int depth)
 {
     fixed test = (sx^(sx<<1))|(sy^(sy<<1))|(c1x^(c1x<<1))|(c1y^(c1y<<1))|(c2x^(c2x<<1))|(c2y^(c2y<<1))|(ex^(ex<<1))|(ey^(ey<<1));
 
     if (test < 0)
-        mark_curve_big_tr(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, table, index, id, depth);
+        mark_curve_big_tr(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, lo, hi, table, index, id, depth);
     else
-        mark_curve_tr(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, table, index, id, depth);
+        mark_curve_tr(sx, sy, c1x, c1y, c2x, c2y, ex, ey, base_y, height, lo, hi, table, index, id, depth);
 }
 
 static int make_table_tr(gx_device     * pdev,
@@ -2592,51 +2818,60 @@ fill_zero_tr(int *row, const fixed *x)
     row[2*n  ] = 1;
 }
 
-int gx_scan_convert_tr(gx_device     * gs_restrict pdev,
-                       gx_path       * gs_restrict path,
-                 const gs_fixed_rect * gs_restrict clip,
-                       gx_edgebuffer * gs_restrict edgebuffer,
-                       fixed                    fixed_flat)
+/* Step 4: Sort the intersects on x, for scanlines lo <= y < hi. */
+static void
+sort_rows_tr(void *arg_, int lo, int hi)
 {
-    gs_fixed_rect  ibox;
-    gs_fixed_rect  bbox;
-    int            scanlines;
-    const subpath *psub;
-    int           *index;
-    int           *table;
-    int            i;
-    int            code;
-    int            id = 0;
-    int            zero;
-
-    edgebuffer->index = NULL;
-    edgebuffer->table = NULL;
+    scan_convert_rows_arg *arg = (scan_convert_rows_arg *)arg_;
+    int *table = arg->table;
+    int *index = arg->index;
+    int  i;
 
-    /* Bale out if no actual path. We see this with the clist */
-    if (path->first_subpath == NULL)
-        return 0;
-
-    zero = make_bbox(path, clip, &bbox, &ibox, fixed_half);
-    if (zero < 0)
-        return zero;
-
-    if (ibox.q.y <= ibox.p.y)
-        return 0;
+    for (i=lo; i < hi; i++) {
+        int *row = &table[index[i]];
+        int  rowlen = *row++;
 
-    code = make_table_tr(pdev, path, &ibox, &scanlines, &index, &table);
-    if (code != 0) /* > 0 means "retry with smaller height" */
-        return code;
+        /* Bubblesort short runs, qsort longer ones. */
+        /* FIXME: Verify the figure 6 below */
+        if (rowlen <= 6) {
+            int j, k;
+            for (j = 0; j < rowlen-1; j++) {
+                int * gs_restrict t = &row[j<<1];
+                for (k = j+1; k < rowlen; k++) {
+                    int * gs_restrict s = &row[k<<1];
+                    int tmp;
+                    if (t[0] < s[0])
+                        continue;
+                    if (t[0] == s[0]) {
+                        if (t[1] <= s[1])
+                            continue;
+                    } else
+                        tmp = t[0], t[0] = s[0], s[0] = tmp;
+                    tmp = t[1], t[1] = s[1], s[1] = tmp;
+                }
+            }
+        } else
+            qsort(row, rowlen, 2*sizeof(int), intcmp_tr);
+    }
 
-    if (scanlines == 0)
-        return 0;
+}
 
-    if (zero) {
-        code = zero_case(pdev, path, &ibox, index, table, fixed_flat, fill_zero_tr);
-    } else {
+/* Steps 3 and 4 for scanlines lo <= y < hi. */
+static void
+scan_convert_rows_tr(void *arg_, int lo, int hi)
+{
+    scan_convert_rows_arg *arg = (scan_convert_rows_arg *)arg_;
+    const subpath *psub;
+    int            base_y    = arg->base_y;
+    int            scanlines = arg->scanlines;
+    int           *index     = arg->index;
+    int           *table     = arg->table;
+    int            id        = 0;
 
     /* Step 3: Now we run through the path, filling in the real
-     * values. */
-    for (psub = path->first_subpath; psub != 0;) {
+     * values. Every range numbers the lines in the same way, as
+     * we always walk the whole path. */
+    for (psub = arg->path->first_subpath; psub != 0;) {
         const segment *pseg = (const segment *)psub;
         fixed ex = pseg->pt.x;
         fixed ey = pseg->pt.y;
@@ -2659,36 +2894,76 @@ int gx_scan_convert_tr(gx_device     * gs_restrict pdev,
                     break;
                 case s_curve: {
                     const curve_segment *const pcur = (const curve_segment *)pseg;
-                    int k = gx_curve_log2_samples(sx, sy, pcur, fixed_flat);
+                    int k = gx_curve_log2_samples(sx, sy, pcur, arg->fixed_flat);
 
-                    mark_curve_top_tr(sx, sy, pcur->p1.x, pcur->p1.y, pcur->p2.x, pcur->p2.y, ex, ey, ibox.p.y, scanlines, table, index, &id, k);
+                    mark_curve_top_tr(sx, sy, pcur->p1.x, pcur->p1.y, pcur->p2.x, pcur->p2.y, ex, ey, base_y, scanlines, lo, hi, table, index, &id, k);
                     break;
                 }
                 case s_gap:
                 case s_line:
                 case s_line_close:
                     if (sy != ey)
-                        mark_line_tr(sx, sy, ex, ey, ibox.p.y, scanlines, table, index, ++id);
+                        mark_line_tr(sx, sy, ex, ey, base_y, scanlines, lo, hi, table, index, ++id);
                     break;
             }
         }
         /* And close any open segments */
         if (iy != ey)
-            mark_line_tr(ex, ey, ix, iy, ibox.p.y, scanlines, table, index, ++id);
+            mark_line_tr(ex, ey, ix, iy, base_y, scanlines, lo, hi, table, index, ++id);
         psub = (const subpath *)pseg;
     }
-    }
 
-    //if (zero) {
-    //    if (table[0] == 0) {
-    //        /* Zero height rectangle fills a span */
-    //        table[0] = 2;
-    //        table[1] = int2fixed(fixed2int(bbox.p.x + fixed_half));
-    //        table[2] = 0;
-    //        table[3] = int2fixed(fixed2int(bbox.q.x + fixed_half));
-    //        table[4] = 1;
-    //    }
-    //}
+    sort_rows_tr(arg, lo, hi);
+}
+
+int gx_scan_convert_tr(gx_device     * gs_restrict pdev,
+                       gx_path       * gs_restrict path,
+                 const gs_fixed_rect * gs_restrict clip,
+                       gx_edgebuffer * gs_restrict edgebuffer,
+                       fixed                    fixed_flat)
+{
+    gs_fixed_rect  ibox;
+    gs_fixed_rect  bbox;
+    int            scanlines;
+    int           *index;
+    int           *table;
+    int            code;
+    int            zero;
+    scan_convert_rows_arg arg;
+
+    edgebuffer->index = NULL;
+    edgebuffer->table = NULL;
+
+    /* Bale out if no actual path. We see this with the clist */
+    if (path->first_subpath == NULL)
+        return 0;
+
+    zero = make_bbox(path, clip, &bbox, &ibox, fixed_half);
+    if (zero < 0)
+        return zero;
+
+    if (ibox.q.y <= ibox.p.y)
+        return 0;
+
+    code = make_table_tr(pdev, path, &ibox, &scanlines, &index, &table);
+    if (code != 0) /* > 0 means "retry with smaller height" */
+        return code;
+
+    if (scanlines == 0)
+        return 0;
+
+    arg.path       = path;
+    arg.fixed_flat = fixed_flat;
+    arg.base_y     = ibox.p.y;
+    arg.scanlines  = scanlines;
+    arg.index      = index;
+    arg.table      = table;
+
+    if (zero) {
+        code = zero_case(pdev, path, &ibox, index, table, fixed_flat, fill_zero_tr);
+        sort_rows_tr(&arg, 0, scanlines);
+    } else
+        scanc_run_rows(scanlines, index, scan_convert_rows_tr, &arg);
 
     /* Step 2 complete: We now have a complete list of intersection data in
      * table, indexed by index. */
@@ -2702,39 +2977,11 @@ int gx_scan_convert_tr(gx_device     * gs_restrict pdev,
 
 #ifdef DEBUG_SCAN_CONVERTER
     if (debugging_scan_converter) {
-        dlprintf("Before sorting:\n");
+        dlprintf("After sorting:\n");
         gx_edgebuffer_print_tr(edgebuffer);
     }
 #endif
 
-    /* Step 4: Sort the intersects on x */
-    for (i=0; i < scanlines; i++) {
-        int *row = &table[index[i]];
-        int  rowlen = *row++;
-
-        /* Bubblesort short runs, qsort longer ones. */
-        /* FIXME: Verify the figure 6 below */
-        if (rowlen <= 6) {
-            int j, k;
-            for (j = 0; j < rowlen-1; j++) {
-                int * gs_restrict t = &row[j<<1];
-                for (k = j+1; k < rowlen; k++) {
-                    int * gs_restrict s = &row[k<<1];
-                    int tmp;
-                    if (t[0] < s[0])
-                        continue;
-                    if (t[0] == s[0]) {
-                        if (t[1] <= s[1])
-                            continue;
-                    } else
-                        tmp = t[0], t[0] = s[0], s[0] = tmp;
-                    tmp = t[1], t[1] = s[1], s[1] = tmp;
-                }
-            }
-        } else
-            qsort(row, rowlen, 2*sizeof(int), intcmp_tr);
-    }
-
     return 0;
 }
 
@@ -4048,6 +4295,58 @@ fill_zero_app_tr(int *row, const fixed *x)
     row[4*n  ] = 1;
 }
 
+/* Step 3: Sort the intersects on x, for scanlines lo <= y < hi. */
+static void
+sort_rows_tr_app(void *arg_, int lo, int hi)
+{
+    scan_convert_rows_arg *arg = (scan_convert_rows_arg *)arg_;
+    int *table = arg->table;
+    int *index = arg->index;
+    int  i;
+
+    for (i=lo; i < hi; i++) {
+        int *row = &table[index[i]];
+        int  rowlen = *row++;
+
+        /* Bubblesort short runs, qsort longer ones. */
+        /* Figure of '6' comes from testing */
+        if (rowlen <= 6) {
+            int j, k;
+            for (j = 0; j < rowlen-1; j++) {
+                int * gs_restrict t = &row[j<<2];
+                for (k = j+1; k < rowlen; k++) {
+                    int * gs_restrict s = &row[k<<2];
+                    int tmp;
+                    if (t[0] < s[0])
+                        continue;
+                    if (t[0] > s[0])
+                        goto swap0213;
+                    if (t[2] < s[2])
+                        continue;
+                    if (t[2] > s[2])
+                        goto swap213;
+                    if (t[1] < s[1])
+                        continue;
+                    if (t[1] > s[1])
+                        goto swap13;
+                    if (t[3] <= s[3])
+                        continue;
+                    if (0) {
+swap0213:
+                        tmp = t[0], t[0] = s[0], s[0] = tmp;
+swap213:
+                        tmp = t[2], t[2] = s[2], s[2] = tmp;
+swap13:
+                        tmp = t[1], t[1] = s[1], s[1] = tmp;
+                    }
+                    tmp = t[3], t[3] = s[3], s[3] = tmp;
+                }
+            }
+        } else
+            qsort(row, rowlen, 4*sizeof(int), edgecmp_tr);
+    }
+}
+
 int gx_scan_convert_tr_app(gx_device     * gs_restrict pdev,
                            gx_path       * gs_restrict path,
                      const gs_fixed_rect * gs_restrict clip,
@@ -4060,7 +4359,7 @@ int gx_scan_convert_tr_app(gx_device     * gs_restrict pdev,
     const subpath *psub;
     int           *index;
     int           *table;
-    int            i;
+    scan_convert_rows_arg arg;
     cursor_tr      cr;
     int            code;
     int            id = 0;
@@ -4169,48 +4468,11 @@ int gx_scan_convert_tr_app(gx_device     * gs_restrict pdev,
     }
 #endif
 
-    /* Step 3: Sort the intersects on x */
-    for (i=0; i < scanlines; i++) {
-        int *row = &table[index[i]];
-        int  rowlen = *row++;
-
-        /* Bubblesort short runs, qsort longer ones. */
-        /* Figure of '6' comes from testing */
-        if (rowlen <= 6) {
-            int j, k;
-            for (j = 0; j < rowlen-1; j++) {
-                int * gs_restrict t = &row[j<<2];
-                for (k = j+1; k < rowlen; k++) {
-                    int * gs_restrict s = &row[k<<2];
-                    int tmp;
-                    if (t[0] < s[0])
-                        continue;
-                    if (t[0] > s[0])
-                        goto swap0213;
-                    if (t[2] < s[2])
-                        continue;
-                    if (t[2] > s[2])
-                        goto swap213;
-                    if (t[1] < s[1])
-                        continue;
-                    if (t[1] > s[1])
-                        goto swap13;
-                    if (t[3] <= s[3])
-                        continue;
-                    if (0) {
-swap0213:
-                        tmp = t[0], t[0] = s[0], s[0] = tmp;
-swap213:
-                        tmp = t[2], t[2] = s[2], s[2] = tmp;
-swap13:
-                        tmp = t[1], t[1] = s[1], s[1] = tmp;
-                    }
-                    tmp = t[3], t[3] = s[3], s[3] = tmp;
-                }
-            }
-        } else
-            qsort(row, rowlen, 4*sizeof(int), edgecmp_tr);
-    }
+    /* Step 3: Sort the intersects on x. The marking above has to be
+     * done in order, but the rows can be sorted in parallel. */
+    arg.index = index;
+    arg.table = table;
+    scanc_run_rows(scanlines, index, sort_rows_tr_app, &arg);
 
     return 0;
 }
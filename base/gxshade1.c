@@ -427,6 +427,7 @@ gs_shading_A_fill_rectangle_aux(const gs_shading_t * psh0, const gs_rect * rect,
         goto fail;
     pfs1.maybe_self_intersecting = false;
     pfs1.function_arg_shift = 1;
+    init_patch_function_lut(&pfs1, psh0);
     /*
      * Compute the parameter range.  We construct a matrix in which
      * (0,0) corresponds to t = 0 and (0,1) corresponds to t = 1,
@@ -2387,6 +2388,7 @@ gs_shading_R_fill_rectangle_aux(const gs_shading_t * psh0, const gs_rect * rect,
         return code;
     }
     pfs1.function_arg_shift = 0;
+    init_patch_function_lut(&pfs1, psh0);
     pfs1.rect = *clip_rect;
     pfs1.maybe_self_intersecting = false;
     if (is_radial_shading_large(x0, y0, r0, x1, y1, r1, rect))
@@ -113,6 +113,7 @@ gs_shading_FfGt_fill_rectangle(const gs_shading_t * psh0, const gs_rect * rect,
         if (pfs.icclink != NULL) gsicc_release_link(pfs.icclink);
         return code;
     }
+    init_patch_function_lut(&pfs, psh0);
     reserve_colors(&pfs, C, 3); /* Can't fail */
     va.c = ca = C[0];
     vb.c = cb = C[1];
@@ -185,6 +186,7 @@ gs_shading_LfGt_fill_rectangle(const gs_shading_t * psh0, const gs_rect * rect,
     code = init_patch_fill_state(&pfs);
     if (code < 0)
         goto out;
+    init_patch_function_lut(&pfs, psh0);
     reserve_colors(&pfs, &cn, 1); /* Can't fail. */
     next.c = cn;
     shade_next_init(&cs, (const gs_shading_mesh_params_t *)&psh->params,
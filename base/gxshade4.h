@@ -141,6 +141,9 @@ struct patch_fill_state_s {
     byte *color_stack_limit;
     gs_memory_t *memory; /* Where color_buffer is allocated. */
     gs_color_index_cache_t *pcic;
+    const float *function_lut; /* Samples of Function, see init_patch_function_lut. */
+    int function_lut_size;
+    float function_lut_t0, function_lut_scale;
 } ;
 
 /* Define a structure for mesh or patch vertex. */
@@ -168,6 +171,23 @@ int mesh_init_fill_state(mesh_fill_state_t * pfs,
                           gx_device * dev, gs_gstate * pgs);
 
 int init_patch_fill_state(patch_fill_state_t *pfs);
+/*
+ * A table of samples of a shading's 1-input Function, shared by all fills
+ * of the shading. size is 0 if the Function isn't worth tabulating.
+ * max_error is the largest difference between the interpolated and real
+ * values of each component; each fill uses the table only if this is
+ * within its own smoothness.
+ */
+typedef struct gs_shading_function_lut_s {
+    gs_memory_t *memory;        /* non-GC allocator that owns this */
+    int size;                   /* number of intervals */
+    int num_components;
+    float t0, scale;
+    float max_error[GS_CLIENT_COLOR_MAX_COMPONENTS];
+    /* (size + 1) * num_components samples follow. */
+} gs_shading_function_lut_t;
+
+void init_patch_function_lut(patch_fill_state_t *pfs, const gs_shading_t *psh);
 bool term_patch_fill_state(patch_fill_state_t *pfs);
 int gx_init_patch_fill_state_for_clist(gx_device *dev, patch_fill_state_t *pfs, gs_memory_t *memory);
 
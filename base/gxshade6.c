@@ -37,6 +37,8 @@
 #include "math_.h"
 #include "gsicc_cache.h"
 #include "gxdevsop.h"
+#include "gslibctx.h"
+#include "gsfunc3.h"
 
 /* The original version of the shading code 'decompose's shadings into
  * smaller and smaller regions until they are smaller than 1 pixel, and then
@@ -79,6 +81,42 @@ enum {
             required to apply linear color device functions. */
 };
 
+/* Mesh, axial and radial shadings with a Function evaluate it at every
+ * vertex of the decomposition, which is expensive for Type 4 (PostScript
+ * calculator) and stitching functions. init_patch_function_lut samples a
+ * 1-input Function at SHADING_FUNCTION_LUT_SIZE+1 evenly spaced points over
+ * its Domain, and vertex colors are then linearly interpolated from these
+ * samples. The table is made once per shading and kept with it, so every
+ * clip rectangle and every path filled with the shading uses the same one.
+ * Type 2 (exponential) Functions are cheaper to evaluate than to tabulate,
+ * so they are left alone. A fill only uses the table if the interpolated
+ * value at the midpoint of every interval is within half its smoothness of
+ * the real function, so functions with steps or sharp corners are still
+ * evaluated exactly. As the colors can still differ slightly from those
+ * of the real function, this is only done when the TabulateShadingFunctions
+ * user parameter is true; it is false by default. Predefine
+ * SHADING_FUNCTION_LUT_SIZE to 0 to leave it out altogether.
+ */
+#ifndef SHADING_FUNCTION_LUT_SIZE
+#define SHADING_FUNCTION_LUT_SIZE 1024
+#endif
+
+/* TabulateShadingFunctions control */
+void
+gs_settabulateshadingfunctions(gs_memory_t *mem, bool tabulate)
+{
+    gs_lib_ctx_t *ctx = gs_lib_ctx_get_interp_instance(mem);
+
+    ctx->shading_tabulate_functions = tabulate;
+}
+bool
+gs_currenttabulateshadingfunctions(const gs_memory_t *mem)
+{
+    gs_lib_ctx_t *ctx = gs_lib_ctx_get_interp_instance(mem);
+
+    return ctx->shading_tabulate_functions;
+}
+
 /* ================ Utilities ================ */
 
 static int
@@ -295,9 +333,107 @@ init_patch_fill_state(patch_fill_state_t *pfs)
     pfs->color_stack = NULL;
     pfs->color_stack_limit = NULL;
     pfs->unlinear = !is_linear_color_applicable(pfs);
+    pfs->function_lut = NULL;
+    pfs->function_lut_size = 0;
     return alloc_patch_fill_memory(pfs, pfs->pgs->memory, pcs);
 }
 
+/* Sample the Function of a shading, as described above. */
+static gs_shading_function_lut_t *
+make_shading_function_lut(const patch_fill_state_t *pfs)
+{
+    const gs_function_t *pfn = pfs->Function;
+    const gs_color_space *pcs = pfs->direct_space;
+    gs_memory_t *mem = pfs->memory->non_gc_memory;
+    int n = pfs->num_components, size = SHADING_FUNCTION_LUT_SIZE;
+    gs_shading_function_lut_t *plut;
+    gs_client_color cc;
+    float *lut, t0, t1, t;
+    int i, j, code;
+
+    t0 = pfn->params.Domain[0];
+    t1 = pfn->params.Domain[1];
+    /* Exponential interpolation functions are cheap enough as they are. */
+    if (pfn->params.m != 1 || pcs == NULL || !(t1 > t0) ||
+        FunctionType(pfn) == function_type_ExponentialInterpolation)
+        size = 0;
+    plut = (gs_shading_function_lut_t *)
+        gs_alloc_bytes(mem, sizeof(gs_shading_function_lut_t) +
+                       (size > 0 ? (size + 1) * n * sizeof(float) : 0),
+                       "make_shading_function_lut");
+    if (plut == NULL)
+        return NULL; /* Not fatal, we just evaluate the function each time. */
+    plut->memory = mem;
+    plut->size = 0;
+    plut->num_components = n;
+    if (size == 0)
+        return plut;
+    lut = (float *)(plut + 1);
+    for (i = 0; i <= size; i++) {
+        t = (i == size ? t1 : t0 + (t1 - t0) * i / size);
+        code = gs_function_evaluate(pfn, &t, cc.paint.values);
+        if (code < 0)
+            return plut;
+        pcs->type->restrict_color(&cc, pcs);
+        memcpy(lut + i * n, cc.paint.values, n * sizeof(float));
+    }
+    /* Measure the interpolation error half way between each pair of samples. */
+    for (j = 0; j < n; j++)
+        plut->max_error[j] = 0;
+    for (i = 0; i < size; i++) {
+        t = t0 + (t1 - t0) * (i + 0.5) / size;
+        code = gs_function_evaluate(pfn, &t, cc.paint.values);
+        if (code < 0)
+            return plut;
+        pcs->type->restrict_color(&cc, pcs);
+        for (j = 0; j < n; j++) {
+            float e = any_abs((lut[i * n + j] + lut[(i + 1) * n + j]) / 2 -
+                              cc.paint.values[j]);
+
+            if (e > plut->max_error[j])
+                plut->max_error[j] = e;
+        }
+    }
+    plut->size = size;
+    plut->t0 = t0;
+    plut->scale = size / (t1 - t0);
+    return plut;
+}
+
+/*
+ * Set up the fill state to use the shading's Function table, making it on
+ * the first fill of the shading. Shadings are only filled on the thread
+ * interpreting the page, as pattern colors are never written to the clist,
+ * so the table needs no locking.
+ */
+void
+init_patch_function_lut(patch_fill_state_t *pfs, const gs_shading_t *psh)
+{
+    gs_shading_function_lut_t *plut = psh->head.function_lut;
+    int j;
+
+    if (pfs->Function == NULL || SHADING_FUNCTION_LUT_SIZE <= 0 ||
+        !gs_currenttabulateshadingfunctions(pfs->memory))
+        return;
+    if (plut == NULL) {
+        plut = make_shading_function_lut(pfs);
+        if (plut == NULL)
+            return;
+        /* This is a cache, so it doesn't count as changing the shading. */
+        ((gs_shading_t *)psh)->head.function_lut = plut;
+    }
+    if (plut->size == 0 || plut->num_components != pfs->num_components)
+        return;
+    for (j = 0; j < plut->num_components; j++)
+        if (plut->max_error[j] >
+                pfs->smoothness * pfs->color_domain.paint.values[j] / 2)
+            return;
+    pfs->function_lut = (const float *)(plut + 1);
+    pfs->function_lut_size = plut->size;
+    pfs->function_lut_t0 = plut->t0;
+    pfs->function_lut_scale = plut->scale;
+}
+
 bool
 term_patch_fill_state(patch_fill_state_t *pfs)
 {
@@ -316,7 +452,25 @@ term_patch_fill_state(patch_fill_state_t *pfs)
 static inline void
 patch_resolve_color_inline(patch_color_t * ppcr, const patch_fill_state_t *pfs)
 {
-    if (pfs->Function) {
+    if (pfs->function_lut) {
+        /* The samples are already restricted, and so are values between them. */
+        int n = pfs->num_components, i, j;
+        float x = (ppcr->t[0] - pfs->function_lut_t0) * pfs->function_lut_scale;
+        const float *p;
+
+        if (x <= 0)
+            memcpy(ppcr->cc.paint.values, pfs->function_lut, n * sizeof(float));
+        else if (x >= pfs->function_lut_size)
+            memcpy(ppcr->cc.paint.values, pfs->function_lut + pfs->function_lut_size * n,
+                   n * sizeof(float));
+        else {
+            i = (int)x;
+            x -= i;
+            p = pfs->function_lut + i * n;
+            for (j = 0; j < n; j++)
+                ppcr->cc.paint.values[j] = p[j] + (p[j + n] - p[j]) * x;
+        }
+    } else if (pfs->Function) {
         const gs_color_space *pcs = pfs->direct_space;
 
         gs_function_evaluate(pfs->Function, ppcr->t, ppcr->cc.paint.values);
@@ -460,6 +614,7 @@ gs_shading_Cp_fill_rectangle(const gs_shading_t * psh0, const gs_rect * rect,
         if (state.icclink != NULL) gsicc_release_link(state.icclink);
         return code;
     }
+    init_patch_function_lut(&state, psh0);
 
     curve[0].straight = curve[1].straight = curve[2].straight = curve[3].straight = false;
     shade_next_init(&cs, (const gs_shading_mesh_params_t *)&psh->params, pgs);
@@ -548,6 +703,7 @@ gs_shading_Tpp_fill_rectangle(const gs_shading_t * psh0, const gs_rect * rect,
     code = init_patch_fill_state(&state);
     if(code < 0)
         return code;
+    init_patch_function_lut(&state, psh0);
     curve[0].straight = curve[1].straight = curve[2].straight = curve[3].straight = false;
     shade_next_init(&cs, (const gs_shading_mesh_params_t *)&psh->params, pgs);
     while ((code = shade_next_patch(&cs, psh->params.BitsPerFlag,
@@ -3034,6 +3190,8 @@ gx_init_patch_fill_state_for_clist(gx_device *dev, patch_fill_state_t *pfs, gs_m
     pfs->color_stack = NULL; /* fixme */
     pfs->color_stack_limit = NULL; /* fixme */
     pfs->pcic = NULL; /* Will do someday. */
+    pfs->function_lut = NULL;
+    pfs->function_lut_size = 0;
     pfs->trans_device = NULL;
     pfs->icclink = NULL;
     return alloc_patch_fill_memory(pfs, memory, NULL);
@@ -26,6 +26,7 @@
 #include "gxdht.h"
 #include "gxhttile.h"
 #include "gxdevcli.h"
+#include "gxhtmemo.h"
 
 /* Sort a sampled halftone order by sample value. */
 void gx_sort_ht_order(gx_ht_bit *, uint);
@@ -59,6 +60,8 @@ struct gs_screen_enum_s {
     int x, y;
     int strip, shift;
     gs_gstate *pgs;
+    bool memo_samples;		/* store the samples in the memo */
+    gx_ht_memo_key_t memo_key;
 };
 
 #define private_st_gs_screen_enum() /* in gshtscr.c */\
@@ -17,6 +17,7 @@
 /* CCITTFax decoding filter */
 #include "stdio_.h"		/* includes std.h */
 #include "memory_.h"
+#include "stdint_.h"
 #include "gdebug.h"
 #include "strimpl.h"
 #include "scf.h"
@@ -29,14 +30,7 @@ private_st_CFD_state();
 #define CFD_BUFFER_SLOP 4
 
 static inline int
-get_run(stream_CFD_state *ss, stream_cursor_read *pr, const cfd_node decode[],
-    int initial_bits, int min_bits, int *runlen, const char *str);
-
-static inline int
-invert_data(stream_CFD_state *ss, stream_cursor_read *pr, int *rlen, byte black_byte);
-
-static inline int
-skip_data(stream_CFD_state *ss, stream_cursor_read *pr, int rlen);
+invert_data(stream_CFD_state *ss, byte **pq, int *pqbit, int *rlen, byte black_byte);
 
 /* Set default parameter values. */
 static void
@@ -106,18 +100,35 @@ s_CFD_release(stream_state * st)
     gs_free_object(st->memory, ss->lbufstart, "CFD lbuf(close)");
 }
 
+/*
+ * The line decoders (cf_decode_1d and cf_decode_2d) keep the input bits in
+ * a local 64-bit accumulator, which is refilled up to 7 bytes at a time.
+ * The bit buffer in the stream state is the uint of shc.h, shared with the
+ * EOL scanner, so when a line decoder returns it puts whole unused bytes
+ * back into the input, just as hcd_store_state does, and leaves at most 7
+ * bits in ss->bits.
+ */
+
 /* Declare the variables that hold the state. */
 #define cfd_declare_state\
-        hcd_declare_state;\
-        register byte *q;\
+        register const byte *p;\
+        const byte *rlimit;\
+        uint64_t bits;\
+        int bits_left;\
+        byte *q;\
         int qbit
 /* Load the state from the stream. */
 #define cfd_load_state()\
-        hcd_load_state(),\
+        p = pr->ptr,\
+        rlimit = pr->limit,\
+        bits = ss->bits,\
+        bits_left = ss->bits_left,\
         q = ss->lbuf + ss->wpos, qbit = ss->cbit
 /* Store the state back in the stream. */
 #define cfd_store_state()\
-        hcd_store_state(),\
+        pr->ptr = p -= (bits_left >> 3),\
+        ss->bits = (uint)(bits >> (bits_left & ~7)),\
+        ss->bits_left = bits_left &= 7,\
         ss->wpos = q - ss->lbuf, ss->cbit = qbit
 
 /* Macros to get blocks of bits from the input stream. */
@@ -130,90 +141,98 @@ s_CFD_release(stream_state * st)
 #define peek_var_bits(n) hcd_peek_var_bits(n)
 #define skip_bits(n) hcd_skip_bits(n)
 
-/* Get a run from the stream. */
-#ifdef DEBUG
-#  define IF_DEBUG(expr) expr
-#else
-#  define IF_DEBUG(expr) DO_NOTHING
-#endif
-
-static inline int get_run(stream_CFD_state *ss, stream_cursor_read *pr, const cfd_node decode[],
-           int initial_bits, int min_bits, int *runlen, const char *str)
-{
-    cfd_declare_state;
-    const cfd_node *np;
-    int clen;
-    cfd_load_state();
-
-    HCD_ENSURE_BITS_ELSE(initial_bits) {
-        /* We might still have enough bits for the specific code. */
-        if (bits_left < min_bits)
-            goto outl;
-        np = &decode[hcd_peek_bits_left() << (initial_bits - bits_left)];
-        if ((clen = np->code_length) > bits_left)
-            goto outl;
-        goto locl;
-    }
-    np = &decode[peek_bits(initial_bits)];
-    if ((clen = np->code_length) > initial_bits) {
-            IF_DEBUG(uint init_bits = peek_bits(initial_bits));
-            if (!avail_bits(clen)) goto outl;
-            clen -= initial_bits;
-            skip_bits(initial_bits);
-            ensure_bits(clen, outl);                /* can't goto outl */
-            np = &decode[np->run_length + peek_var_bits(clen)];
-            if_debug4('W', "%s xcode=0x%x,%d rlen=%d\n", str,
-                      (init_bits << np->code_length) +
-                        peek_var_bits(np->code_length),
-                      initial_bits + np->code_length,
-                      np->run_length);
-            skip_bits(np->code_length);
-    } else {
-locl:
-       if_debug4('W', "%s code=0x%x,%d rlen=%d\n", str,
-                      peek_var_bits(clen), clen, np->run_length);
-       skip_bits(clen);
-    }
-    *runlen = np->run_length;
-
-    cfd_store_state();
-    return(0);
-outl:
-    cfd_store_state();
-    return(-1);
-}
+/*
+ * The same for the 64-bit accumulator of the line decoders.
+ * cfd_more_bits loads at least 56 bits, or all the rest of the input;
+ * it requires bits_left < 56.  cfd_ensure_bits(n) requires n <= 16.
+ */
+#define cfd_more_bits()\
+  BEGIN\
+    if (rlimit - p >= 8 && !ss->FirstBitLowOrder) {\
+        int n_ = (63 - bits_left) & ~7;\
+        uint64_t w_ =\
+            ((uint64_t)p[1] << 56) | ((uint64_t)p[2] << 48) |\
+            ((uint64_t)p[3] << 40) | ((uint64_t)p[4] << 32) |\
+            ((uint64_t)p[5] << 24) | ((uint64_t)p[6] << 16) |\
+            ((uint64_t)p[7] << 8) | p[8];\
+\
+        bits = (bits << n_) | (w_ >> (64 - n_));\
+        p += n_ >> 3, bits_left += n_;\
+    } else\
+        while (bits_left <= 56 && p < rlimit) {\
+            uint c_ = *++p;\
+\
+            if (ss->FirstBitLowOrder)\
+                c_ = byte_reverse_bits[c_];\
+            bits = (bits << 8) + c_, bits_left += 8;\
+        }\
+  END
+#define cfd_ensure_bits(n)\
+  BEGIN if (bits_left < (n)) cfd_more_bits(); END
+#define cfd_peek_bits(n)\
+  ((uint)(bits >> (bits_left - (n))) & ((1 << (n)) - 1))
+#define cfd_skip_bits(n) (bits_left -= (n))
+
+/* The longest code in the decoding tables. */
+#define cfd_max_code_bits 13
 
+/*
+ * Get a run from the stream.
+ * Decode a run length (or a 2-D mode code) into runlen.  If the input
+ * runs out before the code is complete, consume nothing and go to outl.
+ */
+#define get_run(decode, initial_bits, min_bits, runlen, str, outl)\
+BEGIN\
+    const cfd_node *np;\
+    int clen;\
+\
+    cfd_ensure_bits(cfd_max_code_bits);\
+    if (bits_left < (initial_bits)) {\
+        /* We might still have enough bits for the specific code. */\
+        if (bits_left < (min_bits))\
+            goto outl;\
+        np = &(decode)[((uint)bits & ((1 << bits_left) - 1)) <<\
+                       ((initial_bits) - bits_left)];\
+        if ((clen = np->code_length) > bits_left)\
+            goto outl;\
+        if_debug4('W', "%s code=0x%x,%d rlen=%d\n", str,\
+                  cfd_peek_bits(clen), clen, np->run_length);\
+    } else {\
+        np = &(decode)[cfd_peek_bits(initial_bits)];\
+        if ((clen = np->code_length) > (initial_bits)) {\
+            if (clen > bits_left)\
+                goto outl;\
+            cfd_skip_bits(initial_bits);\
+            np = &(decode)[np->run_length +\
+                           cfd_peek_bits(clen - (initial_bits))];\
+            clen = np->code_length;\
+            if_debug4('W', "%s xcode=0x%x,%d rlen=%d\n", str,\
+                      cfd_peek_bits((initial_bits) + clen),\
+                      (initial_bits) + clen, np->run_length);\
+        } else\
+            if_debug4('W', "%s code=0x%x,%d rlen=%d\n", str,\
+                      cfd_peek_bits(clen), clen, np->run_length);\
+    }\
+    cfd_skip_bits(clen);\
+    runlen = np->run_length;\
+END
 
 /* Skip data bits for a white run. */
-/* rlen is either less than 64, or a multiple of 64. */
-static inline int skip_data(stream_CFD_state *ss, stream_cursor_read *pr, int rlen)
-{
-    cfd_declare_state;
-    cfd_load_state();
-    (void)rlimit;
-
-    if ( (qbit -= rlen) < 0 )
-    {
-        q -= qbit >> 3, qbit &= 7;
-        if ( rlen >= 64 ) {
-            cfd_store_state();
-            return(-1);
-        }
-    }
-    cfd_store_state();
-    return(0);
-}
+/* rlen is either less than 64, or a multiple of 64; in the latter case */
+/* (a makeup code) return -1, since a terminating code must follow. */
+#define skip_data(rlen)\
+  ((qbit -= (rlen)) < 0 ?\
+   (q -= qbit >> 3, qbit &= 7, ((rlen) >= 64 ? -1 : 0)) : 0)
 
 
 /* Invert data bits for a black run. */
 /* If rlen >= 64, execute makeup_action: this is to handle */
 /* makeup codes efficiently, since these are always a multiple of 64. */
 
-static inline int invert_data(stream_CFD_state *ss, stream_cursor_read *pr, int *rlen, byte black_byte)
+static inline int invert_data(stream_CFD_state *ss, byte **pq, int *pqbit, int *rlen, byte black_byte)
 {
-    cfd_declare_state;
-    cfd_load_state();
-    (void)rlimit;
+    register byte *q = *pq;
+    int qbit = *pqbit;
 
     if (q >= ss->lbuf + ss->raster + CFD_BUFFER_SLOP || q < ss->lbufstart) {
         return(-1);
@@ -268,7 +287,7 @@ d:            memset(q, black_byte, (*rlen) >> 3);
                 qbit = 8 - (*rlen);
                 *q ^= 0xff << qbit;
               }
-              cfd_store_state();
+              *pq = q, *pqbit = qbit;
               return(-1);
           }
     }
@@ -277,11 +296,10 @@ d:            memset(q, black_byte, (*rlen) >> 3);
             *q ^= ((1 << (*rlen)) - 1) << qbit;
 
     }
-    cfd_store_state();
+    *pq = q, *pqbit = qbit;
     return(0);
 }
 
-
 /* Buffer refill for CCITTFaxDecode filter */
 static int cf_decode_eol(stream_CFD_state *, stream_cursor_read *);
 static int cf_decode_1d(stream_CFD_state *, stream_cursor_read *);
@@ -332,7 +350,11 @@ top:
         do {
             switch ((skip = cf_decode_eol(ss, pr))) {
                 default:	/* not EOL */
+                    /* cf_decode_eol only looked ahead at these bits: */
+                    /* load any that are not in the buffer yet. */
                     hcd_load_state();
+                    while (bits_left < -skip)
+                        hcd_more_bits(out);	/* can't fail */
                     skip_bits(-skip);
                     hcd_store_state();
                     continue;
@@ -546,7 +568,6 @@ cf_decode_1d(stream_CFD_state * ss, stream_cursor_read * pr)
     int run_color = ss->run_color;
     int status;
     int bcnt;
-    (void)rlimit;
 
     cfd_load_state();
     if_debug1m('w', ss->memory, "[w1]entry run_color = %d\n", ss->run_color);
@@ -563,15 +584,8 @@ cf_decode_1d(stream_CFD_state * ss, stream_cursor_read * pr)
 
   dw:   /* Decode a white run. */
         do {
-            cfd_store_state();
-            status = get_run(ss, pr, cf_white_decode, cfd_white_initial_bits,
-                             cfd_white_min_bits, &bcnt, "[w1]white");
-            cfd_load_state();
-            if (status < 0) {
-                /* We already set run_color to 0 or -1. */
-                status = 0;
-                goto out;
-            }
+            get_run(cf_white_decode, cfd_white_initial_bits,
+                    cfd_white_min_bits, bcnt, "[w1]white", out0);
 
             if (bcnt < 0) {		/* exceptional situation */
                 switch (bcnt) {
@@ -593,9 +607,7 @@ cf_decode_1d(stream_CFD_state * ss, stream_cursor_read * pr)
                 }
             }
 
-            cfd_store_state();
-            status = skip_data(ss, pr, bcnt);
-            cfd_load_state();
+            status = skip_data(bcnt);
             if (status < 0) {
                 /* If we run out of data after a makeup code, */
                 /* note that we are still processing a white run. */
@@ -616,15 +628,8 @@ cf_decode_1d(stream_CFD_state * ss, stream_cursor_read * pr)
 
   db:   /* Decode a black run. */
         do {
-            cfd_store_state();
-            status = get_run(ss, pr, cf_black_decode, cfd_black_initial_bits,
-                             cfd_black_min_bits, &bcnt, "[w1]black");
-            cfd_load_state();
-            if (status < 0) {
-                /* We already set run_color to 1 or 2. */
-                status = 0;
-                goto out;
-            }
+            get_run(cf_black_decode, cfd_black_initial_bits,
+                    cfd_black_min_bits, bcnt, "[w1]black", out0);
 
             if (bcnt < 0) {  /* All exceptional codes are invalid here. */
                 /****** WRONG, uncompressed IS ALLOWED ******/
@@ -633,9 +638,7 @@ cf_decode_1d(stream_CFD_state * ss, stream_cursor_read * pr)
             }
 
             /* Invert bits designated by black run. */
-            cfd_store_state();
-            status = invert_data(ss, pr, &bcnt, black_byte);
-            cfd_load_state();
+            status = invert_data(ss, &q, &qbit, &bcnt, black_byte);
             if (status < 0) {
                 /* If we run out of data after a makeup code, */
                 /* note that we are still processing a black run. */
@@ -643,7 +646,11 @@ cf_decode_1d(stream_CFD_state * ss, stream_cursor_read * pr)
             }
         } while (status < 0);
     }
+    goto out;
 
+out0:
+    /* Out of input: run_color says which run to resume. */
+    status = 0;
 out:
     cfd_store_state();
     ss->run_color = run_color;
@@ -717,44 +724,39 @@ cf_decode_2d(stream_CFD_state * ss, stream_cursor_read * pr)
          * in the input stream are 1-bit "vertical 0" codes: we can't just
          * use ensure_bits(3, ...) and go to get more data if it fails.
          */
-        ensure_bits(3, out3);
+        cfd_ensure_bits(3);
+        if (bits_left < 3)
+            goto out3;
 #define vertical_0 (countof(cf2_run_vertical) / 2)
-        switch (peek_bits(3)) {
+        switch (cfd_peek_bits(3)) {
         default /*4..7*/ :	/* vertical(0) */
             if (0) {
  out3:
                 /* Unless it's a 1-bit "vertical 0" code, exit. */
-                if (!(bits_left > 0 && peek_bits(1)))
+                if (!(bits_left > 0 && cfd_peek_bits(1)))
                     goto out0;
             }
-            skip_bits(1);
+            cfd_skip_bits(1);
             rlen = vertical_0;
             break;
         case 2:		/* vertical(+1) */
-            skip_bits(3);
+            cfd_skip_bits(3);
             rlen = vertical_0 + 1;
             break;
         case 3:		/* vertical(-1) */
-            skip_bits(3);
+            cfd_skip_bits(3);
             rlen = vertical_0 - 1;
             break;
         case 1:		/* horizontal */
-            skip_bits(3);
+            cfd_skip_bits(3);
             if (invert == invert_white) {
                 /* We handle horizontal decoding here, so that we can
                  * branch back into it if we run out of input data. */
                 /* White, then black. */
   hww:
                 do {
-                    cfd_store_state();
-                    status = get_run(ss, pr, cf_white_decode,
-                                     cfd_white_initial_bits,
-                                     cfd_white_min_bits, &rlen, " white");
-                    cfd_load_state();
-                    if (status < 0) {
-                        ss->run_color = -2;
-                        goto out0;
-                    }
+                    get_run(cf_white_decode, cfd_white_initial_bits,
+                            cfd_white_min_bits, rlen, " white", hww_out);
 
                     if ((count -= rlen) < end_count) {
                         status = ERRC;
@@ -762,23 +764,14 @@ cf_decode_2d(stream_CFD_state * ss, stream_cursor_read * pr)
                     }
                     if (rlen < 0) goto rlen_lt_zero;
 
-                    cfd_store_state();
-                    status = skip_data(ss, pr, rlen);
-                    cfd_load_state();
+                    status = skip_data(rlen);
                 } while (status < 0);
 
                 /* Handle the second half of a white-black horizontal code. */
   hwb:
                 do {
-                    cfd_store_state();
-                    status = get_run(ss, pr, cf_black_decode,
-                                     cfd_black_initial_bits,
-                                     cfd_black_min_bits, &rlen, " black");
-                    cfd_load_state();
-                    if (status < 0){
-                        ss->run_color = 1;
-                        goto out0;
-                    }
+                    get_run(cf_black_decode, cfd_black_initial_bits,
+                            cfd_black_min_bits, rlen, " black", hwb_out);
 
                     if ((count -= rlen) < end_count) {
                         status = ERRC;
@@ -786,23 +779,14 @@ cf_decode_2d(stream_CFD_state * ss, stream_cursor_read * pr)
                     }
                     if (rlen < 0) goto rlen_lt_zero;
 
-                    cfd_store_state();
-                    status = invert_data(ss, pr, &rlen, black_byte);
-                    cfd_load_state();
+                    status = invert_data(ss, &q, &qbit, &rlen, black_byte);
                 } while (status < 0);
             } else {
                 /* Black, then white. */
   hbb:
                 do {
-                    cfd_store_state();
-                    status = get_run(ss, pr, cf_black_decode,
-                                     cfd_black_initial_bits,
-                                     cfd_black_min_bits, &rlen, " black");
-                    cfd_load_state();
-                    if (status < 0) {
-                        ss->run_color = 2;
-                        goto out0;
-                    }
+                    get_run(cf_black_decode, cfd_black_initial_bits,
+                            cfd_black_min_bits, rlen, " black", hbb_out);
 
                     if ((count -= rlen) < end_count) {
                         status = ERRC;
@@ -810,24 +794,15 @@ cf_decode_2d(stream_CFD_state * ss, stream_cursor_read * pr)
                     }
                     if (rlen < 0) goto rlen_lt_zero;
 
-                    cfd_store_state();
-                    status = invert_data(ss, pr, &rlen, black_byte);
-                    cfd_load_state();
+                    status = invert_data(ss, &q, &qbit, &rlen, black_byte);
                 }
                 while (status < 0);
 
                 /* Handle the second half of a black-white horizontal code. */
   hbw:
                 do {
-                    cfd_store_state();
-                    status = get_run(ss, pr, cf_white_decode,
-                                     cfd_white_initial_bits,
-                                     cfd_white_min_bits, &rlen, " white");
-                    cfd_load_state();
-                    if (status < 0) {
-                        ss->run_color = -1;
-                        goto out0;
-                    }
+                    get_run(cf_white_decode, cfd_white_initial_bits,
+                            cfd_white_min_bits, rlen, " white", hbw_out);
 
                     if ((count -= rlen) < end_count) {
                         status = ERRC;
@@ -835,20 +810,13 @@ cf_decode_2d(stream_CFD_state * ss, stream_cursor_read * pr)
                     }
                     if (rlen < 0) goto rlen_lt_zero;
 
-                    cfd_store_state();
-                    status = skip_data(ss, pr, rlen);
-                    cfd_load_state();
+                    status = skip_data(rlen);
                 } while (status < 0);
             }
             continue; /* jump back to top of decode loop */
         case 0:		/* everything else */
-            cfd_store_state();
-            status = get_run(ss, pr, cf_2d_decode, cfd_2d_initial_bits,
-                             cfd_2d_min_bits, &rlen, "[w2]");
-            cfd_load_state();
-            if (status < 0) {
-                goto out0;
-            }
+            get_run(cf_2d_decode, cfd_2d_initial_bits,
+                    cfd_2d_min_bits, rlen, "[w2]", out0);
 
             /* rlen may be run2_pass, run_uncompressed, or */
             /* 0..countof(cf2_run_vertical)-1. */
@@ -937,9 +905,7 @@ rlen_lt_zero:
             } else {		/* Invert data bits. */
                 dlen = count - prev_count;
 
-                cfd_store_state();
-                (void)invert_data(ss, pr, &dlen, black_byte);
-                cfd_load_state();
+                (void)invert_data(ss, &q, &qbit, &dlen, black_byte);
             }
             count = prev_count;
             if (rlen >= 0)		/* vertical mode */
@@ -948,6 +914,14 @@ rlen_lt_zero:
         /* jump back to top of decode loop */
     }
 
+    /* Out of input in a horizontal code: note which run to resume with. */
+  hww_out:ss->run_color = -2;
+    goto out0;
+  hwb_out:ss->run_color = 1;
+    goto out0;
+  hbb_out:ss->run_color = 2;
+    goto out0;
+  hbw_out:ss->run_color = -1;
   out0:status = 0;
     /* falls through */
   out:cfd_store_state();
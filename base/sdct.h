@@ -123,6 +123,7 @@ typedef struct stream_DCT_state_s {
     float QFactor;
     int ColorTransform;		/* -1 if not specified */
     bool NoMarker;		/* DCTEncode only */
+    int ScaleDenom;		/* DCTDecode only, IDCT reduction 1/2/4/8 */
     gs_memory_t *jpeg_memory;	/* heap for library allocations */
     /* This is a pointer to immovable storage. */
     union _jd {
@@ -148,6 +149,17 @@ extern_st(st_DCT_state);
 #define public_st_DCT_state()	/* in sdctc.c */\
   gs_public_st_const_strings1_ptrs1_final(st_DCT_state, stream_DCT_state,\
     "DCTEncode/Decode state", dct_enum_ptrs, dct_reloc_ptrs, stream_dct_finalize, Markers, data.common)
+/*
+ * DCTDecode can reduce the image by 1/ScaleDenom in the IDCT, which is much
+ * cheaper than decoding at full size and discarding samples later, if the
+ * JPEG library supports IDCT scaling.  Shared IJG libraries always do; our
+ * own build only does with GS_JPEG_IDCT_SCALING (see gsjmorec.h).
+ * The output is then ceil(width / ScaleDenom) x ceil(height / ScaleDenom).
+ */
+#ifndef DCTD_MAX_SCALE_DENOM
+#  define DCTD_MAX_SCALE_DENOM 8
+#endif
+
 /*
  * NOTE: the client *must* invoke the set_defaults procedure in the
  * template before calling the init procedure.
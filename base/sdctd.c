@@ -268,6 +268,13 @@ s_DCTD_process(stream_state * st, stream_cursor_read * pr,
             if (jddp->dinfo.saw_Adobe_marker)
                 ss->ColorTransform = jddp->dinfo.Adobe_transform;
 
+#if DCTD_MAX_SCALE_DENOM > 1
+            if (ss->ScaleDenom > 1) {
+                jddp->dinfo.scale_num = 1;
+                jddp->dinfo.scale_denom = ss->ScaleDenom;
+            }
+#endif
+
             switch (jddp->dinfo.num_components) {
             case 3:
                 jddp->dinfo.jpeg_color_space =
@@ -181,40 +181,59 @@ s_jbig2decode_invert_buffer(unsigned char *buf, size_t length)
 typedef struct {
         Jbig2Allocator allocator;
         gs_memory_t *mem;
+        size_t size; /* bytes currently allocated */
 } s_jbig2decode_allocator_t;
 
 static void *s_jbig2decode_alloc(Jbig2Allocator *_allocator, size_t size)
 {
         s_jbig2decode_allocator_t *allocator = (s_jbig2decode_allocator_t *) _allocator;
+        void *p;
+
         if (size > UINT_MAX)
             return NULL;
-        return gs_alloc_bytes(allocator->mem, size, "s_jbig2decode_alloc");
+        p = gs_alloc_bytes(allocator->mem, size, "s_jbig2decode_alloc");
+        if (p != NULL)
+            allocator->size += size;
+        return p;
 }
 
 static void s_jbig2decode_free(Jbig2Allocator *_allocator, void *p)
 {
         s_jbig2decode_allocator_t *allocator = (s_jbig2decode_allocator_t *) _allocator;
+
+        if (p != NULL)
+            allocator->size -= gs_object_size(allocator->mem, p);
         gs_free_object(allocator->mem, p, "s_jbig2decode_free");
 }
 
 static void *s_jbig2decode_realloc(Jbig2Allocator *_allocator, void *p, size_t size)
 {
         s_jbig2decode_allocator_t *allocator = (s_jbig2decode_allocator_t *) _allocator;
+        size_t old_size = p != NULL ? gs_object_size(allocator->mem, p) : 0;
+        void *q;
+
         if (size > UINT_MAX)
             return NULL;
-        return gs_resize_object(allocator->mem, p, size, "s_jbig2decode_realloc");
+        q = gs_resize_object(allocator->mem, p, size, "s_jbig2decode_realloc");
+        if (q != NULL)
+            allocator->size += size - old_size;
+        return q;
 }
 
 /* parse a globals stream packed into a gs_bytestring for us by the postscript
-   layer and stuff the resulting context into a pointer for use in later decoding */
+   layer and stuff the resulting context into a pointer for use in later decoding.
+   If size is not NULL, it returns the memory held by the parsed context. */
 int
-s_jbig2decode_make_global_data(gs_memory_t *mem, byte *data, uint length, void **result)
+s_jbig2decode_make_global_data(gs_memory_t *mem, byte *data, uint length, void **result,
+                               size_t *size)
 {
     Jbig2Ctx *ctx = NULL;
     int code;
     s_jbig2decode_allocator_t *allocator;
 
     /* the cvision encoder likes to include empty global streams */
+    if (size != NULL)
+        *size = 0;
     if (length == 0) {
         if_debug0('w', "[w] ignoring zero-length jbig2 global stream.\n");
         *result = NULL;
@@ -232,6 +251,7 @@ s_jbig2decode_make_global_data(gs_memory_t *mem, byte *data, uint length, void *
     allocator->allocator.free = s_jbig2decode_free;
     allocator->allocator.realloc = s_jbig2decode_realloc;
     allocator->mem = mem;
+    allocator->size = 0;
 
     /* allocate a context with which to parse our global segments */
     ctx = jbig2_ctx_new((Jbig2Allocator *) allocator, JBIG2_OPTIONS_EMBEDDED,
@@ -253,6 +273,8 @@ s_jbig2decode_make_global_data(gs_memory_t *mem, byte *data, uint length, void *
 
     /* canonize and store our global state */
     *result = jbig2_make_global_ctx(ctx);
+    if (size != NULL)
+        *size = allocator->size + sizeof(s_jbig2decode_allocator_t);
 
     return 0; /* todo: check for allocation failure */
 }
@@ -316,6 +338,7 @@ s_jbig2decode_init(stream_state * ss)
                 allocator->allocator.free = s_jbig2decode_free;
                 allocator->allocator.realloc = s_jbig2decode_realloc;
                 allocator->mem = ss->memory->non_gc_memory;
+                allocator->size = 0;
 
                 /* initialize the decoder with the parsed global context if any */
                 state->decode_ctx = jbig2_ctx_new((Jbig2Allocator *) allocator, JBIG2_OPTIONS_EMBEDDED,
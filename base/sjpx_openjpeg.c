@@ -24,18 +24,33 @@
 #include "sjpx_openjpeg.h"
 #include "gxsync.h"
 #include "assert_.h"
+#include "gpgetenv.h"
 #if !defined(SHARE_JPX) || (SHARE_JPX == 0)
 #include "opj_malloc.h"
 #endif
 /* Some locking to get around the criminal lack of context
- * in the openjpeg library. */
+ * in the openjpeg library. Where the compiler gives us thread local
+ * storage, each thread keeps its own allocator pointer, so decoders
+ * running on different threads don't serialise on the monitor. The
+ * bundled library is built without thread support, so its allocations
+ * all happen on the thread that called into it.
+ */
 #if !defined(SHARE_JPX) || (SHARE_JPX == 0)
+#if defined(_MSC_VER)
+#  define OPJ_TLS __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#  define OPJ_TLS __thread
+#endif
+#ifdef OPJ_TLS
+static OPJ_TLS gs_memory_t *opj_memory;
+#else
 static gs_memory_t *opj_memory;
 #endif
+#endif
 
 int sjpxd_create(gs_memory_t *mem)
 {
-#if !defined(SHARE_JPX) || (SHARE_JPX == 0)
+#if (!defined(SHARE_JPX) || (SHARE_JPX == 0)) && !defined(OPJ_TLS)
     gs_lib_ctx_t *ctx = mem->gs_lib_ctx;
 
     ctx->sjpxd_private = gx_monitor_label(gx_monitor_alloc(mem), "sjpxd_monitor");
@@ -47,7 +62,7 @@ int sjpxd_create(gs_memory_t *mem)
 
 void sjpxd_destroy(gs_memory_t *mem)
 {
-#if !defined(SHARE_JPX) || (SHARE_JPX == 0)
+#if (!defined(SHARE_JPX) || (SHARE_JPX == 0)) && !defined(OPJ_TLS)
     gs_lib_ctx_t *ctx = mem->gs_lib_ctx;
 
     gx_monitor_free((gx_monitor_t *)ctx->sjpxd_private);
@@ -58,11 +73,13 @@ void sjpxd_destroy(gs_memory_t *mem)
 static int opj_lock(gs_memory_t *mem)
 {
 #if !defined(SHARE_JPX) || (SHARE_JPX == 0)
-    int ret;
+    int ret = 0;
 
+#ifndef OPJ_TLS
     gs_lib_ctx_t *ctx = mem->gs_lib_ctx;
 
     ret = gx_monitor_enter((gx_monitor_t *)ctx->sjpxd_private);
+#endif
     assert(opj_memory == NULL);
     opj_memory = mem->non_gc_memory;
     return ret;
@@ -74,11 +91,13 @@ static int opj_lock(gs_memory_t *mem)
 static int opj_unlock(gs_memory_t *mem)
 {
 #if !defined(SHARE_JPX) || (SHARE_JPX == 0)
-    gs_lib_ctx_t *ctx = mem->gs_lib_ctx;
-
     assert(opj_memory != NULL);
     opj_memory = NULL;
-    return gx_monitor_leave((gx_monitor_t *)ctx->sjpxd_private);
+#ifndef OPJ_TLS
+    return gx_monitor_leave((gx_monitor_t *)mem->gs_lib_ctx->sjpxd_private);
+#else
+    return 0;
+#endif
 #else
     return 0;
 #endif
@@ -290,6 +309,21 @@ s_opjd_set_codec_format(stream_state * ss, OPJ_CODEC_FORMAT format)
         parameters.flags |= OPJ_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG;
     }
 
+#if defined(SHARE_JPX) && (SHARE_JPX == 1)
+    /* A shared library with thread support can decode tiles and code
+     * blocks in parallel. It allocates with its own (thread safe) malloc,
+     * unlike the bundled build which uses ours. The library already
+     * honours OPJ_NUM_THREADS, so only pick a default if that isn't set.
+     */
+    if (opj_has_thread_support()) {
+        char buf[16];
+        int len = sizeof(buf);
+
+        if (gp_getenv("OPJ_NUM_THREADS", buf, &len) > 0)
+            (void)opj_codec_set_threads(state->codec, opj_get_num_cpus());
+    }
+#endif
+
     /* setup the decoder decoding parameters using user parameters */
     if (!opj_setup_decoder(state->codec, &parameters))
     {
@@ -385,9 +419,66 @@ ycc_to_rgb_16(unsigned char *row, unsigned long row_size)
     while (row_size);
 }
 
+/* Our caller has set up the image at 1/2^reduce of the size of the image
+ * area, rounding up, and expects exactly that many samples. What OpenJPEG
+ * gives us can be a sample out when the image offset isn't a multiple of
+ * the reduction, and is 2^levels times too big if it couldn't discard the
+ * wavelet levels itself. Subsample each component to the expected size.
+ */
+static int reduce_image(stream_jpxd_state * const state, int levels)
+{
+    opj_image_t *image = state->image;
+    int step = 1 << levels;
+    int compno;
+
+    for (compno = 0; compno < image->numcomps; compno++)
+    {
+        opj_image_comp_t *comp = &image->comps[compno];
+        OPJ_UINT32 cdx = comp->dx << state->reduce;
+        OPJ_UINT32 cdy = comp->dy << state->reduce;
+        OPJ_UINT32 w, h, x, y, sx, sy;
+        OPJ_INT32 *data, *out;
+
+        /* The size of the area covered by this component, as reduced */
+        w = (image->x1 - image->x0 + cdx - 1) / cdx;
+        h = (image->y1 - image->y0 + cdy - 1) / cdy;
+        if (comp->data == NULL || comp->w == 0 || comp->h == 0 ||
+            (w == comp->w && h == comp->h && step == 1))
+            continue;
+        if (w == 0 || h == 0 || (size_t)w * h > (size_t)ARCH_MAX_UINT / sizeof(OPJ_INT32))
+            return_error(gs_error_rangecheck);
+
+        data = (OPJ_INT32 *)opj_image_data_alloc((size_t)w * h * sizeof(OPJ_INT32));
+        if (data == NULL)
+            return_error(gs_error_VMerror);
+        out = data;
+        for (y = 0; y < h; y++)
+        {
+            const OPJ_INT32 *row;
+
+            sy = y * step;
+            if (sy >= comp->h)
+                sy = comp->h - 1;
+            row = comp->data + (size_t)sy * comp->w;
+            for (x = 0; x < w; x++)
+            {
+                sx = x * step;
+                if (sx >= comp->w)
+                    sx = comp->w - 1;
+                *out++ = row[sx];
+            }
+        }
+        opj_image_data_free(comp->data);
+        comp->data = data;
+        comp->w = w;
+        comp->h = h;
+    }
+    return 0;
+}
+
 static int decode_image(stream_jpxd_state * const state)
 {
-    int numprimcomp = 0, alpha_comp = -1, compno, rowbytes;
+    int numprimcomp = 0, alpha_comp = -1, compno, rowbytes, reduce;
 
     /* read header */
     if (!opj_read_header(state->stream, state->codec, &(state->image)))
@@ -396,6 +487,30 @@ static int decode_image(stream_jpxd_state * const state)
     	return ERRC;
     }
 
+    /* Discard wavelet levels if we've been asked to reduce the image.
+     * We can't discard more levels than the codestream has, so make up
+     * any difference by subsampling below.
+     */
+    reduce = state->reduce;
+    if (reduce > 0) {
+        opj_codestream_info_v2_t *info = opj_get_cstr_info(state->codec);
+
+        if (info == NULL || info->m_default_tile_info.tccp_info == NULL)
+            reduce = 0;
+        else {
+            for (compno = 0; compno < info->nbcomps; compno++)
+                if (reduce >= (int)info->m_default_tile_info.tccp_info[compno].numresolutions)
+                    reduce = info->m_default_tile_info.tccp_info[compno].numresolutions - 1;
+        }
+        if (info != NULL)
+            opj_destroy_cstr_info(&info);
+        if (reduce > 0 && !opj_set_decoded_resolution_factor(state->codec, reduce)) {
+            /* Leaves the factor half set, so put it back */
+            (void)opj_set_decoded_resolution_factor(state->codec, 0);
+            reduce = 0;
+        }
+    }
+
     /* decode the stream and fill the image structure */
     if (!opj_decode(state->codec, state->stream, state->image))
     {
@@ -403,6 +518,13 @@ static int decode_image(stream_jpxd_state * const state)
         return ERRC;
     }
 
+    if (state->reduce > 0) {
+        int code = reduce_image(state, state->reduce - reduce);
+
+        if (code < 0)
+            return code;
+    }
+
     /* check dimension and prec */
     if (state->image->numcomps == 0)
         return ERRC;
@@ -786,6 +908,7 @@ s_opjd_set_defaults(stream_state * ss) {
     stream_jpxd_state *const state = (stream_jpxd_state *) ss;
 
     state->alpha = false;
+    state->reduce = 0;
     state->colorspace = gs_jpx_cs_rgb;
     state->StartedPassThrough = 0;
     state->PassThrough = 0;
@@ -59,6 +59,8 @@ typedef struct stream_jpxd_state_s
 
     gs_jpx_cs colorspace;	/* requested output colorspace */
     bool alpha; /* return opacity channel */
+    int reduce; /* output at 1/2^reduce of full size, by discarding
+                   wavelet levels where the codestream allows */
 
     stream_block sb;
 
@@ -81,6 +83,11 @@ typedef struct stream_jpxd_state_s
     void *device;                       /* The device we need to send PassThrough data to */
 } stream_jpxd_state;
 
+/* The largest number of resolution levels a caller may ask us to discard. */
+#ifndef JPXD_MAX_REDUCE
+#  define JPXD_MAX_REDUCE 5
+#endif
+
 extern const stream_template s_jpxd_template;
 
 #endif
@@ -263,6 +263,7 @@ const gx_device_bit gs_bitrgbtags_device =
         0, /*icc_struct*/
         GS_UNKNOWN_TAG,         /* this device supports tags */
         1,			/* default interpolate_control */
+        {0, 0, 0, 0},		/* RegionOfInterest */
         {
             gx_default_install,
             gx_default_begin_page,
@@ -289,6 +290,8 @@ const gx_device_bit gs_bitrgbtags_device =
         false, /* bg_print_requested */
         0,     /* bg_print *  */
         0,     /* num_render_threads_requested */
+        0,     /* OutputBuffers */
+        false, /* DirectOutput */
         NULL,  /* saved_pages_list */
         {0}    /* save_procs_while_delaying_erasepage */
     };
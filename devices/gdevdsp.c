@@ -286,6 +286,93 @@ display_sync_output(gx_device * dev)
     return (0);
 }
 
+/*
+ * In rectangle request mode, render a rectangle straight into the block
+ * the client supplied, through a memory device the size of the rectangle
+ * whose line pointers address that block. Only the part of each band that
+ * falls within the rectangle is rasterized, so a tile (for instance the
+ * visible part of a large page) costs in proportion to its own area,
+ * rather than to the full width of the bands it crosses, and there is no
+ * copy out of a band buffer. The pixels land where get_bits_rectangle
+ * would have put them.
+ * Returns 1 if the rectangle was rendered, 0 if it is better (or only
+ * possible) to fetch it with get_bits_rectangle.
+ */
+static int
+display_render_rectangle(gx_device_display *ddev, byte *mem, int ox,
+                         int raster, int plane_raster,
+                         const gs_int_rect *prect)
+{
+    gx_device_clist *cldev = (gx_device_clist *)ddev;
+    gx_device_clist_reader *crdev = &cldev->reader;
+    int num_planes = (ddev->is_planar ? ddev->color_info.num_components : 1);
+    int depth = ddev->color_info.depth / num_planes;
+    int w = prect->q.x - prect->p.x;
+    int h = prect->q.y - prect->p.y;
+    int align;
+    gx_device *bdev;
+    gx_device_memory *mdev;
+    int code, i, pi;
+
+    if (prect->p.x < 0 || prect->q.x > ddev->width ||
+        prect->p.y < 0 || prect->q.y > ddev->height || w <= 0 || h <= 0)
+        return 0;
+    /* The memory devices address whole chunks below 8 bits per pixel,
+     * and whole pixels up to 32 bits above that, so the block has to be
+     * suitably aligned for the rectangle to be rendered in place. */
+    align = (depth < 8 ? align_bitmap_mod : depth < 16 ? 1 : depth < 32 ? 2 : 4);
+    if (((ox * depth) & 7) != 0 ||
+        ALIGNMENT_MOD(mem + (ox * depth >> 3), align) != 0 ||
+        raster % align != 0 || (num_planes > 1 && plane_raster % align != 0))
+        return 0;
+
+    code = clist_close_writer_and_init_reader(cldev);
+    if (code < 0)
+        return code;
+    /* A rectangle within the band that get_bits_rectangle rendered last
+     * is cheaper to copy out of that band, and so are full width
+     * rectangles shorter than a band, which would otherwise cause each
+     * band to be played back several times. */
+    if (crdev->yplane.index < 0 && crdev->ymax > crdev->ymin &&
+        prect->p.y >= crdev->ymin && prect->q.y <= crdev->ymax)
+        return 0;
+    if (w == ddev->width && h < crdev->page_band_height)
+        return 0;
+    /* The transparency compositor lays out its buffers by band, so pages
+     * that use it are rendered a band at a time. */
+    if (crdev->page_uses_transparency)
+        return 0;
+
+    code = gdev_create_buf_device(crdev->buf_procs.create_buf_device,
+                                  &bdev, crdev->target, prect->p.y, NULL,
+                                  ddev->memory,
+                                  &(crdev->color_usage_array[prect->p.y /
+                                                     crdev->page_band_height]));
+    if (code < 0)
+        return code;
+    if (!gs_device_is_memory(bdev)) {
+        crdev->buf_procs.destroy_buf_device(bdev);
+        return 0;
+    }
+    mdev = (gx_device_memory *)bdev;
+    bdev->width = w;
+    code = crdev->buf_procs.setup_buf_device(bdev, mem, raster, NULL,
+                                             0, h, h);
+    if (code >= 0) {
+        /* Point the lines (of each plane) at the client's block. */
+        mem += ox * depth >> 3;
+        for (pi = 0; pi < num_planes; pi++)
+            for (i = 0; i < h; i++)
+                mdev->line_ptrs[pi * h + i] = mem + pi * plane_raster +
+                                              (intptr_t)i * raster;
+        mdev->base = mdev->line_ptrs[0];
+        mdev->raster = raster;
+        code = clist_render_rectangle(cldev, prect, bdev, NULL, true);
+    }
+    crdev->buf_procs.destroy_buf_device(bdev);
+    return code < 0 ? code : 1;
+}
+
 /* Update the display, bring to foreground. */
 /* If you want to pause on showpage, delay your return from callback */
 int
@@ -350,6 +437,12 @@ display_output_page(gx_device * dev, int copies, int flush)
             rect.p.y = y;
             rect.q.x = x + w;
             rect.q.y = y + h;
+            code = display_render_rectangle(ddev, (byte *)mem, ox, raster,
+                                            plane_raster, &rect);
+            if (code < 0)
+                break;
+            if (code > 0)
+                continue;
             params.options = options;
             if (is_planar) {
                 for (i = 0; i < ddev->color_info.num_components; i++)
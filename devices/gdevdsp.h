@@ -338,6 +338,11 @@ struct display_callback_s {
      *   component 1 of Pixel(*ox,*oy), if in planar mode, 0 otherwise.
      *   *x, *y, *w, *h = rectangle requested within that memory block.
      *
+     * Rectangles are rendered in the order requested, so ask for the
+     * visible area first. A rectangle narrower than the page is rendered
+     * on its own, at a cost proportional to its area plus a playback of
+     * the bands it crosses; rectangles the full width of the page and at
+     * least a band high are the cheapest way to cover the rest of it.
      */
     int (*display_rectangle_request)(void *handle, void *device,
                                      void **memory, int *ox, int *oy,
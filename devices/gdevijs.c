@@ -108,6 +108,7 @@ struct gx_device_ijs_s {
     gx_device_common;
     gx_prn_device_common;
     bool IjsUseOutputFD;
+    bool IjsUseSharedMemory;
     char IjsServer[gp_file_name_sizeof]; /* name of executable ijs server */
     char *ColorSpace;
     int ColorSpace_size;
@@ -136,6 +137,11 @@ struct gx_device_ijs_s {
     int k_width;       /* k plane width in pixels */
     int k_band_size;   /* k plane buffer size in bytes, byte aligned */
     unsigned char *k_band;  /* k plane buffer */
+
+    /* Shared memory for the page data, if the server supports it. */
+    char *shm_buf;
+    int shm_size;
+    int shm_slot_size; /* split into IJS_SHM_SLOTS slots; < 0 if unusable */
     gx_device_procs prn_procs;  /* banding playback procedures */
 };
 
@@ -151,6 +157,7 @@ gx_device_ijs gs_ijs_device =
                         0, 0, 0, 0,
                         24 /* depth */, NULL /* print page */),
     FALSE,	/* IjsUseOutputFD */
+    TRUE,	/* IjsUseSharedMemory */
     "",		/* IjsServer */
     NULL,	/* ColorSpace */
     0,		/* ColorSpace_size */
@@ -920,6 +927,10 @@ gsijs_close(gx_device *dev)
     int code;
 
     /* ignore ijs errors on close */
+    ijs_client_shm_close(ijsdev->ctx);
+    ijsdev->shm_buf = NULL;
+    ijsdev->shm_size = 0;
+    ijsdev->shm_slot_size = 0;
     ijs_client_end_job(ijsdev->ctx, 0);
     ijs_client_close(ijsdev->ctx);
     ijs_client_begin_cmd(ijsdev->ctx, IJS_CMD_EXIT);
@@ -966,6 +977,112 @@ gsijs_raster_width(gx_device *pdev)
     return min(width, end);
 }
 
+/* The page data is sent through shared memory, when the server supports
+ * it, in blocks of up to IJS_SHM_SLOT_SIZE bytes. Up to IJS_SHM_SLOTS
+ * blocks can be waiting for the server, so that it can be reading one
+ * while we render the next.
+ */
+#define IJS_SHM_SLOTS 4
+#define IJS_SHM_SLOT_SIZE (256 * 1024)
+
+/* Set up the shared memory for a page, unless what we have will do.
+ * Returns 0 if the classic protocol should be used instead. */
+static int
+gsijs_shm_open(gx_device_ijs *ijsdev, int raster, int row_bytes)
+{
+    int rows = max(IJS_SHM_SLOT_SIZE / row_bytes, 1);
+    /* Rows are fetched a whole raster at a time, so allow for the last
+       one spilling past the data sent. */
+    int slot_size;
+
+    if (rows > (max_int - raster) / IJS_SHM_SLOTS / row_bytes)
+        return 0;
+    slot_size = rows * row_bytes + raster;
+
+    if (!ijsdev->IjsUseSharedMemory || ijsdev->shm_slot_size < 0)
+        return 0;
+    if (ijsdev->shm_buf == NULL || ijsdev->shm_slot_size != slot_size) {
+        ijsdev->shm_buf = NULL;
+        ijsdev->shm_size = 0;
+        if (ijs_client_shm_open(ijsdev->ctx, 0, slot_size * IJS_SHM_SLOTS,
+                                &ijsdev->shm_buf) < 0) {
+            /* Not supported, or failed: don't keep trying. */
+            ijsdev->shm_slot_size = -1;
+            return 0;
+        }
+        ijsdev->shm_size = slot_size * IJS_SHM_SLOTS;
+        ijsdev->shm_slot_size = slot_size;
+    }
+    return 1;
+}
+
+/* Send the rows of a page through the shared memory. The rows are
+ * rendered into each slot in turn, and only its offset is sent. */
+static int
+gsijs_send_rows_shm(gx_device_ijs *ijsdev, int ijs_height, int raster,
+                    int row_bytes, int k_row_bytes, int *pstatus)
+{
+    gx_device_printer *pdev = (gx_device_printer *)ijsdev;
+    int slot_size = ijsdev->shm_slot_size;
+    int pending = 0;
+    int slot = 0;
+    int code = 0;
+    int status = 0;
+    int y = 0;
+
+    while (y < ijs_height) {
+        char *start = ijsdev->shm_buf + slot * slot_size;
+        char *p = start;
+
+        /* Wait for the server to finish with the slot before reusing it. */
+        if (pending == IJS_SHM_SLOTS) {
+            pending--;
+            status = ijs_client_recv_ack(ijsdev->ctx);
+            if (status)
+                break;
+        }
+        for (; y < ijs_height &&
+               p + raster + k_row_bytes <= start + slot_size; y++) {
+            unsigned char *actual_data;
+
+            if (ijsdev->krgb_mode)
+                code = gsijs_get_bits(pdev, y, (byte *)p, &actual_data);
+            else
+                code = gdev_prn_get_bits(pdev, y, (byte *)p, &actual_data);
+            if (code < 0)
+                break;
+            if (actual_data != (unsigned char *)p)
+                memcpy(p, actual_data, row_bytes);
+            p += row_bytes;
+            if (ijsdev->krgb_mode) {
+                code = gsijs_k_get_bits(pdev, y, &actual_data);
+                if (code < 0)
+                    break;
+                memcpy(p, actual_data, k_row_bytes);
+                p += k_row_bytes;
+            }
+        }
+        if (code < 0)
+            break;
+        status = ijs_client_send_shm_block(ijsdev->ctx, 0,
+                                           (int)(start - ijsdev->shm_buf),
+                                           (int)(p - start));
+        if (status)
+            break;
+        pending++;
+        slot = (slot + 1) % IJS_SHM_SLOTS;
+    }
+    /* Collect the remaining acks, keeping the first error. */
+    while (pending-- > 0) {
+        int ack = ijs_client_recv_ack(ijsdev->ctx);
+
+        if (status == 0)
+            status = ack;
+    }
+    *pstatus = status;
+    return code;
+}
+
 /* Print a page.  Don't use normal printer gdev_prn_output_page
  * because it opens the output file.
  */
@@ -987,6 +1104,7 @@ gsijs_output_page(gx_device *dev, int num_copies, int flush)
     int code = 0;
     int endcode = 0;
     int status = 0;
+    int use_shm;
     int i, y;
 
     if ((data = gs_alloc_bytes(pdev->memory, raster, "gsijs_output_page"))
@@ -1042,12 +1160,17 @@ gsijs_output_page(gx_device *dev, int num_copies, int flush)
     write(rgbfd, sz, strlen(sz));
 #endif
 
+    use_shm = gsijs_shm_open(ijsdev, raster, row_bytes + k_row_bytes);
+
     for (i=0; i<num_copies; i++) {
         unsigned char *actual_data;
         ijs_client_begin_cmd (ijsdev->ctx, IJS_CMD_BEGIN_PAGE);
         status = ijs_client_send_cmd_wait(ijsdev->ctx);
 
-        for (y = 0; y < ijs_height; y++) {
+        if (use_shm)
+            code = gsijs_send_rows_shm(ijsdev, ijs_height, raster, row_bytes,
+                                       k_row_bytes, &status);
+        for (y = 0; !use_shm && y < ijs_height; y++) {
             if (krgb_mode)
                 code = gsijs_get_bits(pdev, y, data, &actual_data);
             else
@@ -1154,6 +1277,10 @@ gsijs_get_params(gx_device *dev, gs_param_list *plist)
         code = param_write_bool(plist, "IjsUseOutputFD",
                                 &ijsdev->IjsUseOutputFD);
 
+    if (code >= 0)
+        code = param_write_bool(plist, "IjsUseSharedMemory",
+                                &ijsdev->IjsUseSharedMemory);
+
     if (code >= 0) {
         if (ijsdev->IjsTumble_set) {
             code = param_write_bool(plist, "Tumble", &ijsdev->IjsTumble);
@@ -1350,6 +1477,10 @@ gsijs_put_params(gx_device *dev, gs_param_list *plist)
         code = gsijs_read_bool(plist, "IjsUseOutputFD",
                                &ijsdev->IjsUseOutputFD, is_open);
 
+    if (code >= 0)
+        code = gsijs_read_bool(plist, "IjsUseSharedMemory",
+                               &ijsdev->IjsUseSharedMemory, false);
+
     if (code >= 0) {
         code = gsijs_read_string_malloc(plist, "ProcessColorModel",
             &ijsdev->ColorSpace, &ijsdev->ColorSpace_size, is_open);
@@ -22,6 +22,8 @@
 #include "sdct.h"
 #include "sjpeg.h"
 #include "gxdownscale.h"
+#include "gxgetbit.h"
+#include "gxdevsop.h"
 
 /* Structure for the JPEG-writing device. */
 typedef struct gx_device_jpeg_s {
@@ -47,6 +49,7 @@ typedef struct gx_device_jpeg_s {
 static dev_proc_get_params(jpeg_get_params);
 static dev_proc_get_initial_matrix(jpeg_get_initial_matrix);
 static dev_proc_put_params(jpeg_put_params);
+static dev_proc_dev_spec_op(jpeg_dev_spec_op);
 static dev_proc_print_page(jpeg_print_page);
 static dev_proc_map_color_rgb(jpegcmyk_map_color_rgb);
 static dev_proc_map_cmyk_color(jpegcmyk_map_cmyk_color);
@@ -72,6 +75,7 @@ jpeg_initialize_device_procs(gx_device *dev)
     set_dev_proc(dev, get_initial_matrix, jpeg_get_initial_matrix);
     set_dev_proc(dev, get_params, jpeg_get_params);
     set_dev_proc(dev, put_params, jpeg_put_params);
+    set_dev_proc(dev, dev_spec_op, jpeg_dev_spec_op);
 }
 
 const gx_device_jpeg gs_jpeg_device =
@@ -95,6 +99,7 @@ jpeggray_initialize_device_procs(gx_device *dev)
     set_dev_proc(dev, get_initial_matrix, jpeg_get_initial_matrix);
     set_dev_proc(dev, get_params, jpeg_get_params);
     set_dev_proc(dev, put_params, jpeg_put_params);
+    set_dev_proc(dev, dev_spec_op, jpeg_dev_spec_op);
     set_dev_proc(dev, encode_color, gx_default_8bit_map_gray_color);
     set_dev_proc(dev, decode_color, gx_default_8bit_map_color_gray);
 }
@@ -123,6 +128,7 @@ jpegcmyk_initialize_device_procs(gx_device *dev)
     set_dev_proc(dev, map_color_rgb, jpegcmyk_map_color_rgb);
     set_dev_proc(dev, get_params, jpeg_get_params);
     set_dev_proc(dev, put_params, jpeg_put_params);
+    set_dev_proc(dev, dev_spec_op, jpeg_dev_spec_op);
     set_dev_proc(dev, map_cmyk_color, jpegcmyk_map_cmyk_color);
 
     set_dev_proc(dev, encode_color, jpegcmyk_map_cmyk_color);
@@ -390,78 +396,53 @@ jpeg_get_initial_matrix(gx_device *dev, gs_matrix *pmat)
 
 }
 
-/* Send the page to the file. */
+/* Set up a DCTEncode state for a width x height image in the device's
+ * format, at the device's quality. On failure the IJG compressor has
+ * already been destroyed. */
 static int
-jpeg_print_page(gx_device_printer * pdev, gp_file * prn_stream)
+jpeg_init_encoder(gx_device_jpeg *jdev, gs_memory_t *mem,
+                  stream_DCT_state *state, jpeg_compress_data *jcdp,
+                  int width, int height, bool write_icc)
 {
-    gx_device_jpeg *jdev = (gx_device_jpeg *) pdev;
-    gs_memory_t *mem = pdev->memory;
-    int line_size = gdev_mem_bytes_per_scan_line((gx_device *) pdev);
-    byte *in = gs_alloc_bytes(mem, line_size, "jpeg_print_page(in)");
-    jpeg_compress_data *jcdp = gs_alloc_struct_immovable(mem, jpeg_compress_data,
-      &st_jpeg_compress_data, "jpeg_print_page(jpeg_compress_data)");
-    byte *fbuf = 0;
-    uint fbuf_size;
-    byte *jbuf = 0;
-    uint jbuf_size;
-    int lnum;
+    gx_device_printer *pdev = (gx_device_printer *)jdev;
     int code;
-    stream_DCT_state state;
-    stream fstrm, jstrm;
-    gx_downscaler_t ds;
-
-    if (jcdp == 0 || in == 0) {
-        code = gs_note_error(gs_error_VMerror);
-        goto fail;
-    }
-    code = gx_downscaler_init(&ds, (gx_device *)jdev, 8, 8,
-                              jdev->color_info.depth/8,
-                              &jdev->downscale, NULL, 0);
-    if (code < 0) {
-        gs_free_object(mem, jcdp, "jpeg_print_page(jpeg_compress_data)");
-        jcdp = NULL;
-        goto fail;
-    }
 
     /* Create the DCT encoder state. */
     jcdp->templat = s_DCTE_template;
-    s_init_state((stream_state *)&state, &jcdp->templat, 0);
-    if (state.templat->set_defaults) {
-        state.memory = mem;
-        (*state.templat->set_defaults) ((stream_state *) & state);
-        state.memory = NULL;
+    s_init_state((stream_state *)state, &jcdp->templat, 0);
+    if (state->templat->set_defaults) {
+        state->memory = mem;
+        (*state->templat->set_defaults) ((stream_state *) state);
+        state->memory = NULL;
     }
-    state.QFactor = 1.0;	/* disable quality adjustment in zfdcte.c */
-    state.ColorTransform = 1;	/* default for RGB */
+    state->QFactor = 1.0;	/* disable quality adjustment in zfdcte.c */
+    state->ColorTransform = 1;	/* default for RGB */
     /* We insert no markers, allowing the IJG library to emit */
     /* the format it thinks best. */
-    state.NoMarker = true;	/* do not insert our own Adobe marker */
-    state.Markers.data = 0;
-    state.Markers.size = 0;
-    state.data.compress = jcdp;
+    state->NoMarker = true;	/* do not insert our own Adobe marker */
+    state->Markers.data = 0;
+    state->Markers.size = 0;
+    state->data.compress = jcdp;
     /* Add in ICC profile */
-    state.icc_profile = NULL; /* In case it is not set here */
-    if (pdev->icc_struct != NULL &&
+    state->icc_profile = NULL; /* In case it is not set here */
+    if (write_icc && pdev->icc_struct != NULL &&
         pdev->icc_struct->device_profile[GS_DEFAULT_DEVICE_PROFILE] != NULL) {
         cmm_profile_t *icc_profile = pdev->icc_struct->device_profile[GS_DEFAULT_DEVICE_PROFILE];
         if (icc_profile->num_comps == pdev->color_info.num_components &&
             !(pdev->icc_struct->usefastcolor)) {
-            state.icc_profile = icc_profile;
+            state->icc_profile = icc_profile;
         }
     }
     /* We need state.memory for gs_jpeg_create_compress().... */
-    jcdp->memory = state.jpeg_memory = state.memory = mem;
-    if ((code = gs_jpeg_create_compress(&state)) < 0)
-    {
-        gx_downscaler_fin(&ds);
-        goto fail;
-    }
+    jcdp->memory = state->jpeg_memory = state->memory = mem;
+    if ((code = gs_jpeg_create_compress(state)) < 0)
+        return code;
     /* ....but we need it to be NULL so we don't try to free
      * the stack based state...
      */
-    state.memory = NULL;
-    jcdp->cinfo.image_width = gx_downscaler_scale(pdev->width, jdev->downscale.downscale_factor);
-    jcdp->cinfo.image_height = gx_downscaler_scale(pdev->height, jdev->downscale.downscale_factor);
+    state->memory = NULL;
+    jcdp->cinfo.image_width = width;
+    jcdp->cinfo.image_height = height;
     switch (pdev->color_info.depth) {
         case 32:
             jcdp->cinfo.input_components = 4;
@@ -477,19 +458,19 @@ jpeg_print_page(gx_device_printer * pdev, gp_file * prn_stream)
             break;
     }
     /* Set compression parameters. */
-    if ((code = gs_jpeg_set_defaults(&state)) < 0)
-        goto done;
+    if ((code = gs_jpeg_set_defaults(state)) < 0)
+        goto fail;
     if (jdev->JPEGQ > 0) {
-        code = gs_jpeg_set_quality(&state, jdev->JPEGQ, TRUE);
+        code = gs_jpeg_set_quality(state, jdev->JPEGQ, TRUE);
         if (code < 0)
-            goto done;
+            goto fail;
     } else if (jdev->QFactor > 0.0) {
-        code = gs_jpeg_set_linear_quality(&state,
+        code = gs_jpeg_set_linear_quality(state,
                                           (int)(min(jdev->QFactor, 100.0)
                                                 * 100.0 + 0.5),
                                           TRUE);
         if (code < 0)
-            goto done;
+            goto fail;
     }
     jcdp->cinfo.restart_interval = 0;
     jcdp->cinfo.density_unit = 1;	/* dots/inch (no #define or enum) */
@@ -497,13 +478,428 @@ jpeg_print_page(gx_device_printer * pdev, gp_file * prn_stream)
     jcdp->cinfo.Y_density = (UINT16)pdev->HWResolution[1];
     /* Create the filter. */
     /* Make sure we get at least a full scan line of input. */
-    state.scan_line_size = jcdp->cinfo.input_components *
+    state->scan_line_size = jcdp->cinfo.input_components *
         jcdp->cinfo.image_width;
     jcdp->templat.min_in_size =
-        max(s_DCTE_template.min_in_size, state.scan_line_size);
+        max(s_DCTE_template.min_in_size, state->scan_line_size);
     /* Make sure we can write the user markers in a single go. */
     jcdp->templat.min_out_size =
-        max(s_DCTE_template.min_out_size, state.Markers.size);
+        max(s_DCTE_template.min_out_size, state->Markers.size);
+    return 0;
+  fail:
+    gs_jpeg_destroy(state);
+    return code;
+}
+
+/* ------ Band parallel encoding ------ */
+
+/*
+ * With a clist device and rendering threads, each band is encoded on its
+ * rendering thread as a JPEG of its own, a whole number of MCU rows high.
+ * Encoding a band is then exactly what the encoder does for one restart
+ * interval of the page: the DC predictions start from zero and the last
+ * byte is padded out. So the page is written as the first band's headers
+ * (with the page height, and a DRI giving one band per interval) followed
+ * by each band's entropy coded data, separated by RSTn markers. The
+ * result is an ordinary baseline JPEG that decodes to the same pixels as
+ * the serially encoded one.
+ */
+
+/* The largest MCU height the IJG defaults give us (2x2 subsampled YCbCr). */
+#define JPEG_BAND_MCU_HEIGHT 16
+
+typedef struct jpeg_band_arg_s {
+    gx_device_jpeg *jdev;
+    gp_file *file;
+    int width;
+    int height;
+    uint restart_interval;	/* MCUs per band */
+    int band;			/* next band to write */
+} jpeg_band_arg_t;
+
+typedef struct jpeg_band_buffer_s {
+    gs_memory_t *memory;
+    byte *data;			/* the band as a complete JPEG */
+    uint size;
+    uint alloc;
+    int rows;
+} jpeg_band_buffer_t;
+
+/* Return the number of (downscaled) rows in a band if the page can be
+ * encoded a band at a time, 0 if it must be written serially. */
+static int
+jpeg_band_rows(gx_device_jpeg *jdev, int width, int height, uint *restart_interval)
+{
+    gx_device_printer *pdev = (gx_device_printer *)jdev;
+    gx_device_clist_common *cdev = (gx_device_clist_common *)jdev;
+    gs_memory_t *mem = pdev->memory;
+    jpeg_compress_data *jcdp;
+    stream_DCT_state state;
+    int upfactor, downfactor, band_height, rows;
+    int max_h = 1, max_v = 1, ci, code;
+    ulong mcus;
+
+    if (!PRINTER_IS_CLIST(pdev) || pdev->num_render_threads_requested < 1)
+        return 0;
+    band_height = cdev->page_band_height;
+    gx_downscaler_decode_factor(jdev->downscale.downscale_factor, &upfactor, &downfactor);
+    if (upfactor != 1 || band_height <= 0 || band_height % downfactor != 0)
+        return 0;
+    rows = band_height / downfactor;
+    if (rows >= height)
+        return 0;
+
+    /* Ask the encoder for the MCU size it will use. */
+    jcdp = gs_alloc_struct_immovable(mem, jpeg_compress_data,
+                                     &st_jpeg_compress_data, "jpeg_band_rows");
+    if (jcdp == NULL)
+        return_error(gs_error_VMerror);
+    code = jpeg_init_encoder(jdev, mem, &state, jcdp, width, height, false);
+    if (code >= 0) {
+        for (ci = 0; ci < jcdp->cinfo.num_components; ci++) {
+            max_h = max(max_h, jcdp->cinfo.comp_info[ci].h_samp_factor);
+            max_v = max(max_v, jcdp->cinfo.comp_info[ci].v_samp_factor);
+        }
+        gs_jpeg_destroy(&state);
+    }
+    gs_free_object(mem, jcdp, "jpeg_band_rows");
+    if (code < 0)
+        return code;
+
+    /* Every band but the last must be a whole number of MCU rows, and the
+     * interval has to fit in the DRI marker. */
+    if (rows % (max_v * DCTSIZE) != 0)
+        return 0;
+    mcus = (ulong)(rows / (max_v * DCTSIZE)) *
+        ((width + max_h * DCTSIZE - 1) / (max_h * DCTSIZE));
+    if (mcus > 65535)
+        return 0;
+    *restart_interval = (uint)mcus;
+    return rows;
+}
+
+static int
+jpeg_band_init_buffer(void *arg_, gx_device *dev, gs_memory_t *mem, int w, int h, void **pbuffer)
+{
+    jpeg_band_buffer_t *buffer;
+
+    buffer = (jpeg_band_buffer_t *)gs_alloc_bytes(mem, sizeof(jpeg_band_buffer_t), "jpeg_band_init_buffer");
+    *pbuffer = (void *)buffer;
+    if (buffer == NULL)
+        return_error(gs_error_VMerror);
+    buffer->memory = mem;
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->alloc = 0;
+    buffer->rows = 0;
+    return 0;
+}
+
+static void
+jpeg_band_free_buffer(void *arg_, gx_device *dev, gs_memory_t *mem, void *buffer_)
+{
+    jpeg_band_buffer_t *buffer = (jpeg_band_buffer_t *)buffer_;
+
+    gs_free_object(mem, buffer->data, "jpeg_band_process");
+    gs_free_object(mem, buffer, "jpeg_band_init_buffer");
+}
+
+/* Called on a rendering thread: encode the band into the buffer. */
+static int
+jpeg_band_process(void *arg_, gx_device *dev, gx_device *bdev, const gs_int_rect *rect, void *buffer_)
+{
+    jpeg_band_arg_t *arg = (jpeg_band_arg_t *)arg_;
+    jpeg_band_buffer_t *buffer = (jpeg_band_buffer_t *)buffer_;
+    gs_memory_t *mem = buffer->memory;
+    gs_get_bits_params_t params;
+    gs_int_rect my_rect;
+    jpeg_compress_data *jcdp;
+    stream_DCT_state state;
+    stream_cursor_read r;
+    stream_cursor_write w;
+    int rows = rect->q.y - rect->p.y;
+    int raster, y, status;
+    uint min_out;
+    byte *base;
+    int code;
+
+    /* The downscaler rounds the last band up; the image height rounds down. */
+    if (rect->p.y + rows > arg->height)
+        rows = arg->height - rect->p.y;
+    buffer->rows = 0;
+    buffer->size = 0;
+    if (rows <= 0)
+        return 0;
+
+    params.options = GB_COLORS_NATIVE | GB_ALPHA_NONE | GB_PACKING_CHUNKY | GB_RETURN_POINTER | GB_ALIGN_ANY | GB_OFFSET_0 | GB_RASTER_ANY;
+    my_rect.p.x = 0;
+    my_rect.p.y = 0;
+    my_rect.q.x = rect->q.x - rect->p.x;
+    my_rect.q.y = rows;
+    code = dev_proc(bdev, get_bits_rectangle)(bdev, &my_rect, &params);
+    if (code < 0)
+        return code;
+    raster = (params.options & GB_RASTER_SPECIFIED ? params.raster :
+              gx_device_raster(bdev, 1));
+    base = params.data[0];
+
+    jcdp = gs_alloc_struct_immovable(mem, jpeg_compress_data,
+                                     &st_jpeg_compress_data, "jpeg_band_process");
+    if (jcdp == NULL)
+        return_error(gs_error_VMerror);
+    /* Only the first band's headers are used. */
+    code = jpeg_init_encoder(arg->jdev, mem, &state, jcdp, arg->width, rows,
+                             rect->p.y == 0);
+    if (code < 0) {
+        gs_free_object(mem, jcdp, "jpeg_band_process");
+        return code;
+    }
+    if (state.templat->init)
+        (*state.templat->init) ((stream_state *)&state);
+    min_out = jcdp->templat.min_out_size;
+
+    /* Run the encoder directly, growing the output as it fills up. */
+    r.ptr = r.limit = base - 1;
+    y = 0;
+    for (;;) {
+        if (buffer->alloc - buffer->size < min_out) {
+            uint alloc = max(buffer->alloc * 2,
+                             rows * state.scan_line_size / 4 + min_out);
+            byte *data = gs_alloc_bytes(mem, alloc, "jpeg_band_process");
+
+            if (data == NULL) {
+                code = gs_note_error(gs_error_VMerror);
+                break;
+            }
+            if (buffer->size)
+                memcpy(data, buffer->data, buffer->size);
+            gs_free_object(mem, buffer->data, "jpeg_band_process");
+            buffer->data = data;
+            buffer->alloc = alloc;
+        }
+        if (r.ptr == r.limit && y < rows) {
+            r.ptr = base + y * raster - 1;
+            r.limit = r.ptr + state.scan_line_size;
+            y++;
+        }
+        w.ptr = buffer->data + buffer->size - 1;
+        w.limit = buffer->data + buffer->alloc - 1;
+        status = (*state.templat->process) ((stream_state *)&state, &r, &w,
+                                            y == rows && r.ptr == r.limit);
+        buffer->size = w.ptr + 1 - buffer->data;
+        if (status == EOFC)
+            break;
+        if (status < 0) {
+            code = gs_note_error(gs_error_ioerror);
+            break;
+        }
+        /* 1 means the output is full; make sure there's more room. */
+        if (status == 1 && buffer->alloc - buffer->size >= min_out)
+            min_out = buffer->alloc - buffer->size + 1;
+    }
+    gs_jpeg_destroy(&state);
+    gs_free_object(mem, jcdp, "jpeg_band_process");
+    if (code < 0)
+        return code;
+    buffer->rows = rows;
+    return 0;
+}
+
+/* Marker codes not in jpeglib.h */
+#define JPEG_BAND_M_SOS 0xda
+#define JPEG_BAND_M_DRI 0xdd
+
+/* Is this marker one of the SOFn (frame header) markers? */
+#define JPEG_BAND_IS_SOF(m)\
+  ((m) >= 0xc0 && (m) <= 0xcf && (m) != 0xc4 && (m) != 0xc8 && (m) != 0xcc)
+
+/* Find the start of the entropy coded data in a JPEG written by the IJG
+ * encoder, i.e. the end of the SOS segment. Return 0 if it isn't there. */
+static uint
+jpeg_band_scan_start(const byte *data, uint size)
+{
+    uint pos = 2;		/* skip SOI */
+
+    while (pos + 4 <= size && data[pos] == 0xff) {
+        byte marker = data[pos + 1];
+
+        pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+        if (marker == JPEG_BAND_M_SOS)
+            return (pos <= size ? pos : 0);
+    }
+    return 0;
+}
+
+static int
+jpeg_band_write(gp_file *file, const byte *data, uint size)
+{
+    if (gp_fwrite(data, 1, size, file) != size)
+        return_error(gs_error_ioerror);
+    return 0;
+}
+
+/* Called on the main thread, in band order: write the band. */
+static int
+jpeg_band_output(void *arg_, gx_device *dev, void *buffer_)
+{
+    jpeg_band_arg_t *arg = (jpeg_band_arg_t *)arg_;
+    jpeg_band_buffer_t *buffer = (jpeg_band_buffer_t *)buffer_;
+    const byte *data = buffer->data;
+    uint scan, end, pos, length;
+    byte marker[6];
+    int code;
+
+    if (buffer->rows == 0)
+        return 0;
+    /* Drop the band's EOI. */
+    scan = jpeg_band_scan_start(data, buffer->size);
+    if (scan == 0 || buffer->size < scan + 2 ||
+        data[buffer->size - 2] != 0xff || data[buffer->size - 1] != JPEG_EOI)
+        return_error(gs_error_unknownerror);
+    end = buffer->size - 2;
+
+    if (arg->band == 0) {
+        /* SOI and the tables, with the page height in the frame header,
+         * then a DRI and the scan header. */
+        code = jpeg_band_write(arg->file, data, 2);
+        for (pos = 2; code >= 0 && data[pos + 1] != JPEG_BAND_M_SOS;
+             pos += length) {
+            length = 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+            if (JPEG_BAND_IS_SOF(data[pos + 1])) {
+                /* marker, length, P, then Y */
+                marker[0] = (byte)(arg->height >> 8);
+                marker[1] = (byte)arg->height;
+                code = jpeg_band_write(arg->file, data + pos, 5);
+                if (code >= 0)
+                    code = jpeg_band_write(arg->file, marker, 2);
+                if (code >= 0)
+                    code = jpeg_band_write(arg->file, data + pos + 7, length - 7);
+            } else
+                code = jpeg_band_write(arg->file, data + pos, length);
+        }
+        marker[0] = 0xff;
+        marker[1] = JPEG_BAND_M_DRI;
+        marker[2] = 0;
+        marker[3] = 4;
+        marker[4] = (byte)(arg->restart_interval >> 8);
+        marker[5] = (byte)arg->restart_interval;
+        if (code >= 0)
+            code = jpeg_band_write(arg->file, marker, 6);
+        if (code >= 0)
+            code = jpeg_band_write(arg->file, data + pos, scan - pos);
+    } else {
+        marker[0] = 0xff;
+        marker[1] = JPEG_RST0 + ((arg->band - 1) & 7);
+        code = jpeg_band_write(arg->file, marker, 2);
+    }
+    if (code >= 0)
+        code = jpeg_band_write(arg->file, data + scan, end - scan);
+    arg->band++;
+    return code;
+}
+
+/* Encode the page a band at a time, and write it. */
+static int
+jpeg_print_bands(gx_device_jpeg *jdev, gp_file *prn_stream, int width,
+                 int height, uint restart_interval)
+{
+    jpeg_band_arg_t arg;
+    gx_process_page_options_t process = { 0 };
+    int factor = jdev->downscale.downscale_factor;
+    static const byte eoi[2] = { 0xff, JPEG_EOI };
+    int code;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.jdev = jdev;
+    arg.file = prn_stream;
+    arg.width = width;
+    arg.height = height;
+    arg.restart_interval = restart_interval;
+
+    process.init_buffer_fn = jpeg_band_init_buffer;
+    process.free_buffer_fn = jpeg_band_free_buffer;
+    process.process_fn = jpeg_band_process;
+    process.output_fn = jpeg_band_output;
+    process.arg = &arg;
+
+    if (factor == 1)
+        code = dev_proc(jdev, process_page)((gx_device *)jdev, &process);
+    else
+        code = gx_downscaler_process_page((gx_device *)jdev, &process, factor);
+    if (code >= 0 && arg.band == 0)
+        code = gs_note_error(gs_error_rangecheck);
+    if (code >= 0)
+        code = jpeg_band_write(prn_stream, eoi, 2);
+    return code;
+}
+
+/* Keep the bands a whole number of MCU rows when encoding them in
+ * parallel. */
+static int
+jpeg_dev_spec_op(gx_device *dev, int op, void *data, int size)
+{
+    gx_device_jpeg *jdev = (gx_device_jpeg *)dev;
+
+    if (op == gxdso_adjust_bandheight && jdev->num_render_threads_requested >= 1) {
+        int upfactor, downfactor, unit;
+
+        gx_downscaler_decode_factor(jdev->downscale.downscale_factor, &upfactor, &downfactor);
+        unit = JPEG_BAND_MCU_HEIGHT * downfactor;
+        if (upfactor == 1 && size >= unit)
+            return size - size % unit;
+    }
+    return gdev_prn_dev_spec_op(dev, op, data, size);
+}
+
+/* Send the page to the file. */
+static int
+jpeg_print_page(gx_device_printer * pdev, gp_file * prn_stream)
+{
+    gx_device_jpeg *jdev = (gx_device_jpeg *) pdev;
+    gs_memory_t *mem = pdev->memory;
+    int line_size = gdev_mem_bytes_per_scan_line((gx_device *) pdev);
+    int width = gx_downscaler_scale(pdev->width, jdev->downscale.downscale_factor);
+    int height = gx_downscaler_scale(pdev->height, jdev->downscale.downscale_factor);
+    uint restart_interval;
+    byte *in;
+    jpeg_compress_data *jcdp;
+    byte *fbuf = 0;
+    uint fbuf_size;
+    byte *jbuf = 0;
+    uint jbuf_size;
+    int lnum;
+    int code;
+    stream_DCT_state state;
+    stream fstrm, jstrm;
+    gx_downscaler_t ds;
+
+    code = jpeg_band_rows(jdev, width, height, &restart_interval);
+    if (code < 0)
+        return code;
+    if (code > 0)
+        return jpeg_print_bands(jdev, prn_stream, width, height, restart_interval);
+
+    in = gs_alloc_bytes(mem, line_size, "jpeg_print_page(in)");
+    jcdp = gs_alloc_struct_immovable(mem, jpeg_compress_data,
+      &st_jpeg_compress_data, "jpeg_print_page(jpeg_compress_data)");
+    if (jcdp == 0 || in == 0) {
+        code = gs_note_error(gs_error_VMerror);
+        goto fail;
+    }
+    code = gx_downscaler_init(&ds, (gx_device *)jdev, 8, 8,
+                              jdev->color_info.depth/8,
+                              &jdev->downscale, NULL, 0);
+    if (code < 0) {
+        gs_free_object(mem, jcdp, "jpeg_print_page(jpeg_compress_data)");
+        jcdp = NULL;
+        goto fail;
+    }
+
+    code = jpeg_init_encoder(jdev, mem, &state, jcdp, width, height, true);
+    if (code < 0) {
+        gx_downscaler_fin(&ds);
+        goto fail;
+    }
 
     /* Set up the streams. */
     fbuf_size = max(512 /* arbitrary */ , jcdp->templat.min_out_size);
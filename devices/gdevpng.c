@@ -49,6 +49,7 @@
  */
 /*#define PNG_NO_STDIO*/
 #include "png_.h"
+#include "zlib.h"
 
 #include "gdevprn.h"
 #include "gdevmem.h"
@@ -56,6 +57,7 @@
 #include "gscdefs.h"
 #include "gxdownscale.h"
 #include "gxdevsop.h"
+#include "gxgetbit.h"
 
 /* ------ The device descriptors ------ */
 
@@ -464,6 +466,316 @@ my_png_flush(png_struct *png)
     (void)gp_fflush(file);
 }
 
+/* ------ Band parallel encoding ------ */
+
+/*
+ * With a clist device and rendering threads, the image data can be
+ * filtered and deflated a band at a time on the rendering threads (see
+ * gdevfpng.c). Each band is compressed as an independent run of raw
+ * deflate blocks, which we concatenate, in order, into one zlib stream
+ * split over an IDAT per band. The first row of each band uses the Sub
+ * filter, as the row above is in another band; the rest use Paeth.
+ * Palette and sub-byte images aren't filtered, as libpng would do.
+ *
+ * The caller writes everything up to the first IDAT through libpng as
+ * usual, and the inversions we would have asked libpng for are done here
+ * instead. 16 bit samples are already big endian in the raster (the
+ * png_set_swap call comes before libpng knows the bit depth, so it does
+ * nothing), so they go out as they are.
+ */
+typedef struct png_band_arg_s {
+    png_struct *png_ptr;
+    int width;
+    int height;
+    int depth;
+    int bpp;                    /* bytes per pixel, at least 1 */
+    int rowbytes;
+    bool filter;
+    bool invert_mono;
+    bool invert_alpha;
+    bool started;               /* zlib header written */
+    bool finished;              /* last band written */
+    uLong adler;
+} png_band_arg_t;
+
+typedef struct png_band_buffer_s {
+    gs_memory_t *memory;
+    uint size;
+    uint compressed;
+    int rows;
+    bool last;
+    uLong adler;                /* of this band's uncompressed data */
+    uLong length;
+    byte data[1];
+} png_band_buffer_t;
+
+/* Return the number of (downscaled) rows in a band if the page can be
+ * encoded a band at a time, or 0 if it must be written serially. Only
+ * the simple downscale works on bands: 8 bit gray or RGB, no alpha. */
+static int
+png_band_rows(gx_device_png *pdev, int depth, int factor)
+{
+    gx_device_clist_common *cdev = (gx_device_clist_common *)pdev;
+    int upfactor, downfactor, band_height;
+
+    if (!PRINTER_IS_CLIST(pdev) || pdev->num_render_threads_requested < 1)
+        return 0;
+    if (factor != 1 && !((depth == 8 || depth == 24) &&
+                         pdev->color_info.depth == depth &&
+                         pdev->color_info.num_components == depth / 8))
+        return 0;
+    band_height = cdev->page_band_height;
+    gx_downscaler_decode_factor(factor, &upfactor, &downfactor);
+    /* Every band but the last must give the same number of rows */
+    if (upfactor != 1 || band_height <= 0 || band_height % downfactor != 0)
+        return 0;
+    return band_height / downfactor;
+}
+
+static int
+png_band_init_buffer(void *arg_, gx_device *dev, gs_memory_t *mem, int w, int h, void **pbuffer)
+{
+    png_band_arg_t *arg = (png_band_arg_t *)arg_;
+    png_band_buffer_t *buffer;
+    /* Room for a final sync flush too */
+    uLong size = deflateBound(NULL, (uLong)(arg->rowbytes + 1) * h) + 16;
+
+    if ((uint)size != size)
+        return_error(gs_error_VMerror);
+    buffer = (png_band_buffer_t *)gs_alloc_bytes(mem, sizeof(png_band_buffer_t) + size, "png_band_init_buffer");
+    *pbuffer = (void *)buffer;
+    if (buffer == NULL)
+        return_error(gs_error_VMerror);
+    buffer->memory = mem;
+    buffer->size = (uint)size;
+    buffer->compressed = 0;
+    buffer->rows = 0;
+    return 0;
+}
+
+static void
+png_band_free_buffer(void *arg_, gx_device *dev, gs_memory_t *mem, void *buffer)
+{
+    gs_free_object(mem, buffer, "png_band_init_buffer");
+}
+
+static void *
+png_band_zalloc(void *mem_, unsigned int items, unsigned int size)
+{
+    gs_memory_t *mem = (gs_memory_t *)mem_;
+
+    return gs_alloc_bytes(mem, items * size, "png_band_zalloc");
+}
+
+static void
+png_band_zfree(void *mem_, void *address)
+{
+    gs_memory_t *mem = (gs_memory_t *)mem_;
+
+    gs_free_object(mem, address, "png_band_zfree");
+}
+
+static inline int
+png_paeth_predict(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+
+    if (pa <= pb && pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
+
+/* Called on a rendering thread: transform, filter and deflate the band. */
+static int
+png_band_process(void *arg_, gx_device *dev, gx_device *bdev, const gs_int_rect *rect, void *buffer_)
+{
+    png_band_arg_t *arg = (png_band_arg_t *)arg_;
+    png_band_buffer_t *buffer = (png_band_buffer_t *)buffer_;
+    gs_get_bits_params_t params;
+    gs_int_rect my_rect;
+    z_stream stream;
+    int raster;
+    int rowbytes = arg->rowbytes;
+    int bpp = arg->bpp;
+    int rows = rect->q.y - rect->p.y;
+    int x, y, err;
+    byte *base, *p;
+    byte filter_type;
+    uLong adler;
+    int code;
+
+    /* The downscaler rounds the last band up; the image height rounds down. */
+    if (rect->p.y + rows > arg->height)
+        rows = arg->height - rect->p.y;
+    buffer->rows = 0;
+    if (rows <= 0)
+        return 0;
+
+    params.options = GB_COLORS_NATIVE | GB_ALPHA_NONE | GB_PACKING_CHUNKY | GB_RETURN_POINTER | GB_ALIGN_ANY | GB_OFFSET_0 | GB_RASTER_ANY;
+    my_rect.p.x = 0;
+    my_rect.p.y = 0;
+    my_rect.q.x = rect->q.x - rect->p.x;
+    my_rect.q.y = rows;
+    code = dev_proc(bdev, get_bits_rectangle)(bdev, &my_rect, &params);
+    if (code < 0)
+        return code;
+    raster = (params.options & GB_RASTER_SPECIFIED ? params.raster :
+              gx_device_raster(bdev, 1));
+    base = params.data[0];
+
+    /* The libpng inversions, on the whole band before filtering. */
+    if (arg->invert_mono || arg->invert_alpha) {
+        for (y = 0, p = base; y < rows; y++, p += raster) {
+            if (arg->invert_mono)
+                for (x = 0; x < rowbytes; x++)
+                    p[x] ^= 0xff;
+            else
+                for (x = 3; x < rowbytes; x += 4)
+                    p[x] ^= 0xff;
+        }
+    }
+
+    /* Filter in place, bottom up and right to left, so the neighbours
+     * we predict from are still unfiltered. */
+    if (arg->filter) {
+        for (y = rows - 1; y > 0; y--) {
+            p = base + y * raster;
+            for (x = rowbytes - 1; x >= bpp; x--)
+                p[x] -= png_paeth_predict(p[x - bpp], p[x - raster], p[x - bpp - raster]);
+            for (; x >= 0; x--)
+                p[x] -= p[x - raster];
+        }
+        for (x = rowbytes - 1; x >= bpp; x--)
+            base[x] -= base[x - bpp];
+    }
+
+    stream.zalloc = png_band_zalloc;
+    stream.zfree = png_band_zfree;
+    stream.opaque = buffer->memory;
+    err = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+                       8, Z_DEFAULT_STRATEGY);
+    if (err != Z_OK)
+        return_error(gs_error_VMerror);
+    stream.next_out = buffer->data;
+    stream.avail_out = buffer->size;
+
+    buffer->last = (rect->p.y + rows >= arg->height);
+    adler = adler32(0L, Z_NULL, 0);
+    for (y = 0, p = base; y < rows && err == Z_OK; y++, p += raster) {
+        filter_type = (!arg->filter ? 0 : y == 0 ? 1 : 4);
+        adler = adler32(adler, &filter_type, 1);
+        adler = adler32(adler, p, rowbytes);
+        stream.next_in = &filter_type;
+        stream.avail_in = 1;
+        err = deflate(&stream, Z_NO_FLUSH);
+        if (err != Z_OK)
+            break;
+        stream.next_in = p;
+        stream.avail_in = rowbytes;
+        /* All but the last band end on a byte boundary with no final block,
+         * so that the next one can follow straight on. */
+        err = deflate(&stream, y < rows - 1 ? Z_NO_FLUSH :
+                               buffer->last ? Z_FINISH : Z_SYNC_FLUSH);
+    }
+    if (err == Z_STREAM_END)
+        err = Z_OK;
+    else if (err == Z_OK && stream.avail_out == 0)
+        err = Z_BUF_ERROR;
+    buffer->compressed = stream.total_out;
+    deflateEnd(&stream);
+    if (err != Z_OK)
+        return_error(gs_error_ioerror);
+
+    buffer->adler = adler;
+    buffer->length = (uLong)rows * (rowbytes + 1);
+    buffer->rows = rows;
+    return 0;
+}
+
+/* Called on the main thread, in band order: write the band's IDAT. */
+static int
+png_band_output(void *arg_, gx_device *dev, void *buffer_)
+{
+    png_band_arg_t *arg = (png_band_arg_t *)arg_;
+    png_band_buffer_t *buffer = (png_band_buffer_t *)buffer_;
+    /* CMF, FLG for a 32K window at the default level */
+    static const byte zlib_header[2] = { 0x78, 0x9c };
+    byte trailer[4];
+    uint length;
+
+    if (buffer->rows == 0)
+        return 0;
+    if (arg->finished)
+        return_error(gs_error_rangecheck);
+    length = buffer->compressed;
+    if (!arg->started)
+        length += sizeof(zlib_header);
+    if (buffer->last)
+        length += sizeof(trailer);
+
+    png_write_chunk_start(arg->png_ptr, (png_const_bytep)"IDAT", length);
+    if (!arg->started) {
+        png_write_chunk_data(arg->png_ptr, zlib_header, sizeof(zlib_header));
+        arg->started = true;
+    }
+    png_write_chunk_data(arg->png_ptr, buffer->data, buffer->compressed);
+    arg->adler = adler32_combine(arg->adler, buffer->adler, buffer->length);
+    if (buffer->last) {
+        trailer[0] = (byte)(arg->adler >> 24);
+        trailer[1] = (byte)(arg->adler >> 16);
+        trailer[2] = (byte)(arg->adler >> 8);
+        trailer[3] = (byte)(arg->adler);
+        png_write_chunk_data(arg->png_ptr, trailer, sizeof(trailer));
+        arg->finished = true;
+    }
+    png_write_chunk_end(arg->png_ptr);
+    return 0;
+}
+
+/* Write the image data and IEND, after png_write_info. */
+static int
+png_print_bands(gx_device_png *pdev, png_struct *png_ptr, int width,
+                int height, int depth, png_byte color_type, bool invert)
+{
+    png_band_arg_t arg;
+    gx_process_page_options_t process = { 0 };
+    int factor = pdev->downscale.downscale_factor;
+    int code;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.png_ptr = png_ptr;
+    arg.width = width;
+    arg.height = height;
+    arg.depth = depth;
+    arg.bpp = (depth < 8 ? 1 : depth / 8);
+    arg.rowbytes = (width * depth + 7) / 8;
+    arg.filter = (depth >= 8 && color_type != PNG_COLOR_TYPE_PALETTE);
+    arg.invert_mono = (invert && depth != 32);
+    arg.invert_alpha = (invert && depth == 32);
+    arg.adler = adler32(0L, Z_NULL, 0);
+
+    process.init_buffer_fn = png_band_init_buffer;
+    process.free_buffer_fn = png_band_free_buffer;
+    process.process_fn = png_band_process;
+    process.output_fn = png_band_output;
+    process.arg = &arg;
+
+    if (factor == 1)
+        code = dev_proc(pdev, process_page)((gx_device *)pdev, &process);
+    else
+        code = gx_downscaler_process_page((gx_device *)pdev, &process, factor);
+    if (code >= 0 && !arg.finished)
+        code = gs_note_error(gs_error_rangecheck);
+    if (code >= 0)
+        png_write_chunk(png_ptr, (png_const_bytep)"IEND", NULL, 0);
+    return code;
+}
+
 /* Write out a page in PNG format. */
 /* This routine is used for all formats. */
 static int
@@ -733,6 +1045,12 @@ do_png_print_page(gx_device_png * pdev, gp_file * file, bool monod)
     info_ptr->text = NULL;
 #endif
 
+    if (!monod && png_band_rows(pdev, depth, pdev->downscale.downscale_factor) > 0) {
+        code = png_print_bands(pdev, png_ptr, width, height, depth,
+                               color_type, invert);
+        goto written;
+    }
+
     /* For simplicity of code, we always go through the downscaler. For
      * non-supported depths, it will pass through with minimal performance
      * hit. So ensure that we only trigger downscales when we need them.
@@ -764,6 +1082,7 @@ do_png_print_page(gx_device_png * pdev, gp_file * file, bool monod)
     /* write the rest of the file */
     png_write_end(png_ptr, info_ptr);
 
+  written:
 #if PNG_LIBPNG_VER_MINOR >= 5
 #else
     /* if you alloced the palette, free it here */
@@ -452,6 +452,242 @@ int tiff_set_fields_for_printer(gx_device_printer *pdev,
     return 0;
 }
 
+/* ------ Strip-parallel output ------ */
+
+/*
+ * With a clist device and rendering threads, we can have the page's
+ * bands rendered, (simply) downscaled and compressed on the rendering
+ * threads by way of process_page: each band becomes one strip, which is
+ * encoded by a private TIFF writing to memory with the same layout and
+ * compression as the real one. The main thread then just appends the
+ * encoded strips to the file in order.
+ */
+typedef struct tiff_strip_arg_s {
+    TIFF *tif;
+    const char *dname;
+    uint32 width;
+    uint32 height;
+    uint32 rows_per_strip;
+    uint32 nstrips;
+    uint32 strip;           /* next strip to write */
+    uint16 bps;
+    uint16 spp;
+    uint16 photometric;
+    uint16 compression;
+    uint16 fillorder;
+    uint32 faxopts;
+    bool has_faxopts;
+    bool big_endian;
+} tiff_strip_arg_t;
+
+typedef struct tiff_strip_buffer_s {
+    tiff_memory_buffer out;
+    uint64_t start;         /* of the encoded strip in out.data */
+    uint64_t end;
+    uint32 rows;
+} tiff_strip_buffer_t;
+
+/* Return the number of (downscaled) rows in a band if the page can be
+ * written a strip per band, or 0 if it must be written serially. */
+static int
+tiff_strip_band_rows(gx_device_printer *dev, TIFF *tif, int factor)
+{
+    gx_device_clist_common *cdev = (gx_device_clist_common *)dev;
+    int upfactor, downfactor, band_height;
+    uint32 width;
+    uint16 planar;
+
+    if (!PRINTER_IS_CLIST(dev) || dev->num_render_threads_requested < 1)
+        return 0;
+    band_height = cdev->page_band_height;
+    gx_downscaler_decode_factor(factor, &upfactor, &downfactor);
+    /* Every strip but the last must have the same number of rows */
+    if (upfactor != 1 || band_height <= 0 || band_height % downfactor != 0)
+        return 0;
+    if (!TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) ||
+        width > (uint32)gx_downscaler_scale_rounded(dev->width, factor))
+        return 0;
+    TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+    if (planar != PLANARCONFIG_CONTIG)
+        return 0;
+    return band_height / downfactor;
+}
+
+static int
+tiff_strip_setup(tiff_strip_arg_t *arg, gx_device_printer *dev, TIFF *tif,
+                 int rows)
+{
+    memset(arg, 0, sizeof(*arg));
+    arg->tif = tif;
+    arg->dname = dev->dname;
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &arg->width);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &arg->height);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &arg->bps);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &arg->spp);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &arg->compression);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &arg->fillorder);
+    if (!TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &arg->photometric))
+        return_error(gs_error_undefined);
+    if (arg->compression == COMPRESSION_CCITTFAX3)
+        arg->has_faxopts = TIFFGetField(tif, TIFFTAG_GROUP3OPTIONS, &arg->faxopts);
+    else if (arg->compression == COMPRESSION_CCITTFAX4)
+        arg->has_faxopts = TIFFGetField(tif, TIFFTAG_GROUP4OPTIONS, &arg->faxopts);
+    arg->big_endian = TIFFIsBigEndian(tif);
+    arg->rows_per_strip = rows;
+    arg->nstrips = (arg->height + rows - 1) / rows;
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows);
+    return 0;
+}
+
+static int
+tiff_strip_init_buffer(void *arg_, gx_device *dev, gs_memory_t *mem, int w, int h, void **pbuffer)
+{
+    tiff_strip_buffer_t *buffer;
+
+    buffer = (tiff_strip_buffer_t *)gs_alloc_bytes(mem, sizeof(*buffer), "tiff_strip_init_buffer");
+    *pbuffer = (void *)buffer;
+    if (buffer == NULL)
+        return_error(gs_error_VMerror);
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->out.memory = mem;
+    return 0;
+}
+
+static void
+tiff_strip_free_buffer(void *arg_, gx_device *dev, gs_memory_t *mem, void *buffer_)
+{
+    tiff_strip_buffer_t *buffer = (tiff_strip_buffer_t *)buffer_;
+
+    if (buffer == NULL)
+        return;
+    gs_free_object(mem, buffer->out.data, "tiff_strip_free_buffer");
+    gs_free_object(mem, buffer, "tiff_strip_free_buffer");
+}
+
+/* Called on a rendering thread: encode the band as a strip. */
+static int
+tiff_strip_process(void *arg_, gx_device *dev, gx_device *bdev, const gs_int_rect *rect, void *buffer_)
+{
+    tiff_strip_arg_t *arg = (tiff_strip_arg_t *)arg_;
+    tiff_strip_buffer_t *buffer = (tiff_strip_buffer_t *)buffer_;
+    gs_get_bits_params_t params;
+    gs_int_rect my_rect;
+    TIFF *tif;
+    byte *row;
+    uint raster;
+    int rows = rect->q.y - rect->p.y;
+    int y, code;
+
+    /* The downscaler rounds the last band up; the image height rounds down. */
+    if (rect->p.y + rows > (int)arg->height)
+        rows = arg->height - rect->p.y;
+    buffer->rows = 0;
+    if (rows <= 0)
+        return 0;
+
+    params.options = GB_COLORS_NATIVE | GB_ALPHA_NONE | GB_PACKING_CHUNKY | GB_RETURN_POINTER | GB_ALIGN_ANY | GB_OFFSET_0 | GB_RASTER_ANY;
+    my_rect.p.x = 0;
+    my_rect.p.y = 0;
+    my_rect.q.x = rect->q.x - rect->p.x;
+    my_rect.q.y = rows;
+    code = dev_proc(bdev, get_bits_rectangle)(bdev, &my_rect, &params);
+    if (code < 0)
+        return code;
+
+    tif = tiff_to_memory(&buffer->out, arg->dname, arg->big_endian);
+    if (tif == NULL)
+        return_error(gs_error_VMerror);
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, arg->width);
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32)rows);
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32)rows);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, arg->bps);
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, arg->spp);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, arg->photometric);
+    TIFFSetField(tif, TIFFTAG_FILLORDER, arg->fillorder);
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, arg->compression);
+    if (arg->has_faxopts)
+        TIFFSetField(tif, (arg->compression == COMPRESSION_CCITTFAX3 ?
+                           TIFFTAG_GROUP3OPTIONS : TIFFTAG_GROUP4OPTIONS),
+                     arg->faxopts);
+    /* Nothing but the header has been written yet; the strip follows it. */
+    buffer->start = buffer->out.size;
+
+    raster = (params.options & GB_RASTER_SPECIFIED ? params.raster :
+              gx_device_raster(bdev, 1));
+    row = params.data[0];
+    for (y = 0; y < rows; y++, row += raster) {
+#if defined(ARCH_IS_BIG_ENDIAN) && (!ARCH_IS_BIG_ENDIAN)
+        if (arg->bps == 16)
+            TIFFSwabArrayOfShort((uint16 *)row, arg->width * (long)arg->spp);
+#endif
+        if (TIFFWriteScanline(tif, row, y, 0) < 0) {
+            code = gs_note_error(gs_error_ioerror);
+            break;
+        }
+    }
+    if (code >= 0 && !TIFFFlushData(tif))
+        code = gs_note_error(gs_error_ioerror);
+    if (code >= 0) {
+        buffer->end = buffer->out.size;
+        buffer->rows = rows;
+    }
+    /* This appends a directory after the strip, which we ignore. */
+    TIFFClose(tif);
+    return code;
+}
+
+/* Called on the main thread, in band order: append the strip. */
+static int
+tiff_strip_output(void *arg_, gx_device *dev, void *buffer_)
+{
+    tiff_strip_arg_t *arg = (tiff_strip_arg_t *)arg_;
+    tiff_strip_buffer_t *buffer = (tiff_strip_buffer_t *)buffer_;
+
+    if (buffer->rows == 0)
+        return 0;
+    if (arg->strip >= arg->nstrips ||
+        (arg->strip < arg->nstrips - 1 && buffer->rows != arg->rows_per_strip))
+        return_error(gs_error_rangecheck);
+    if (TIFFWriteRawStrip(arg->tif, arg->strip, buffer->out.data + buffer->start,
+                          (tmsize_t)(buffer->end - buffer->start)) < 0)
+        return_error(gs_error_ioerror);
+    arg->strip++;
+    return 0;
+}
+
+static int
+tiff_strip_print_page(gx_device_printer *dev, TIFF *tif, int factor, int rows)
+{
+    tiff_strip_arg_t arg;
+    gx_process_page_options_t process = { 0 };
+    int code;
+
+    code = tiff_strip_setup(&arg, dev, tif, rows);
+    if (code < 0)
+        return code;
+    code = TIFFCheckpointDirectory(tif);
+    if (code < 0)
+        return code;
+
+    process.init_buffer_fn = tiff_strip_init_buffer;
+    process.free_buffer_fn = tiff_strip_free_buffer;
+    process.process_fn = tiff_strip_process;
+    process.output_fn = tiff_strip_output;
+    process.arg = &arg;
+
+    if (factor == 1)
+        code = dev_proc(dev, process_page)((gx_device *)dev, &process);
+    else
+        code = gx_downscaler_process_page((gx_device *)dev, &process, factor);
+    if (code >= 0 && arg.strip != arg.nstrips)
+        code = gs_note_error(gs_error_rangecheck);
+
+    if (code >= 0)
+        code = TIFFWriteDirectory(tif);
+    return code;
+}
+
 int
 tiff_print_page(gx_device_printer *dev, TIFF *tif, int min_feature_size)
 {
@@ -465,6 +701,13 @@ tiff_print_page(gx_device_printer *dev, TIFF *tif, int min_feature_size)
     int line_lag = 0;
     int filtered_count;
 
+    if (bpc != 1 || min_feature_size <= 1) {
+        int rows = tiff_strip_band_rows(dev, tif, 1);
+
+        if (rows > 0)
+            return tiff_strip_print_page(dev, tif, 1, rows);
+    }
+
     data = gs_alloc_bytes(dev->memory, max_size, "tiff_print_page(data)");
     if (data == NULL)
         return_error(gs_error_VMerror);
@@ -554,6 +797,19 @@ tiff_downscale_and_print_page(gx_device_printer *dev, TIFF *tif,
     int height = dev->height/factor;
     gx_downscaler_t ds;
 
+    /* process_page can only do a simple downscale, with no colour change. */
+    if (tfdev->icclink == NULL && bpc == 8 &&
+        dev->color_info.comp_bits[0] == 8 &&
+        num_comps == dev->color_info.num_components &&
+        (num_comps == 1 || num_comps == 3 || num_comps == 4) &&
+        params->trap_w == 0 && params->trap_h == 0 && params->ets == 0 &&
+        !params->do_skew_detection) {
+        int rows = tiff_strip_band_rows(dev, tif, factor);
+
+        if (rows > 0)
+            return tiff_strip_print_page(dev, tif, factor, rows);
+    }
+
     code = TIFFCheckpointDirectory(tif);
     if (code < 0)
         return code;
@@ -28,7 +28,10 @@
 /* This file contains common data types for IJS */
 
 /* IJS_VERSION is decimal version number times 100 */
-#define IJS_VERSION 35
+#define IJS_VERSION 36
+
+/* The first version with the shared memory commands */
+#define IJS_SHM_VERSION 36
 
 typedef int ijs_bool;
 
@@ -57,7 +60,9 @@ typedef enum {
   IJS_CMD_BEGIN_PAGE,
   IJS_CMD_SEND_DATA_BLOCK,
   IJS_CMD_END_PAGE,
-  IJS_CMD_EXIT
+  IJS_CMD_EXIT,
+  IJS_CMD_SHM_OPEN,
+  IJS_CMD_SEND_SHM_BLOCK
 } IjsCommand;
 
 typedef int IjsJobId;
@@ -30,12 +30,21 @@
 #include "ijs.h"
 #include "ijs_client.h"
 
+#ifndef _WIN32
+#define IJS_HAVE_SHM
+#include <sys/mman.h>
+#endif
+
 struct _IjsClientCtx {
   int fd_from;
   int child_pid;
   IjsSendChan send_chan;
   IjsRecvChan recv_chan;
   int version;
+
+  /* shared memory for page data, see ijs_client_shm_open */
+  char *shm_buf;
+  int shm_size;
 };
 
 IjsClientCtx *
@@ -57,6 +66,8 @@ ijs_invoke_server (const char *server_cmd)
   ctx = (IjsClientCtx *)malloc (sizeof(IjsClientCtx));
   ctx->fd_from = fds_from[0];
   ctx->child_pid = child_pid;
+  ctx->shm_buf = NULL;
+  ctx->shm_size = 0;
   ijs_send_init (&ctx->send_chan, fds_to[1]);
   ijs_recv_init (&ctx->recv_chan, fds_from[0]);
 
@@ -158,6 +169,150 @@ ijs_client_send_data_wait (IjsClientCtx *ctx, IjsJobId job_id,
   return status;
 }
 
+/**
+ * ijs_client_shm_open: Set up shared memory for page data.
+ * @ctx: IJS client context.
+ * @job_id: Job id.
+ * @size: Size of the shared memory in bytes.
+ * @pbuf: Where to store the address of the shared memory.
+ *
+ * Creates @size bytes of memory shared with the server, replacing any
+ * set up before. Page data written there can then be sent with
+ * ijs_client_send_shm_block, instead of through the pipe.
+ *
+ * Return value: 0 on success, otherwise negative. IJS_ENYI means that
+ * the server or the platform doesn't support it, in which case the
+ * data should be sent with ijs_client_send_data_wait.
+ **/
+int
+ijs_client_shm_open (IjsClientCtx *ctx, IjsJobId job_id, int size,
+                     char **pbuf)
+{
+#ifdef IJS_HAVE_SHM
+  const char *dirs[3];
+  char name[256];
+  void *buf;
+  int fd = -1;
+  int status;
+  int i;
+
+  ijs_client_shm_close (ctx);
+  if (ctx->version < IJS_SHM_VERSION)
+    return IJS_ENYI;
+  if (size <= 0)
+    return IJS_ERANGE;
+
+  /* The server maps the file by name; both ends unlink it below. */
+  dirs[0] = "/dev/shm";
+  dirs[1] = getenv ("TMPDIR");
+  dirs[2] = "/tmp";
+  for (i = 0; i < 3 && fd < 0; i++)
+    {
+      if (dirs[i] == NULL || strlen (dirs[i]) > sizeof(name) - 16)
+        continue;
+      sprintf (name, "%s/ijs-XXXXXX", dirs[i]);
+      fd = mkstemp (name);
+    }
+  if (fd < 0)
+    return IJS_EIO;
+  if (ftruncate (fd, size) < 0)
+    {
+      close (fd);
+      unlink (name);
+      return IJS_EIO;
+    }
+  buf = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (buf == MAP_FAILED)
+    {
+      unlink (name);
+      return IJS_EIO;
+    }
+
+  ijs_client_begin_cmd (ctx, IJS_CMD_SHM_OPEN);
+  ijs_send_int (&ctx->send_chan, job_id);
+  ijs_send_int (&ctx->send_chan, size);
+  status = ijs_send_block (&ctx->send_chan, name, strlen (name) + 1);
+  if (status == 0)
+    status = ijs_client_send_cmd_wait (ctx);
+  /* The server has it mapped by now, if it's going to. */
+  unlink (name);
+  if (status)
+    {
+      munmap (buf, size);
+      return status;
+    }
+  ctx->shm_buf = (char *)buf;
+  ctx->shm_size = size;
+  *pbuf = ctx->shm_buf;
+  return 0;
+#else
+  return IJS_ENYI;
+#endif
+}
+
+/**
+ * ijs_client_shm_close: Release the shared memory.
+ * @ctx: IJS client context.
+ *
+ * Unmaps the memory set up by ijs_client_shm_open, if any. The server
+ * keeps its mapping until the next IJS_CMD_SHM_OPEN or until it exits.
+ *
+ * Return value: 0.
+ **/
+int
+ijs_client_shm_close (IjsClientCtx *ctx)
+{
+#ifdef IJS_HAVE_SHM
+  if (ctx->shm_buf != NULL)
+    munmap (ctx->shm_buf, ctx->shm_size);
+#endif
+  ctx->shm_buf = NULL;
+  ctx->shm_size = 0;
+  return 0;
+}
+
+/**
+ * ijs_client_send_shm_block: Send a block of data from shared memory.
+ * @ctx: IJS client context.
+ * @job_id: Job id.
+ * @offset: Offset of the block in the shared memory.
+ * @size: Size of the block.
+ *
+ * Tells the server to take the next @size bytes of page data from the
+ * shared memory. This doesn't wait for the ack, so that the caller can
+ * go on to fill another part of the memory; each send must be matched
+ * by a later ijs_client_recv_ack, and the block must not be changed
+ * until then.
+ *
+ * Return value: 0 if the command was sent, otherwise negative.
+ **/
+int
+ijs_client_send_shm_block (IjsClientCtx *ctx, IjsJobId job_id,
+                           int offset, int size)
+{
+  if (ctx->shm_buf == NULL || offset < 0 || size < 0 ||
+      size > ctx->shm_size - offset)
+    return IJS_ERANGE;
+  ijs_client_begin_cmd (ctx, IJS_CMD_SEND_SHM_BLOCK);
+  ijs_send_int (&ctx->send_chan, job_id);
+  ijs_send_int (&ctx->send_chan, offset);
+  ijs_send_int (&ctx->send_chan, size);
+  return ijs_client_send_cmd (ctx);
+}
+
+/**
+ * ijs_client_recv_ack: Wait for the ack of an earlier command.
+ * @ctx: IJS client context.
+ *
+ * Return value: 0 on successful ack, otherwise negative.
+ **/
+int
+ijs_client_recv_ack (IjsClientCtx *ctx)
+{
+  return ijs_recv_ack (&ctx->recv_chan);
+}
+
 int
 ijs_client_open (IjsClientCtx *ctx)
 {
@@ -54,6 +54,20 @@ int
 ijs_client_send_data_wait (IjsClientCtx *ctx, IjsJobId job_id,
                            const char *buf, int size);
 
+int
+ijs_client_shm_open (IjsClientCtx *ctx, IjsJobId job_id, int size,
+                     char **pbuf);
+
+int
+ijs_client_shm_close (IjsClientCtx *ctx);
+
+int
+ijs_client_send_shm_block (IjsClientCtx *ctx, IjsJobId job_id,
+                           int offset, int size);
+
+int
+ijs_client_recv_ack (IjsClientCtx *ctx);
+
 int
 ijs_client_open (IjsClientCtx *ctx);
 
@@ -30,6 +30,12 @@
 #include "ijs.h"
 #include "ijs_server.h"
 
+#ifndef _WIN32
+#define IJS_HAVE_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 #define noVERBOSE
 
 typedef enum {
@@ -83,6 +89,10 @@ struct _IjsServerCtx {
   char *overflow_buf;
   int overflow_buf_size;
   int overflow_buf_ix;
+
+  /* shared memory from IJS_CMD_SHM_OPEN */
+  const char *shm_buf;
+  int shm_size;
 };
 
 static int
@@ -153,6 +163,8 @@ ijs_server_init (void)
   ctx->in_page = FALSE;
   ctx->buf = NULL;
   ctx->overflow_buf = NULL;
+  ctx->shm_buf = NULL;
+  ctx->shm_size = 0;
 
   ctx->begin_cb = ijs_server_dummy_begin_cb;
   ctx->end_cb = ijs_server_dummy_end_cb;
@@ -241,11 +253,23 @@ ijs_server_ack (IjsServerCtx *ctx)
   return ijs_send_buf (&ctx->send_chan);
 }
 
+static void
+ijs_server_shm_close (IjsServerCtx *ctx)
+{
+#ifdef IJS_HAVE_SHM
+  if (ctx->shm_buf != NULL)
+    munmap ((void *)ctx->shm_buf, ctx->shm_size);
+#endif
+  ctx->shm_buf = NULL;
+  ctx->shm_size = 0;
+}
+
 void
 ijs_server_done (IjsServerCtx *ctx)
 {
   /* todo: close channels */
   ijs_server_ack (ctx);
+  ijs_server_shm_close (ctx);
 
   free (ctx);
 }
@@ -729,6 +753,38 @@ ijs_server_read_data (IjsServerCtx *ctx, char *buf, int size)
   return (status == size) ? 0 : IJS_EIO;
 }
 
+/* Store a block of page data for ijs_server_get_data, spilling into
+   overflow_buf if it doesn't fit. The data comes from src, or from the
+   pipe if that is NULL. */
+static int
+ijs_server_store_data (IjsServerCtx *ctx, const char *src, int size)
+{
+  int n_bytes = size;
+  int status = 0;
+
+  if (n_bytes > ctx->buf_size - ctx->buf_ix)
+    {
+      n_bytes = ctx->buf_size - ctx->buf_ix;
+      ctx->overflow_buf_size = size - n_bytes;
+      ctx->overflow_buf = (char *)malloc (ctx->overflow_buf_size);
+      ctx->overflow_buf_ix = 0;
+    }
+  if (src == NULL)
+    status = ijs_server_read_data (ctx, ctx->buf + ctx->buf_ix, n_bytes);
+  else
+    memcpy (ctx->buf + ctx->buf_ix, src, n_bytes);
+  ctx->buf_ix += n_bytes;
+  if (!status && n_bytes < size)
+    {
+      if (src == NULL)
+        status = ijs_server_read_data (ctx, ctx->overflow_buf,
+                                       ctx->overflow_buf_size);
+      else
+        memcpy (ctx->overflow_buf, src + n_bytes, ctx->overflow_buf_size);
+    }
+  return status;
+}
+
 static int
 ijs_server_proc_send_data_block (IjsServerCtx *ctx)
 {
@@ -753,25 +809,91 @@ ijs_server_proc_send_data_block (IjsServerCtx *ctx)
   if (status)
     return ijs_server_nak (ctx, status);
 
-  if (size <= ctx->buf_size - ctx->buf_ix)
-    {
-      status = ijs_server_read_data (ctx, ctx->buf + ctx->buf_ix, size);
-      ctx->buf_ix += size;
-    }
-  else
-    {
-      ctx->overflow_buf_size = size - (ctx->buf_size - ctx->buf_ix);
-      ctx->overflow_buf = (char *)malloc (ctx->overflow_buf_size);
-      ctx->overflow_buf_ix = 0;
-      status = ijs_server_read_data (ctx, ctx->buf + ctx->buf_ix,
-                                     ctx->buf_size - ctx->buf_ix);
-      ctx->buf_ix = ctx->buf_size;
-      if (!status)
-        {
-          status = ijs_server_read_data (ctx, ctx->overflow_buf,
-                                         ctx->overflow_buf_size);
-        }
-    }
+  status = ijs_server_store_data (ctx, NULL, size);
+  return ijs_server_ack (ctx);
+}
+
+static int
+ijs_server_proc_shm_open (IjsServerCtx *ctx)
+{
+  const char *name;
+  int name_size;
+  int size;
+  int status;
+  IjsJobId job_id;
+
+  status = ijs_recv_int (&ctx->recv_chan, &job_id);
+  if (status < 0)
+    return status;
+
+  if (!ctx->in_job || job_id != ctx->job_id)
+    return ijs_server_nak (ctx, IJS_EJOBID);
+
+  status = ijs_recv_int (&ctx->recv_chan, &size);
+  if (status < 0)
+    return status;
+  name = ctx->recv_chan.buf + ctx->recv_chan.buf_idx;
+  name_size = ctx->recv_chan.buf_size - ctx->recv_chan.buf_idx;
+  if (name_size == 0 || name[name_size - 1])
+    return IJS_ESYNTAX;
+#ifdef VERBOSE
+  fprintf (stderr, "shm open %s, size=%d\n", name, size);
+#endif
+  if (size <= 0)
+    return ijs_server_nak (ctx, IJS_ERANGE);
+
+#ifdef IJS_HAVE_SHM
+  {
+    void *buf;
+    int fd;
+
+    ijs_server_shm_close (ctx);
+    fd = open (name, O_RDONLY);
+    if (fd < 0)
+      return ijs_server_nak (ctx, IJS_EIO);
+    buf = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (buf == MAP_FAILED)
+      return ijs_server_nak (ctx, IJS_EIO);
+    ctx->shm_buf = (const char *)buf;
+    ctx->shm_size = size;
+    return ijs_server_ack (ctx);
+  }
+#else
+  return ijs_server_nak (ctx, IJS_ENYI);
+#endif
+}
+
+static int
+ijs_server_proc_send_shm_block (IjsServerCtx *ctx)
+{
+  int offset, size;
+  int status = 0;
+  IjsJobId job_id;
+
+  status = ijs_recv_int (&ctx->recv_chan, &job_id);
+  if (status < 0) return status;
+
+  if (!ctx->in_job || job_id != ctx->job_id)
+    status = IJS_EJOBID;
+  else if (ctx->buf == NULL)
+    status = IJS_EPROTO;
+
+  if (!status) status = ijs_recv_int (&ctx->recv_chan, &offset);
+  if (!status) status = ijs_recv_int (&ctx->recv_chan, &size);
+  if (!status && (ctx->shm_buf == NULL || offset < 0 || size < 0 ||
+                  size > ctx->shm_size - offset))
+    status = IJS_ERANGE;
+
+#ifdef VERBOSE
+  fprintf (stderr, "status=%d, send shm block id=%d, offset=%d, size=%d\n",
+           status, job_id, offset, size);
+#endif
+  if (status)
+    return ijs_server_nak (ctx, status);
+
+  /* The client may reuse the block once it has the ack. */
+  ijs_server_store_data (ctx, ctx->shm_buf + offset, size);
   return ijs_server_ack (ctx);
 }
 
@@ -808,7 +930,9 @@ ijs_server_proc ijs_server_procs[] = {
   ijs_server_proc_begin_page,
   ijs_server_proc_send_data_block,
   ijs_server_proc_end_page,
-  ijs_server_proc_exit
+  ijs_server_proc_exit,
+  ijs_server_proc_shm_open,
+  ijs_server_proc_send_shm_block
 };
 
 int